@@ -0,0 +1,191 @@
+// Сравнение сборки ответа /api/v1/game/state деревом boost::json с последующим serialize
+// и потоковой записью JsonWriter в переиспользуемый буфер.
+// Запуск: json_writer_bench [players] [loot]
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <string>
+
+#include <boost/json.hpp>
+
+#include "../src/json_writer.h"
+#include "../src/model.h"
+
+namespace {
+	using namespace std::literals;
+	using Clock = std::chrono::steady_clock;
+	namespace json = boost::json;
+
+	// Число повторов замера, время выводится на одну сборку
+	constexpr int REPEATS = 20;
+
+	std::deque<model::Player> MakePlayers(int count) {
+		std::deque<model::Player> players;
+		for (int i = 0; i < count; ++i) {
+			model::Player player;
+			player.id_ = static_cast<uint64_t>(i);
+			player.pos_ = { i * 0.731, i * 0.257 };
+			player.speed_ = { 1.0, 0.0 };
+			player.direction_ = model::Direction::EAST;
+			player.score_ = static_cast<uint64_t>(i % 1000);
+			for (uint64_t item = 0; item < 3; ++item) {
+				model::LootWithId loot;
+				loot.id = item;
+				loot.type = item % 2;
+				player.bag_.push_back(loot);
+			}
+			players.push_back(std::move(player));
+		}
+		return players;
+	}
+
+	std::deque<model::Loot> MakeLoot(int count) {
+		std::deque<model::Loot> loot;
+		for (int i = 0; i < count; ++i) {
+			loot.push_back({ static_cast<uint64_t>(i % 4), { i * 0.113, i * 0.541 } });
+		}
+		return loot;
+	}
+
+	std::string Direction(model::Direction direction) {
+		return std::string(1, static_cast<char>(direction));
+	}
+
+	// Прежний способ: дерево объектов с ключами-строками и serialize
+	std::string BuildTree(const std::deque<model::Player>& players, const std::deque<model::Loot>& loot) {
+		json::object players_obj;
+		for (const auto& player : players) {
+			json::array pos;
+			pos.push_back(player.pos_.x);
+			pos.push_back(player.pos_.y);
+			json::array speed;
+			speed.push_back(player.speed_.x);
+			speed.push_back(player.speed_.y);
+			json::array bag;
+			for (const auto& item : player.bag_) {
+				json::object item_obj;
+				item_obj["id"] = item.id;
+				item_obj["type"] = item.type;
+				bag.push_back(item_obj);
+			}
+			json::object player_obj;
+			player_obj["pos"] = pos;
+			player_obj["speed"] = speed;
+			player_obj["dir"] = Direction(player.direction_);
+			player_obj["bag"] = bag;
+			player_obj["score"] = player.score_;
+			players_obj[std::to_string(player.id_)] = player_obj;
+		}
+		json::object loot_obj;
+		for (size_t id = 0; id < loot.size(); ++id) {
+			json::array pos;
+			pos.push_back(loot[id].coord.x);
+			pos.push_back(loot[id].coord.y);
+			json::object item_obj;
+			item_obj["type"] = loot[id].type;
+			item_obj["pos"] = pos;
+			loot_obj[std::to_string(id)] = item_obj;
+		}
+		json::object state;
+		state["players"] = players_obj;
+		state["lostObjects"] = loot_obj;
+		return json::serialize(state);
+	}
+
+	void WriteCoord(json_writer::JsonWriter& writer, const model::FloatCoord& coord) {
+		writer.StartArray();
+		writer.Double(coord.x);
+		writer.Double(coord.y);
+		writer.EndArray();
+	}
+
+	// Потоковая запись с заранее собранными ключами
+	void WriteStream(const std::deque<model::Player>& players, const std::deque<model::Loot>& loot, std::string& out) {
+		constexpr json_writer::KeyFragment PLAYERS{ "players" };
+		constexpr json_writer::KeyFragment LOST_OBJECTS{ "lostObjects" };
+		constexpr json_writer::KeyFragment POS{ "pos" };
+		constexpr json_writer::KeyFragment SPEED{ "speed" };
+		constexpr json_writer::KeyFragment DIR{ "dir" };
+		constexpr json_writer::KeyFragment BAG{ "bag" };
+		constexpr json_writer::KeyFragment SCORE{ "score" };
+		constexpr json_writer::KeyFragment ID{ "id" };
+		constexpr json_writer::KeyFragment TYPE{ "type" };
+
+		out.clear();
+		json_writer::JsonWriter writer{ out };
+		writer.StartObject();
+		writer.Key(PLAYERS);
+		writer.StartObject();
+		for (const auto& player : players) {
+			writer.Key(std::to_string(player.id_));
+			writer.StartObject();
+			writer.Key(POS);
+			WriteCoord(writer, player.pos_);
+			writer.Key(SPEED);
+			WriteCoord(writer, player.speed_);
+			writer.Key(DIR);
+			writer.String(Direction(player.direction_));
+			writer.Key(BAG);
+			writer.StartArray();
+			for (const auto& item : player.bag_) {
+				writer.StartObject();
+				writer.Key(ID);
+				writer.Uint(item.id);
+				writer.Key(TYPE);
+				writer.Uint(item.type);
+				writer.EndObject();
+			}
+			writer.EndArray();
+			writer.Key(SCORE);
+			writer.Uint(player.score_);
+			writer.EndObject();
+		}
+		writer.EndObject();
+		writer.Key(LOST_OBJECTS);
+		writer.StartObject();
+		for (size_t id = 0; id < loot.size(); ++id) {
+			writer.Key(std::to_string(id));
+			writer.StartObject();
+			writer.Key(TYPE);
+			writer.Uint(loot[id].type);
+			writer.Key(POS);
+			WriteCoord(writer, loot[id].coord);
+			writer.EndObject();
+		}
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	template <typename Fn>
+	double MillisecondsPerRun(Fn&& fn) {
+		const auto start = Clock::now();
+		for (int i = 0; i < REPEATS; ++i) {
+			fn();
+		}
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / REPEATS;
+	}
+}
+
+int main(int argc, const char* argv[]) {
+	const int players_count = argc > 1 ? std::atoi(argv[1]) : 10000;
+	const int loot_count = argc > 2 ? std::atoi(argv[2]) : 1000;
+	if (players_count < 0 || loot_count < 0) {
+		std::cerr << "Usage: json_writer_bench [players] [loot]"sv << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const auto players = MakePlayers(players_count);
+	const auto loot = MakeLoot(loot_count);
+	std::cout << "players: "sv << players_count << ", loot: "sv << loot_count << std::endl;
+
+	std::string tree_body;
+	const double tree_ms = MillisecondsPerRun([&] { tree_body = BuildTree(players, loot); });
+	std::cout << "boost::json tree: size "sv << tree_body.size() << " bytes, build "sv << tree_ms << " ms"sv << std::endl;
+
+	// буфер переиспользуется между сборками, как в кэше ответов
+	std::string stream_body;
+	const double stream_ms = MillisecondsPerRun([&] { WriteStream(players, loot, stream_body); });
+	std::cout << "JsonWriter: size "sv << stream_body.size() << " bytes, build "sv << stream_ms << " ms"sv << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+// Сравнение текстовых и подготовленных запросов к таблице retired_players.
+// Запуск: GAME_DB_URL=postgres://... prepared_statements_bench [iterations]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/postgres.h"
+#include "../src/random_functions.h"
+
+namespace {
+	using namespace std::literals;
+	using pqxx::operator"" _zv;
+	using Clock = std::chrono::steady_clock;
+
+	constexpr int PAGE_SIZE = 100;
+
+	// страница рекордов текстовым запросом, как до перехода на подготовленные запросы
+	void ReadPageText(pqxx::connection& conn, int start, std::vector<postgres::RetiredPlayer>& records) {
+		pqxx::read_transaction read_trans(conn);
+		const std::string query = "SELECT name, score, playtime FROM retired_players ORDER BY score DESC, playtime, name OFFSET "s
+			+ read_trans.quote(start) + " LIMIT "s + read_trans.quote(PAGE_SIZE) + ";"s;
+		for (const auto& row : read_trans.exec(query)) {
+			records.push_back({ 0, row[0].as<std::string>(), row[1].as<int>(), row[2].as<int>() });
+		}
+	}
+
+	template <typename Fn>
+	double MeasureMicrosPerCall(int iterations, Fn&& fn) {
+		const auto start = Clock::now();
+		for (int i = 0; i < iterations; ++i) {
+			fn(i);
+		}
+		const std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+		return elapsed.count() / iterations;
+	}
+}
+
+int main(int argc, const char* argv[]) {
+	const char* db_url = std::getenv("GAME_DB_URL");
+	if (db_url == nullptr) {
+		std::cerr << "GAME_DB_URL is not specified"sv << std::endl;
+		return EXIT_FAILURE;
+	}
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 10000;
+	if (iterations <= 0) {
+		std::cerr << "Usage: prepared_statements_bench [iterations]"sv << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try {
+		pqxx::connection conn{ db_url };
+		postgres::CreateTable(conn);
+		postgres::PrepareStatements(conn);
+
+		std::vector<postgres::RetiredPlayer> records;
+		records.reserve(PAGE_SIZE);
+
+		const double text_read = MeasureMicrosPerCall(iterations, [&](int i) {
+			records.clear();
+			ReadPageText(conn, i % 10 * PAGE_SIZE, records);
+		});
+		const double prepared_read = MeasureMicrosPerCall(iterations, [&](int i) {
+			records.clear();
+			postgres::ReadRetiredFromDatabase(conn, i % 10 * PAGE_SIZE, PAGE_SIZE, records);
+		});
+
+		// вставки откатываются, чтобы не засорять таблицу рекордов
+		const std::vector<postgres::RetiredPlayer> player{ { 0, "bench"s, 0, 0 } };
+		const double text_insert = MeasureMicrosPerCall(iterations, [&](int) {
+			pqxx::work work{ conn };
+			work.exec_params("INSERT INTO retired_players (id, name, score, playtime) VALUES ($1, $2, $3, $4);"_zv,
+				random_functions::RandomHexString(32), player[0].name, player[0].score, player[0].play_time_s);
+			work.abort();
+		});
+		const double prepared_insert = MeasureMicrosPerCall(iterations, [&](int) {
+			pqxx::work work{ conn };
+			work.exec_prepared(postgres::Statements::INSERT_RETIRED,
+				random_functions::RandomHexString(32), player[0].name, player[0].score, player[0].play_time_s);
+			work.abort();
+		});
+
+		std::cout << "iterations: "sv << iterations << '\n'
+			<< "read page, text:       "sv << text_read << " us/call\n"sv
+			<< "read page, prepared:   "sv << prepared_read << " us/call\n"sv
+			<< "insert, text:          "sv << text_insert << " us/call\n"sv
+			<< "insert, prepared:      "sv << prepared_insert << " us/call"sv << std::endl;
+	}
+	catch (const std::exception& ex) {
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
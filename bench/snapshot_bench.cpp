@@ -0,0 +1,133 @@
+// Сравнение текстового и двоичного форматов файла состояния игры и уровней сжатия.
+// Запуск: snapshot_bench [players] [maps]
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../src/snapshot.h"
+
+namespace {
+	using namespace std::literals;
+	using Clock = std::chrono::steady_clock;
+
+	// Состояние игры из players игроков, поровну распределённых по maps картам
+	model::GameRepr MakeGameRepr(int players, int maps) {
+		model::GameRepr game_repr;
+		for (int i = 0; i < players; ++i) {
+			model::Player player;
+			player.id_ = static_cast<uint64_t>(i);
+			player.map_name_ = "map"s + std::to_string(i % maps);
+			player.name_ = "player"s + std::to_string(i);
+			player.hash_ = std::string(32, static_cast<char>('a' + i % 6)) + std::to_string(i);
+			player.pos_ = { i * 0.5, i * 0.25 };
+			player.speed_ = { 1.0, 0.0 };
+			player.direction_ = model::Direction::EAST;
+			player.score_ = static_cast<uint64_t>(i % 100);
+			player.join_time_ = 1.0;
+			for (uint64_t item = 0; item < 3; ++item) {
+				model::LootWithId loot;
+				loot.id = item;
+				loot.type = item % 2;
+				player.bag_.push_back(loot);
+			}
+			game_repr.hash_to_palyer_id[player.hash_] = player.id_;
+			game_repr.hash_to_map_name[player.hash_] = player.map_name_;
+			game_repr.palyer_id_to_player_name[player.id_] = player.name_;
+			game_repr.map_name_to_loot[player.map_name_].push_back({ 1, { i * 0.1, 0.0 } });
+			game_repr.map_name_to_players[player.map_name_].push_back(std::move(player));
+		}
+		return game_repr;
+	}
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	void Measure(std::string_view name, const model::GameRepr& game_repr, model::SnapshotFormat format) {
+		auto start = Clock::now();
+		std::ostringstream out;
+		snapshot::Save(game_repr, format, out);
+		const std::string data = out.str();
+		const double save_ms = MillisecondsSince(start);
+
+		start = Clock::now();
+		model::GameRepr loaded;
+		snapshot::Load(data, loaded);
+		const double load_ms = MillisecondsSince(start);
+
+		// чтение из файла через отображение в память, карты разбираются параллельно
+		const auto path = std::filesystem::temp_directory_path() / ("snapshot_bench_"s + std::string(name));
+		snapshot::WriteFile(game_repr, { .format = format }, path);
+		start = Clock::now();
+		model::GameRepr loaded_from_file;
+		snapshot::LoadFile(path, loaded_from_file);
+		const double load_file_ms = MillisecondsSince(start);
+		std::filesystem::remove(path);
+
+		std::cout << name << ": size "sv << data.size() << " bytes, save "sv << save_ms
+			<< " ms, load "sv << load_ms << " ms, load from file "sv << load_file_ms << " ms"sv << std::endl;
+	}
+
+	// Файлы по картам пишутся и читаются параллельно, замеряется только работа с диском
+	void MeasureSharded(const model::GameRepr& game_repr) {
+		const auto dir = std::filesystem::temp_directory_path() / "snapshot_bench_sharded"s;
+		std::filesystem::create_directories(dir);
+		const auto path = dir / "state"s;
+
+		auto start = Clock::now();
+		snapshot::WriteFile(game_repr, { .format = model::SnapshotFormat::SHARDED }, path);
+		const double save_ms = MillisecondsSince(start);
+
+		start = Clock::now();
+		model::GameRepr loaded;
+		snapshot::LoadFile(path, loaded);
+		const double load_ms = MillisecondsSince(start);
+		std::filesystem::remove_all(dir);
+
+		std::cout << snapshot::Literals::FORMAT_SHARDED << ": save to files "sv << save_ms
+			<< " ms, load from files "sv << load_ms << " ms"sv << std::endl;
+	}
+
+	// Сжатие снимка: меньше данных пишется на диск ценой времени процессора на сжатие и распаковку
+	void MeasureCompression(const model::GameRepr& game_repr, model::SnapshotFormat format, int level) {
+		const auto path = std::filesystem::temp_directory_path() / "snapshot_bench_compressed"s;
+
+		auto start = Clock::now();
+		snapshot::WriteFile(game_repr, { .format = format, .compression_level = level }, path);
+		const double save_ms = MillisecondsSince(start);
+		const auto size = std::filesystem::file_size(path);
+
+		start = Clock::now();
+		model::GameRepr loaded;
+		snapshot::LoadFile(path, loaded);
+		const double load_ms = MillisecondsSince(start);
+		std::filesystem::remove(path);
+
+		std::cout << (format == model::SnapshotFormat::TEXT ? snapshot::Literals::FORMAT_TEXT : snapshot::Literals::FORMAT_BINARY)
+			<< " gzip "sv << level << ": size "sv << size << " bytes, save to file "sv << save_ms
+			<< " ms, load from file "sv << load_ms << " ms"sv << std::endl;
+	}
+}
+
+int main(int argc, const char* argv[]) {
+	const int players = argc > 1 ? std::atoi(argv[1]) : 200000;
+	const int maps = argc > 2 ? std::atoi(argv[2]) : 4;
+	if (players <= 0 || maps <= 0) {
+		std::cerr << "Usage: snapshot_bench [players] [maps]"sv << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const auto game_repr = MakeGameRepr(players, maps);
+	std::cout << "players: "sv << players << ", maps: "sv << maps << std::endl;
+	Measure(snapshot::Literals::FORMAT_TEXT, game_repr, model::SnapshotFormat::TEXT);
+	Measure(snapshot::Literals::FORMAT_BINARY, game_repr, model::SnapshotFormat::BINARY);
+	MeasureSharded(game_repr);
+	for (const int level : { 1, 6, 9 }) {
+		MeasureCompression(game_repr, model::SnapshotFormat::BINARY, level);
+	}
+	MeasureCompression(game_repr, model::SnapshotFormat::TEXT, 6);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+// Сравнение JSON и двоичного формата состояния карты: размер тела и время сборки, для двоичного
+// формата также время разбора. JSON собирается JsonWriter, как в кэше ответов сервера.
+// Запуск: state_encoding_bench [players] [loot]
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <string>
+
+#include "../src/json_writer.h"
+#include "../src/state_encoding.h"
+
+namespace {
+	using namespace std::literals;
+	using Clock = std::chrono::steady_clock;
+
+	// Число повторов замера, время выводится на одну сборку
+	constexpr int REPEATS = 20;
+
+	std::deque<model::Player> MakePlayers(int count) {
+		std::deque<model::Player> players;
+		for (int i = 0; i < count; ++i) {
+			model::Player player;
+			player.id_ = static_cast<uint64_t>(i);
+			player.pos_ = { i * 0.731, i * 0.257 };
+			player.speed_ = { 1.0, 0.0 };
+			player.direction_ = model::Direction::EAST;
+			player.score_ = static_cast<uint64_t>(i % 1000);
+			for (uint64_t item = 0; item < 3; ++item) {
+				model::LootWithId loot;
+				loot.id = item;
+				loot.type = item % 2;
+				player.bag_.push_back(loot);
+			}
+			players.push_back(std::move(player));
+		}
+		return players;
+	}
+
+	std::deque<model::Loot> MakeLoot(int count) {
+		std::deque<model::Loot> loot;
+		for (int i = 0; i < count; ++i) {
+			loot.push_back({ static_cast<uint64_t>(i % 4), { i * 0.113, i * 0.541 } });
+		}
+		return loot;
+	}
+
+	void WriteCoord(json_writer::JsonWriter& writer, const model::FloatCoord& coord) {
+		writer.StartArray();
+		writer.Double(coord.x);
+		writer.Double(coord.y);
+		writer.EndArray();
+	}
+
+	// Тело ответа /api/v1/game/state в том же виде, что собирает сервер
+	void EncodeJson(const std::deque<model::Player>& players, const std::deque<model::Loot>& loot, std::string& out) {
+		constexpr json_writer::KeyFragment PLAYERS{ "players" };
+		constexpr json_writer::KeyFragment LOST_OBJECTS{ "lostObjects" };
+		constexpr json_writer::KeyFragment POS{ "pos" };
+		constexpr json_writer::KeyFragment SPEED{ "speed" };
+		constexpr json_writer::KeyFragment DIR{ "dir" };
+		constexpr json_writer::KeyFragment BAG{ "bag" };
+		constexpr json_writer::KeyFragment SCORE{ "score" };
+		constexpr json_writer::KeyFragment ID{ "id" };
+		constexpr json_writer::KeyFragment TYPE{ "type" };
+
+		out.clear();
+		json_writer::JsonWriter writer{ out };
+		writer.StartObject();
+		writer.Key(PLAYERS);
+		writer.StartObject();
+		for (const auto& player : players) {
+			writer.Key(std::to_string(player.id_));
+			writer.StartObject();
+			writer.Key(POS);
+			WriteCoord(writer, player.pos_);
+			writer.Key(SPEED);
+			WriteCoord(writer, player.speed_);
+			writer.Key(DIR);
+			writer.String(std::string(1, static_cast<char>(player.direction_)));
+			writer.Key(BAG);
+			writer.StartArray();
+			for (const auto& item : player.bag_) {
+				writer.StartObject();
+				writer.Key(ID);
+				writer.Uint(item.id);
+				writer.Key(TYPE);
+				writer.Uint(item.type);
+				writer.EndObject();
+			}
+			writer.EndArray();
+			writer.Key(SCORE);
+			writer.Uint(player.score_);
+			writer.EndObject();
+		}
+		writer.EndObject();
+		writer.Key(LOST_OBJECTS);
+		writer.StartObject();
+		for (size_t id = 0; id < loot.size(); ++id) {
+			writer.Key(std::to_string(id));
+			writer.StartObject();
+			writer.Key(TYPE);
+			writer.Uint(loot[id].type);
+			writer.Key(POS);
+			WriteCoord(writer, loot[id].coord);
+			writer.EndObject();
+		}
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	template <typename Fn>
+	double MillisecondsPerRun(Fn&& fn) {
+		const auto start = Clock::now();
+		for (int i = 0; i < REPEATS; ++i) {
+			fn();
+		}
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / REPEATS;
+	}
+}
+
+int main(int argc, const char* argv[]) {
+	const int players_count = argc > 1 ? std::atoi(argv[1]) : 10000;
+	const int loot_count = argc > 2 ? std::atoi(argv[2]) : 1000;
+	if (players_count < 0 || loot_count < 0) {
+		std::cerr << "Usage: state_encoding_bench [players] [loot]"sv << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const auto players = MakePlayers(players_count);
+	const auto loot = MakeLoot(loot_count);
+	std::cout << "players: "sv << players_count << ", loot: "sv << loot_count << std::endl;
+
+	// буфер переиспользуется между сборками, как в кэше ответов
+	std::string json_body;
+	const double json_encode_ms = MillisecondsPerRun([&] { EncodeJson(players, loot, json_body); });
+	std::cout << "json: size "sv << json_body.size() << " bytes, encode "sv << json_encode_ms
+		<< " ms"sv << std::endl;
+
+	std::string binary_body;
+	const double binary_encode_ms = MillisecondsPerRun([&] { binary_body = state_encoding::EncodeState(players, loot); });
+	const double binary_decode_ms = MillisecondsPerRun([&] {
+		std::deque<model::Player> decoded_players;
+		std::deque<model::Loot> decoded_loot;
+		state_encoding::DecodeState(binary_body, decoded_players, decoded_loot);
+	});
+	std::cout << state_encoding::Literals::CONTENT_TYPE << ": size "sv << binary_body.size()
+		<< " bytes, encode "sv << binary_encode_ms << " ms, decode "sv << binary_decode_ms << " ms"sv << std::endl;
+	return EXIT_SUCCESS;
+}
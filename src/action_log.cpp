@@ -0,0 +1,356 @@
+#include "action_log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+
+#include "binary_io.h"
+#include "file_io.h"
+#include "my_logger.h"
+
+namespace action_log {
+	using namespace std::literals;
+	using file_io::Crc32;
+	using file_io::ThrowSystemError;
+	using file_io::WriteAll;
+
+	namespace {
+		// Заголовок сегмента: сигнатура и версия формата
+		constexpr std::string_view FILE_HEADER = "ACTLOG01"sv;
+		// Размер и crc32 данных записи
+		constexpr size_t RECORD_PREFIX_SIZE = 8;
+		// Запись больше этого размера считаем повреждённой
+		constexpr size_t MAX_RECORD_SIZE = 16 * 1024 * 1024;
+		// Номер сегмента в имени файла, длиннее - чужой файл
+		constexpr size_t MAX_SEGMENT_DIGITS = 19;
+
+		// Тип записи, первый байт данных
+		enum class RecordType : uint8_t {
+			JOIN = 1,
+			MOVE = 2,
+			TICK = 3,
+			RETIRE = 4,
+		};
+
+		void EncodePayload(const Join& join, binary_io::BinaryWriter& writer) {
+			writer.WriteU8(static_cast<uint8_t>(RecordType::JOIN));
+			writer.WriteString(join.map_name);
+			writer.WriteString(join.token);
+			writer.WriteString(join.user_name);
+			writer.WriteVarint(join.id);
+			writer.WriteCoord(join.pos);
+		}
+
+		void EncodePayload(const Move& move, binary_io::BinaryWriter& writer) {
+			writer.WriteU8(static_cast<uint8_t>(RecordType::MOVE));
+			writer.WriteString(move.map_name);
+			writer.WriteString(move.token);
+			writer.WriteString(move.direction);
+		}
+
+		void EncodePayload(const Tick& tick, binary_io::BinaryWriter& writer) {
+			writer.WriteU8(static_cast<uint8_t>(RecordType::TICK));
+			writer.WriteVarint(static_cast<uint64_t>(tick.period_ms));
+			writer.WriteVarint(tick.loot.size());
+			for (const auto& spawn : tick.loot) {
+				writer.WriteString(spawn.map_name);
+				writer.WriteVarint(spawn.loot.type);
+				writer.WriteCoord(spawn.loot.coord);
+			}
+		}
+
+		void EncodePayload(const Retire& retire, binary_io::BinaryWriter& writer) {
+			writer.WriteU8(static_cast<uint8_t>(RecordType::RETIRE));
+			writer.WriteVarint(retire.players.size());
+			for (const auto& player : retire.players) {
+				writer.WriteString(player.record_id);
+				writer.WriteString(player.name);
+				writer.WriteVarint(static_cast<uint32_t>(player.id));
+				writer.WriteVarint(static_cast<uint32_t>(player.score));
+				writer.WriteVarint(static_cast<uint32_t>(player.play_time_s));
+			}
+		}
+
+		Record DecodePayload(std::string_view payload) {
+			binary_io::BinaryReader reader{ payload };
+			switch (static_cast<RecordType>(reader.ReadU8())) {
+			case RecordType::JOIN: {
+				Join join;
+				join.map_name = reader.ReadString();
+				join.token = reader.ReadString();
+				join.user_name = reader.ReadString();
+				join.id = reader.ReadVarint();
+				join.pos = reader.ReadCoord();
+				return join;
+			}
+			case RecordType::MOVE: {
+				Move move;
+				move.map_name = reader.ReadString();
+				move.token = reader.ReadString();
+				move.direction = reader.ReadString();
+				return move;
+			}
+			case RecordType::TICK: {
+				Tick tick;
+				tick.period_ms = static_cast<int64_t>(reader.ReadVarint());
+				for (uint64_t i = 0, count = reader.ReadVarint(); i < count; ++i) {
+					LootSpawn spawn;
+					spawn.map_name = reader.ReadString();
+					spawn.loot.type = reader.ReadVarint();
+					spawn.loot.coord = reader.ReadCoord();
+					tick.loot.push_back(std::move(spawn));
+				}
+				return tick;
+			}
+			case RecordType::RETIRE: {
+				Retire retire;
+				for (uint64_t i = 0, count = reader.ReadVarint(); i < count; ++i) {
+					retired_repository::RetiredPlayer player;
+					player.record_id = reader.ReadString();
+					player.name = reader.ReadString();
+					player.id = static_cast<int>(reader.ReadVarint());
+					player.score = static_cast<int>(reader.ReadVarint());
+					player.play_time_s = static_cast<int>(reader.ReadVarint());
+					retire.players.push_back(std::move(player));
+				}
+				return retire;
+			}
+			}
+			throw std::runtime_error("Unknown action log record type");
+		}
+	}  // namespace
+
+	void EncodeRecord(const Record& record, std::string& out) {
+		std::string payload;
+		binary_io::BinaryWriter payload_writer{ payload };
+		std::visit([&payload_writer](const auto& value) { EncodePayload(value, payload_writer); }, record);
+
+		binary_io::BinaryWriter writer{ out };
+		writer.WriteU32(static_cast<uint32_t>(payload.size()));
+		writer.WriteU32(Crc32(payload));
+		out += payload;
+	}
+
+	size_t DecodeRecord(std::string_view data, Record& record) {
+		if (data.size() < RECORD_PREFIX_SIZE) {
+			return 0;
+		}
+		binary_io::BinaryReader prefix{ data.substr(0, RECORD_PREFIX_SIZE) };
+		const size_t payload_size = prefix.ReadU32();
+		const uint32_t crc = prefix.ReadU32();
+		if (payload_size == 0 || payload_size > MAX_RECORD_SIZE
+			|| data.size() - RECORD_PREFIX_SIZE < payload_size) {
+			return 0;
+		}
+		const std::string_view payload = data.substr(RECORD_PREFIX_SIZE, payload_size);
+		if (crc != Crc32(payload)) {
+			return 0;
+		}
+		try {
+			record = DecodePayload(payload);
+		}
+		catch (const std::exception&) {
+			return 0;
+		}
+		return RECORD_PREFIX_SIZE + payload_size;
+	}
+
+	ActionLog::ActionLog(std::filesystem::path path)
+		: path_(std::move(path)) {
+		const auto segments = ListSegments();
+		first_own_segment_ = segments.empty() ? 1 : segments.back() + 1;
+		OpenSegment(first_own_segment_);
+		buffered_segment_ = first_own_segment_;
+		flush_thread_ = std::thread([this] { FlushLoop(); });
+	}
+
+	ActionLog::~ActionLog() {
+		{
+			std::lock_guard lock{ mtx_ };
+			stop_ = true;
+		}
+		cond_var_.notify_all();
+		flush_thread_.join();
+		::close(fd_);
+	}
+
+	void ActionLog::Append(const Record& record) {
+		std::string data;
+		EncodeRecord(record, data);
+		std::lock_guard lock{ mtx_ };
+		buffer_ += data;
+	}
+
+	uint64_t ActionLog::Rotate() {
+		// вызывается под блокировками игры, поэтому без записи на диск: записи до смены
+		// сегмента остаются в старом сегменте, файл нового создаёт поток сброса
+		std::lock_guard lock{ mtx_ };
+		sealed_.push_back(std::move(buffer_));
+		buffer_.clear();
+		return ++buffered_segment_;
+	}
+
+	void ActionLog::RemoveBefore(uint64_t segment) {
+		for (const uint64_t number : ListSegments()) {
+			if (number >= segment) {
+				break;
+			}
+			std::error_code ec;
+			std::filesystem::remove(SegmentPath(number), ec);
+			if (ec) {
+				logger::LogError("action log remove"sv, ec.message());
+			}
+		}
+	}
+
+	size_t ActionLog::Replay(uint64_t from_segment, const std::function<void(const Record&)>& apply) const {
+		size_t applied = 0;
+		for (const uint64_t number : ListSegments()) {
+			if (number < from_segment) {
+				continue;
+			}
+			if (number >= first_own_segment_) {
+				break;
+			}
+			std::ifstream file{ SegmentPath(number), std::ios::binary };
+			std::stringstream ss;
+			ss << file.rdbuf();
+			std::string_view data = ss.view();
+			if (data.substr(0, FILE_HEADER.size()) != FILE_HEADER) {
+				throw std::runtime_error("Unknown action log format: "s + SegmentPath(number).string());
+			}
+			data.remove_prefix(FILE_HEADER.size());
+
+			Record record;
+			while (size_t record_size = DecodeRecord(data, record)) {
+				apply(record);
+				++applied;
+				data.remove_prefix(record_size);
+			}
+			if (!data.empty()) {
+				// хвост, не записанный полностью перед падением
+				logger::LogError("action log replay"sv, "Truncated segment "s + SegmentPath(number).string());
+			}
+		}
+		return applied;
+	}
+
+	void ActionLog::OpenSegment(uint64_t segment) {
+		const auto path = SegmentPath(segment);
+		const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			ThrowSystemError("Failed to open action log "s + path.string());
+		}
+		try {
+			WriteAll(fd, FILE_HEADER);
+		}
+		catch (...) {
+			::close(fd);
+			throw;
+		}
+		if (fd_ >= 0) {
+			::fdatasync(fd_);
+			::close(fd_);
+		}
+		fd_ = fd;
+		segment_ = segment;
+	}
+
+	void ActionLog::FlushLoop() {
+		while (true) {
+			bool stop = false;
+			{
+				std::unique_lock lock{ mtx_ };
+				stop = cond_var_.wait_for(lock, SYNC_PERIOD, [this] { return stop_; });
+			}
+			{
+				std::lock_guard io_lock{ io_mtx_ };
+				try {
+					WriteBuffered();
+				}
+				catch (const std::exception& ex) {
+					logger::LogError("action log flush"sv, ex.what());
+				}
+			}
+			if (stop) {
+				return;
+			}
+		}
+	}
+
+	void ActionLog::WriteBuffered() {
+		std::vector<std::string> sealed;
+		std::string data;
+		{
+			std::lock_guard lock{ mtx_ };
+			sealed.swap(sealed_);
+			data.swap(buffer_);
+		}
+
+		size_t rotated = 0;
+		try {
+			for (; rotated < sealed.size(); ++rotated) {
+				// если запись не удалась, записи сегмента теряются, как и при обычном сбросе,
+				// а смена сегмента остаётся в очереди
+				const std::string chunk = std::move(sealed[rotated]);
+				sealed[rotated].clear();
+				WriteAll(fd_, chunk);
+				OpenSegment(segment_ + 1);
+			}
+		}
+		catch (...) {
+			// несменённые сегменты и записи после них вернутся в буфер и будут записаны
+			// следующим сбросом, перед записями, сделанными за это время
+			std::lock_guard lock{ mtx_ };
+			if (sealed_.empty()) {
+				buffer_.insert(0, data);
+			} else {
+				sealed_.front().insert(0, data);
+			}
+			sealed_.insert(sealed_.begin(), std::make_move_iterator(sealed.begin() + rotated),
+				std::make_move_iterator(sealed.end()));
+			throw;
+		}
+
+		if (data.empty()) {
+			return;
+		}
+		// одна синхронизация на все записи, сделанные за период
+		WriteAll(fd_, data);
+		::fdatasync(fd_);
+	}
+
+	std::vector<uint64_t> ActionLog::ListSegments() const {
+		std::vector<uint64_t> segments;
+		const auto dir = path_.has_parent_path() ? path_.parent_path() : std::filesystem::path{ "."s };
+		const std::string prefix = path_.filename().string() + "."s;
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+			const std::string name = entry.path().filename().string();
+			if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+				continue;
+			}
+			const std::string number = name.substr(prefix.size());
+			if (number.size() > MAX_SEGMENT_DIGITS
+				|| !std::all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+				continue;
+			}
+			segments.push_back(std::stoull(number));
+		}
+		std::sort(segments.begin(), segments.end());
+		return segments;
+	}
+
+	std::filesystem::path ActionLog::SegmentPath(uint64_t segment) const {
+		return path_.string() + "."s + std::to_string(segment);
+	}
+
+}  // namespace action_log
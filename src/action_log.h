@@ -0,0 +1,140 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "model.h"
+#include "retired_repository.h"
+
+namespace action_log {
+
+	// Вход игрока на карту; позиция записывается, потому что она может быть случайной
+	struct Join {
+		std::string map_name;
+		std::string token;
+		std::string user_name;
+		uint64_t id{ 0 };
+		model::FloatCoord pos;
+	};
+
+	// Команда движения игрока
+	struct Move {
+		std::string map_name;
+		std::string token;
+		std::string direction;
+	};
+
+	// Лут, появившийся на карте за тик
+	struct LootSpawn {
+		std::string map_name;
+		model::Loot loot;
+	};
+
+	// Тик игрового времени; появившийся лут случаен, поэтому записывается вместе с тиком
+	struct Tick {
+		int64_t period_ms{ 0 };
+		std::vector<LootSpawn> loot;
+	};
+
+	// Выбывшие игроки с заранее выданными идентификаторами строк БД
+	struct Retire {
+		std::vector<retired_repository::RetiredPlayer> players;
+	};
+
+	using Record = std::variant<Join, Move, Tick, Retire>;
+
+	/// @brief кодирование записи журнала: [размер данных][crc32 данных][данные]
+	/// @param record запись
+	/// @param out буфер, в конец которого дописывается запись
+	void EncodeRecord(const Record& record, std::string& out);
+
+	/// @brief разбор записи журнала
+	/// @param data данные, начинающиеся с записи
+	/// @param record разобранная запись
+	/// @return длина записи; 0 - запись неполная или повреждена
+	size_t DecodeRecord(std::string_view data, Record& record);
+
+	/// @brief Журнал действий игроков (write-ahead log).
+	/// Журнал состоит из сегментов <path>.<номер>. Записи копятся в памяти и пачкой
+	/// дописываются в текущий сегмент с fdatasync раз в SYNC_PERIOD. Контрольная точка -
+	/// это снимок состояния игры: перед её записью начинается новый сегмент, а после
+	/// записи снимка сегменты до него удаляются. При старте загружается снимок и
+	/// применяются записи сегментов, начиная с указанного в снимке. Вся работа с файлами,
+	/// включая смену сегмента, идёт в потоке сброса.
+	class ActionLog {
+	public:
+		/// @param path путь к журналу, номер сегмента добавляется через точку
+		explicit ActionLog(std::filesystem::path path);
+
+		ActionLog(const ActionLog&) = delete;
+		ActionLog& operator=(const ActionLog&) = delete;
+
+		/// @brief сбрасывает накопленные записи на диск
+		~ActionLog();
+
+		/// @brief добавить запись в журнал
+		/// @param record запись
+		void Append(const Record& record);
+
+		/// @brief начать новый сегмент для контрольной точки. Только отмечает границу в буфере:
+		/// записи до неё поток сброса допишет в старый сегмент, а файл нового сегмента создаст сам
+		/// @return номер нового сегмента; записи до него войдут в снимок
+		uint64_t Rotate();
+
+		/// @brief удалить сегменты, вошедшие в записанный снимок
+		/// @param segment номер первого сегмента, не вошедшего в снимок
+		void RemoveBefore(uint64_t segment);
+
+		/// @brief применить записи сегментов, созданных до открытия журнала
+		/// @param from_segment номер первого применяемого сегмента
+		/// @param apply обработчик записи
+		/// @return количество применённых записей
+		size_t Replay(uint64_t from_segment, const std::function<void(const Record&)>& apply) const;
+
+	private:
+		void OpenSegment(uint64_t segment);
+		void FlushLoop();
+
+		/// @brief записать накопленные записи и сменить сегменты на отмеченных границах,
+		/// вызывается под io_mtx_
+		void WriteBuffered();
+
+		/// @brief номера существующих сегментов по возрастанию
+		std::vector<uint64_t> ListSegments() const;
+		std::filesystem::path SegmentPath(uint64_t segment) const;
+
+		// Как часто записи журнала сбрасываются на диск
+		constexpr static std::chrono::milliseconds SYNC_PERIOD{ 50 };
+
+		std::filesystem::path path_;
+
+		// запись в файл и смена сегмента
+		std::mutex io_mtx_;
+		int fd_{ -1 };
+		uint64_t segment_{ 0 };
+		// сегменты с номером меньше этого созданы до открытия журнала
+		uint64_t first_own_segment_{ 0 };
+
+		// накопленные записи
+		std::mutex mtx_;
+		std::condition_variable cond_var_;
+		// записи сегментов, закрытых Rotate, но ещё не записанных; за каждой - смена сегмента
+		std::vector<std::string> sealed_;
+		// записи сегмента buffered_segment_
+		std::string buffer_;
+		// сегмент, в который попадут записи buffer_
+		uint64_t buffered_segment_{ 0 };
+		bool stop_{ false };
+
+		std::thread flush_thread_;
+	};
+
+}  // namespace action_log
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "model.h"
+
+namespace binary_io {
+
+	// Запись чисел в порядке little-endian и строк с длиной впереди
+	class BinaryWriter {
+	public:
+		explicit BinaryWriter(std::string& out)
+			: out_(out) {
+		}
+
+		void WriteU8(uint8_t value) {
+			out_.push_back(static_cast<char>(value));
+		}
+
+		void WriteU32(uint32_t value) {
+			for (int i = 0; i < 4; ++i) {
+				out_.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+			}
+		}
+
+		void WriteU64(uint64_t value) {
+			for (int i = 0; i < 8; ++i) {
+				out_.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+			}
+		}
+
+		// беззнаковое целое в формате LEB128: малые значения занимают один байт
+		void WriteVarint(uint64_t value) {
+			while (value >= 0x80) {
+				out_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+				value >>= 7;
+			}
+			out_.push_back(static_cast<char>(value));
+		}
+
+		void WriteDouble(double value) {
+			uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			WriteU64(bits);
+		}
+
+		void WriteString(std::string_view value) {
+			WriteVarint(value.size());
+			out_.append(value);
+		}
+
+		void WriteCoord(const model::FloatCoord& coord) {
+			WriteDouble(coord.x);
+			WriteDouble(coord.y);
+		}
+
+	private:
+		std::string& out_;
+	};
+
+	// Чтение значений, записанных BinaryWriter, с проверкой границ
+	class BinaryReader {
+	public:
+		explicit BinaryReader(std::string_view data)
+			: data_(data) {
+		}
+
+		bool AtEnd() const noexcept {
+			return data_.empty();
+		}
+
+		uint8_t ReadU8() {
+			return static_cast<uint8_t>(Take(1)[0]);
+		}
+
+		uint32_t ReadU32() {
+			const auto bytes = Take(4);
+			uint32_t value = 0;
+			for (int i = 0; i < 4; ++i) {
+				value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+			}
+			return value;
+		}
+
+		uint64_t ReadU64() {
+			const auto bytes = Take(8);
+			uint64_t value = 0;
+			for (int i = 0; i < 8; ++i) {
+				value |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+			}
+			return value;
+		}
+
+		uint64_t ReadVarint() {
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				const auto byte = static_cast<unsigned char>(Take(1)[0]);
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) {
+					return value;
+				}
+			}
+			throw std::runtime_error("Malformed varint");
+		}
+
+		double ReadDouble() {
+			const uint64_t bits = ReadU64();
+			double value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		std::string_view ReadStringView() {
+			return Take(ReadVarint());
+		}
+
+		std::string ReadString() {
+			return std::string(ReadStringView());
+		}
+
+		model::FloatCoord ReadCoord() {
+			model::FloatCoord coord;
+			coord.x = ReadDouble();
+			coord.y = ReadDouble();
+			return coord;
+		}
+
+		std::string_view Take(uint64_t size) {
+			if (size > data_.size()) {
+				throw std::runtime_error("Truncated binary data");
+			}
+			auto result = data_.substr(0, static_cast<size_t>(size));
+			data_.remove_prefix(static_cast<size_t>(size));
+			return result;
+		}
+
+	private:
+		std::string_view data_;
+	};
+
+}  // namespace binary_io
@@ -0,0 +1,88 @@
+#include "content_encoding.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+
+namespace content_encoding {
+
+	namespace {
+		bool IEquals(std::string_view lhs, std::string_view rhs) {
+			return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](char l, char r) {
+				return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r));
+			});
+		}
+
+		/// @brief q=0, q=0.0, q=0.000 - кодировка запрещена
+		bool IsZeroQuality(std::string_view params) {
+			while (!params.empty()) {
+				const auto semicolon = params.find(';');
+				const auto param = Trim(params.substr(0, semicolon));
+				params = semicolon == std::string_view::npos ? std::string_view{} : params.substr(semicolon + 1);
+				if (param.size() < 2 || std::tolower(static_cast<unsigned char>(param[0])) != 'q' || param[1] != '=') {
+					continue;
+				}
+				const auto value = param.substr(2);
+				return !value.empty() && value.find_first_not_of("0."sv) == std::string_view::npos;
+			}
+			return false;
+		}
+	}  // namespace
+
+	std::string_view Trim(std::string_view str) {
+		while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+			str.remove_prefix(1);
+		}
+		while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+			str.remove_suffix(1);
+		}
+		return str;
+	}
+
+	std::string Gzip(std::string_view data, int level) {
+		std::string out;
+		{
+			boost::iostreams::filtering_ostream stream;
+			stream.push(boost::iostreams::gzip_compressor(boost::iostreams::gzip_params(level)));
+			stream.push(boost::iostreams::back_inserter(out));
+			stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+		}
+		return out;
+	}
+
+	bool AcceptsGzip(std::string_view accept_encoding) {
+		bool accepted = false;
+		while (!accept_encoding.empty()) {
+			const auto comma = accept_encoding.find(',');
+			const auto item = accept_encoding.substr(0, comma);
+			accept_encoding = comma == std::string_view::npos ? std::string_view{} : accept_encoding.substr(comma + 1);
+
+			const auto semicolon = item.find(';');
+			const auto coding = Trim(item.substr(0, semicolon));
+			const bool refused = semicolon != std::string_view::npos && IsZeroQuality(item.substr(semicolon + 1));
+			if (IEquals(coding, Literals::GZIP)) {
+				// явное указание gzip важнее "*"
+				return !refused;
+			}
+			if (coding == "*"sv) {
+				accepted = !refused;
+			}
+		}
+		return accepted;
+	}
+
+	std::shared_ptr<const std::string> Compressor::Compress(std::string_view body) const {
+		if (!Enabled() || body.size() < threshold_) {
+			return nullptr;
+		}
+		auto compressed = Gzip(body, level_);
+		if (compressed.size() >= body.size()) {
+			return nullptr;
+		}
+		return std::make_shared<const std::string>(std::move(compressed));
+	}
+
+}  // namespace content_encoding
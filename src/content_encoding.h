@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace content_encoding {
+	using namespace std::literals;
+
+	struct Literals {
+		Literals() = delete;
+		// Значение заголовков Accept-Encoding и Content-Encoding
+		constexpr static std::string_view GZIP = "gzip"sv;
+	};
+
+	// Уровень сжатия, при котором ответы не сжимаются
+	constexpr int NO_COMPRESSION = 0;
+	// Тела меньше этого размера не сжимаются: заголовок и словарь gzip съедают выигрыш
+	constexpr size_t DEFAULT_THRESHOLD = 1024;
+
+	/// @brief сжатие данных в формате gzip
+	/// @param data данные
+	/// @param level уровень сжатия 1 (быстрее) - 9 (меньше)
+	/// @return сжатые данные
+	std::string Gzip(std::string_view data, int level);
+
+	/// @brief строка без пробелов и табуляций по краям, как в значениях заголовков HTTP
+	std::string_view Trim(std::string_view str);
+
+	/// @brief принимает ли клиент gzip по значению заголовка Accept-Encoding;
+	/// кодировки с q=0 считаются непринимаемыми
+	/// @param accept_encoding значение заголовка
+	bool AcceptsGzip(std::string_view accept_encoding);
+
+	/// @brief Сжатие тел ответов, собранных заранее. Сжатая версия хранится рядом с исходной
+	/// и отдаётся клиентам с Accept-Encoding: gzip, так что тело сжимается один раз
+	class Compressor {
+	public:
+		Compressor() = default;
+
+		/// @param level уровень сжатия gzip, NO_COMPRESSION - ответы не сжимаются
+		/// @param threshold тела меньше этого размера не сжимаются
+		Compressor(int level, size_t threshold)
+			: level_(level)
+			, threshold_(threshold) {
+		}
+
+		bool Enabled() const noexcept {
+			return level_ != NO_COMPRESSION;
+		}
+
+		/// @brief сжатая версия тела
+		/// @param body тело ответа
+		/// @return nullptr - сжатие выключено, тело меньше порога или не уменьшилось
+		std::shared_ptr<const std::string> Compress(std::string_view body) const;
+
+	private:
+		int level_{ NO_COMPRESSION };
+		size_t threshold_{ DEFAULT_THRESHOLD };
+	};
+
+}  // namespace content_encoding
@@ -0,0 +1,41 @@
+#pragma once
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <boost/crc.hpp>
+
+namespace file_io {
+	using namespace std::literals;
+
+	/// @brief контрольная сумма записей журналов и частей снимка
+	inline uint32_t Crc32(std::string_view data) {
+		boost::crc_32_type crc;
+		crc.process_bytes(data.data(), data.size());
+		return crc.checksum();
+	}
+
+	/// @brief исключение с текущим errno
+	[[noreturn]] inline void ThrowSystemError(const std::string& what) {
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+
+	/// @brief записать данные целиком, повторяя прерванные и частичные вызовы write
+	inline void WriteAll(int fd, std::string_view data) {
+		while (!data.empty()) {
+			const ssize_t written = ::write(fd, data.data(), data.size());
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				ThrowSystemError("write"s);
+			}
+			data.remove_prefix(static_cast<size_t>(written));
+		}
+	}
+
+}  // namespace file_io
@@ -0,0 +1,217 @@
+#include "game_socket.h"
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/json.hpp>
+
+#include "http_server.h"
+
+namespace game_socket {
+	using namespace std::literals;
+
+	namespace {
+		/// @brief направление из команды {"move": "<направление>"}; false - команда некорректна
+		bool ParseMove(std::string_view message, std::string& direction) {
+			try {
+				auto json = boost::json::parse(message);
+				if (!json.is_object()) {
+					return false;
+				}
+				const auto* move = json.as_object().if_contains("move"sv);
+				if (move == nullptr || !move->is_string()) {
+					return false;
+				}
+				direction = move->as_string().c_str();
+			}
+			catch (const std::exception&) {
+				return false;
+			}
+			return direction.empty() || direction == "L"sv || direction == "R"sv
+				|| direction == "U"sv || direction == "D"sv;
+		}
+	}  // namespace
+
+	void Reject(beast::tcp_stream&& stream, StringResponse&& response) {
+		auto stream_ptr = std::make_shared<beast::tcp_stream>(std::move(stream));
+		auto response_ptr = std::make_shared<StringResponse>(std::move(response));
+		response_ptr->keep_alive(false);
+		response_ptr->prepare_payload();
+		http::async_write(*stream_ptr, *response_ptr,
+			[stream_ptr, response_ptr](beast::error_code ec, std::size_t) {
+				if (ec) {
+					return http_server::ReportError(ec, "websocket reject"sv);
+				}
+				stream_ptr->socket().shutdown(net::ip::tcp::socket::shutdown_send, ec);
+			});
+	}
+
+	Session::Session(beast::tcp_stream&& stream, Hub& hub, std::string token, std::string map_name)
+		: ws_(std::move(stream))
+		, hub_(hub)
+		, token_(std::move(token))
+		, map_name_(std::move(map_name)) {
+	}
+
+	void Session::Run(StringRequest&& upgrade_request) {
+		// вся дальнейшая работа с соединением выполняется в его strand
+		auto request = std::make_shared<StringRequest>(std::move(upgrade_request));
+		net::dispatch(ws_.get_executor(), [self = shared_from_this(), request] {
+			// таймауты HTTP-сессии заменяются таймаутами WebSocket с пингами
+			beast::get_lowest_layer(self->ws_).expires_never();
+			self->ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+			self->ws_.text(true);
+			self->ws_.async_accept(*request,
+				[self, request](beast::error_code ec) { self->OnAccept(ec); });
+		});
+	}
+
+	void Session::Push(std::shared_ptr<const std::string> frame) {
+		net::post(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+			// непереданный кадр вытесняется более новым
+			self->pending_ = std::move(frame);
+			if (self->accepted_ && !self->writing_) {
+				self->Write();
+			}
+		});
+	}
+
+	void Session::OnAccept(beast::error_code ec) {
+		if (ec) {
+			return http_server::ReportError(ec, "websocket accept"sv);
+		}
+		accepted_ = true;
+		if (!pending_) {
+			pending_ = hub_.GetState(map_name_);
+		}
+		Write();
+		Read();
+	}
+
+	void Session::Read() {
+		ws_.async_read(buffer_, beast::bind_front_handler(&Session::OnRead, shared_from_this()));
+	}
+
+	void Session::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+		if (ec == websocket::error::closed) {
+			return;
+		}
+		if (ec) {
+			return http_server::ReportError(ec, "websocket read"sv);
+		}
+		const std::string message = beast::buffers_to_string(buffer_.data());
+		buffer_.consume(buffer_.size());
+
+		std::string direction;
+		if (ParseMove(message, direction)) {
+			hub_.Move(token_, std::move(direction));
+		}
+		Read();
+	}
+
+	void Session::Write() {
+		if (!pending_) {
+			return;
+		}
+		writing_ = std::move(pending_);
+		ws_.async_write(net::buffer(*writing_),
+			beast::bind_front_handler(&Session::OnWrite, shared_from_this()));
+	}
+
+	void Session::OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+		writing_.reset();
+		if (ec) {
+			if (ec != websocket::error::closed) {
+				http_server::ReportError(ec, "websocket write"sv);
+			}
+			return;
+		}
+		Write();
+	}
+
+	Hub::Hub(model::Game& game, response_cache::ResponseCache& response_cache, Strand api_strand)
+		: game_(game)
+		, response_cache_(response_cache)
+		, api_strand_(api_strand) {
+	}
+
+	void Hub::Accept(beast::tcp_stream&& stream, StringRequest&& upgrade_request,
+		std::string token, std::string map_name) {
+		auto session = std::make_shared<Session>(std::move(stream), *this, std::move(token), map_name);
+		{
+			std::lock_guard lock{ mtx_ };
+			sessions_[map_name].push_back(session);
+		}
+		session->Run(std::move(upgrade_request));
+	}
+
+	void Hub::Publish() {
+		std::unordered_map<std::string, std::vector<std::shared_ptr<Session>>> alive;
+		std::unordered_map<std::string, std::vector<std::shared_ptr<Waiter>>> waiters;
+		{
+			std::lock_guard lock{ mtx_ };
+			waiters.swap(waiters_);
+			for (auto& [map_name, sessions] : sessions_) {
+				std::erase_if(sessions, [](const std::weak_ptr<Session>& session) { return session.expired(); });
+				for (const auto& weak : sessions) {
+					if (auto session = weak.lock()) {
+						alive[map_name].push_back(std::move(session));
+					}
+				}
+			}
+		}
+		// кадр собирается один раз на карту и разделяется всеми её соединениями
+		for (const auto& [map_name, sessions] : alive) {
+			const auto frame = GetState(map_name);
+			for (const auto& session : sessions) {
+				session->Push(frame);
+			}
+		}
+		for (auto& [map_name, map_waiters] : waiters) {
+			for (auto& waiter : map_waiters) {
+				net::post(api_strand_, [waiter = std::move(waiter)] {
+					if (waiter->done) {
+						return;
+					}
+					waiter->done = true;
+					waiter->timer.cancel();
+					waiter->wake();
+				});
+			}
+		}
+	}
+
+	void Hub::Wait(const std::string& map_name, std::function<void()> wake) {
+		auto waiter = std::make_shared<Waiter>(api_strand_, std::move(wake));
+		waiter->timer.expires_after(WAIT_TIMEOUT);
+		// по таймауту отвечаем текущим состоянием; ожидающий остаётся в списке до ближайшего тика
+		waiter->timer.async_wait([waiter](beast::error_code ec) {
+			if (ec || waiter->done) {
+				return;
+			}
+			waiter->done = true;
+			waiter->wake();
+		});
+		std::lock_guard lock{ mtx_ };
+		auto& map_waiters = waiters_[map_name];
+		// без тиков ответившие по таймауту запросы иначе копились бы до следующего тика
+		std::erase_if(map_waiters, [](const std::shared_ptr<Waiter>& w) { return w->done; });
+		map_waiters.push_back(std::move(waiter));
+	}
+
+	std::shared_ptr<const std::string> Hub::GetState(const std::string& map_name) {
+		return response_cache_.Get(map_name).state;
+	}
+
+	void Hub::Move(std::string token, std::string direction) {
+		net::dispatch(api_strand_, [this, token = std::move(token), direction = std::move(direction)]() mutable {
+			// игрок мог выбыть, пока соединение открыто
+			const std::string* map_name = game_.GetMapNameByHash(token);
+			if (map_name == nullptr) {
+				return;
+			}
+			std::string map_name_copy = *map_name;
+			game_.MovePlayer(direction, token, map_name_copy);
+		});
+	}
+
+}  // namespace game_socket
@@ -0,0 +1,138 @@
+#pragma once
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include "model.h"
+#include "response_cache.h"
+
+namespace game_socket {
+	namespace net = boost::asio;
+	namespace beast = boost::beast;
+	namespace http = beast::http;
+	namespace websocket = beast::websocket;
+	using Strand = net::strand<net::io_context::executor_type>;
+	using StringRequest = http::request<http::string_body>;
+	using StringResponse = http::response<http::string_body>;
+
+	/// @brief отказ в WebSocket-соединении: отправка ответа HTTP и закрытие соединения
+	/// @param stream соединение, по которому пришёл запрос на переход к WebSocket
+	/// @param response ответ
+	void Reject(beast::tcp_stream&& stream, StringResponse&& response);
+
+	class Hub;
+
+	/// @brief WebSocket-соединение игрока.
+	/// После каждого тика сервер присылает состояние карты игрока текстовым кадром
+	/// в формате ответа /api/v1/game/state, а клиент присылает команды движения
+	/// {"move": "L"} в формате /api/v1/game/player/action. Медленный клиент не задерживает
+	/// тик: пока пишется кадр, ожидает отправки только последний из новых, остальные пропускаются
+	class Session : public std::enable_shared_from_this<Session> {
+	public:
+		Session(beast::tcp_stream&& stream, Hub& hub, std::string token, std::string map_name);
+
+		/// @brief завершить переход к WebSocket и начать обмен
+		/// @param upgrade_request запрос на переход к WebSocket
+		void Run(StringRequest&& upgrade_request);
+
+		/// @brief отправить кадр; вызывается из любого потока
+		/// @param frame тело кадра, разделяемое всеми соединениями карты
+		void Push(std::shared_ptr<const std::string> frame);
+
+	private:
+		void OnAccept(beast::error_code ec);
+		void Read();
+		void OnRead(beast::error_code ec, std::size_t bytes_read);
+		void Write();
+		void OnWrite(beast::error_code ec, std::size_t bytes_written);
+
+		websocket::stream<beast::tcp_stream> ws_;
+		Hub& hub_;
+		std::string token_;
+		std::string map_name_;
+		beast::flat_buffer buffer_;
+		bool accepted_{ false };
+		// кадр, который пишется сейчас
+		std::shared_ptr<const std::string> writing_;
+		// последний кадр, ожидающий отправки
+		std::shared_ptr<const std::string> pending_;
+	};
+
+	/// @brief Запрос состояния, ожидающий следующего тика (long polling)
+	struct Waiter {
+		explicit Waiter(Strand strand, std::function<void()> wake)
+			: timer(strand)
+			, wake(std::move(wake)) {
+		}
+
+		net::steady_timer timer;
+		std::function<void()> wake;
+		// ответ уже отправлен по тику или по таймауту
+		bool done{ false };
+	};
+
+	/// @brief Соединения игроков и ожидающие запросы состояния по картам,
+	/// рассылка им состояния после тика
+	class Hub {
+	public:
+		/// @param game игра
+		/// @param response_cache кэш ответов, из которого берутся кадры
+		/// @param api_strand strand, в котором выполняются обращения к игре из API
+		Hub(model::Game& game, response_cache::ResponseCache& response_cache, Strand api_strand);
+
+		Hub(const Hub&) = delete;
+		Hub& operator=(const Hub&) = delete;
+
+		/// @brief принять соединение игрока с проверенным токеном
+		/// @param stream соединение
+		/// @param upgrade_request запрос на переход к WebSocket
+		/// @param token токен игрока
+		/// @param map_name карта игрока
+		void Accept(beast::tcp_stream&& stream, StringRequest&& upgrade_request,
+			std::string token, std::string map_name);
+
+		/// @brief разослать состояние карт их игрокам и разбудить ожидающие запросы,
+		/// вызывается после тика
+		void Publish();
+
+		/// @brief дождаться следующего тика на карте, но не дольше WAIT_TIMEOUT;
+		/// вызывается из api_strand
+		/// @param map_name карта
+		/// @param wake вызывается один раз в api_strand после тика или по таймауту
+		void Wait(const std::string& map_name, std::function<void()> wake);
+
+		// Сколько запрос ждёт тика. Меньше таймаута HTTP-сессии, чтобы ответ успел уйти
+		constexpr static std::chrono::seconds WAIT_TIMEOUT{ 20 };
+
+		/// @brief текущее состояние карты для нового соединения
+		std::shared_ptr<const std::string> GetState(const std::string& map_name);
+
+		/// @brief команда движения из соединения, выполняется в api_strand
+		/// @param token токен игрока
+		/// @param direction направление: L, R, U, D или пустая строка
+		void Move(std::string token, std::string direction);
+
+	private:
+		model::Game& game_;
+		response_cache::ResponseCache& response_cache_;
+		Strand api_strand_;
+
+		std::mutex mtx_;
+		std::unordered_map<std::string, std::vector<std::weak_ptr<Session>>> sessions_;
+		std::unordered_map<std::string, std::vector<std::shared_ptr<Waiter>>> waiters_;
+	};
+
+}  // namespace game_socket
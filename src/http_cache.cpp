@@ -0,0 +1,52 @@
+#include "http_cache.h"
+
+#include "content_encoding.h"
+
+namespace http_cache {
+
+	std::string GzipEtag(std::string_view etag) {
+		if (etag.size() < 2 || etag.back() != '"') {
+			return std::string(etag);
+		}
+		std::string gzip_etag{ etag.substr(0, etag.size() - 1) };
+		gzip_etag += '-';
+		gzip_etag += content_encoding::Literals::GZIP;
+		gzip_etag += '"';
+		return gzip_etag;
+	}
+
+	bool IsEtagMatched(std::string_view if_none_match, std::string_view etag) {
+		const std::string gzip_etag = GzipEtag(etag);
+		while (!if_none_match.empty()) {
+			const auto comma = if_none_match.find(',');
+			std::string_view candidate = content_encoding::Trim(if_none_match.substr(0, comma));
+			if_none_match = comma == std::string_view::npos ? std::string_view{} : if_none_match.substr(comma + 1);
+			if (candidate.substr(0, 2) == "W/"sv) {
+				candidate.remove_prefix(2);
+			}
+			if (candidate == "*"sv || candidate == etag || candidate == gzip_etag) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Representation SelectRepresentation(std::string_view accept_encoding, bool has_gzip, bool vary_accept,
+		std::string_view etag) {
+		Representation representation;
+		representation.gzip = has_gzip && content_encoding::AcceptsGzip(accept_encoding);
+		// ответ зависит от Accept и Accept-Encoding, кэши должны это учитывать
+		if (vary_accept && has_gzip) {
+			representation.vary = "Accept, Accept-Encoding"sv;
+		} else if (vary_accept) {
+			representation.vary = "Accept"sv;
+		} else if (has_gzip) {
+			representation.vary = "Accept-Encoding"sv;
+		}
+		if (!etag.empty()) {
+			representation.etag = representation.gzip ? GzipEtag(etag) : std::string(etag);
+		}
+		return representation;
+	}
+
+}  // namespace http_cache
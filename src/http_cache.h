@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace http_cache {
+	using namespace std::literals;
+
+	// Представление ответа с разделяемым телом, выбранное по заголовкам запроса
+	struct Representation {
+		// клиенту отдаётся сжатое gzip тело
+		bool gzip{ false };
+		// значение заголовка Vary, пустое - заголовок не выставляется
+		std::string_view vary;
+		// значение заголовка ETag выбранного тела, пустое - заголовок не выставляется
+		std::string etag;
+	};
+
+	/// @brief ETag сжатой версии тела: представления с разным Content-Encoding
+	/// должны различаться по сильному ETag
+	/// @param etag ETag тела без сжатия, в кавычках
+	/// @return ETag сжатого тела
+	std::string GzipEtag(std::string_view etag);
+
+	/// @brief есть ли ETag в значении заголовка If-None-Match: "*" или список через запятую,
+	/// сравнение слабое - префикс W/ не учитывается. ETag сжатой версии тела тоже подходит
+	/// @param if_none_match значение заголовка
+	/// @param etag ETag ответа
+	/// @return true - у клиента актуальная версия
+	bool IsEtagMatched(std::string_view if_none_match, std::string_view etag);
+
+	/// @brief выбор представления ответа. Ответ 304 получает те же ETag и Vary, что и 200
+	/// @param accept_encoding значение заголовка Accept-Encoding запроса
+	/// @param has_gzip у ответа есть сжатая версия тела
+	/// @param vary_accept тело выбрано по заголовку Accept
+	/// @param etag ETag тела без сжатия, пустой - заголовок не выставляется
+	Representation SelectRepresentation(std::string_view accept_encoding, bool has_gzip, bool vary_accept,
+		std::string_view etag);
+
+}  // namespace http_cache
@@ -5,6 +5,7 @@
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>  // время
 #include <boost/json.hpp>
 
@@ -45,6 +46,13 @@ class SessionBase {
   // расходы.
   ~SessionBase() = default;
 
+  /// @brief Передать соединение другому владельцу, например при переходе к
+  /// WebSocket. После вызова сессия больше не читает запросы
+  beast::tcp_stream ReleaseStream() {
+    stream_.expires_never();
+    return std::move(stream_);
+  }
+
   template <typename Body, typename Fields>
   void Write(http::response<Body, Fields>&& response) {
     // Чтобы продлить время жизни ответа до окончания записи,
@@ -107,6 +115,10 @@ class Session : public SessionBase,
 
  private:
   void HandleRequest(HttpRequest&& request) override {
+    // Запрос на переход к WebSocket: соединение передаётся обработчику целиком
+    if (beast::websocket::is_upgrade(request)) {
+      return request_handler_(std::move(request), ip_, ReleaseStream());
+    }
     // Захватываем умный указатель на текущий объект Session в лямбде,
     // чтобы продлить время жизни сессии до вызова лямбды.
     // Используется generic-лямбда функция, способная принять response
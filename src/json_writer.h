@@ -0,0 +1,199 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace json_writer {
+
+	/// @brief Ключ json-объекта, заранее обрамлённый кавычками и двоеточием: "key":
+	/// Собирается при компиляции, поэтому запись ключа - одно добавление в буфер.
+	/// Ключ не экранируется и не должен содержать кавычек, обратной косой черты и управляющих символов
+	template <size_t N>
+	struct KeyFragment {
+		consteval KeyFragment(const char(&key)[N]) {
+			text[0] = '"';
+			for (size_t i = 0; i + 1 < N; ++i) {
+				text[i + 1] = key[i];
+			}
+			text[N] = '"';
+			text[N + 1] = ':';
+		}
+
+		constexpr std::string_view View() const noexcept {
+			return { text.data(), text.size() };
+		}
+
+		std::array<char, N + 2> text{};
+	};
+
+	/// @brief Потоковая запись JSON в буфер без построения дерева boost::json.
+	/// Запятые между элементами расставляются автоматически, память выделяется только
+	/// при росте буфера, поэтому один буфер можно переиспользовать между ответами
+	class JsonWriter {
+	public:
+		// Наибольшая глубина вложенности объектов и массивов
+		constexpr static size_t MAX_DEPTH = 32;
+
+		/// @param out буфер, в конец которого дописывается JSON
+		explicit JsonWriter(std::string& out)
+			: out_(out) {
+		}
+
+		void StartObject() {
+			BeforeValue();
+			out_ += '{';
+			Push();
+		}
+
+		void EndObject() {
+			--depth_;
+			out_ += '}';
+		}
+
+		void StartArray() {
+			BeforeValue();
+			out_ += '[';
+			Push();
+		}
+
+		void EndArray() {
+			--depth_;
+			out_ += ']';
+		}
+
+		template <size_t N>
+		void Key(const KeyFragment<N>& key) {
+			BeforeKey();
+			out_ += key.View();
+		}
+
+		void Key(std::string_view key) {
+			BeforeKey();
+			AppendQuoted(key);
+			out_ += ':';
+		}
+
+		void String(std::string_view value) {
+			BeforeValue();
+			AppendQuoted(value);
+		}
+
+		void Int(int64_t value) {
+			BeforeValue();
+			AppendChars(value);
+		}
+
+		void Uint(uint64_t value) {
+			BeforeValue();
+			AppendChars(value);
+		}
+
+		/// @brief кратчайшая запись, из которой читается то же число; у целых
+		/// значений остаётся ".0", чтобы число читалось как вещественное
+		void Double(double value) {
+			BeforeValue();
+			if (!std::isfinite(value)) {
+				out_ += "null";
+				return;
+			}
+			std::array<char, 32> buf;
+			const auto result = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+			const std::string_view chars{ buf.data(), static_cast<size_t>(result.ptr - buf.data()) };
+			out_ += chars;
+			if (chars.find_first_of(".e") == std::string_view::npos) {
+				out_ += ".0";
+			}
+		}
+
+		void Bool(bool value) {
+			BeforeValue();
+			out_ += value ? "true" : "false";
+		}
+
+		void Null() {
+			BeforeValue();
+			out_ += "null";
+		}
+
+		/// @brief готовое json-значение, например заранее сериализованный объект
+		void Raw(std::string_view json) {
+			BeforeValue();
+			out_ += json;
+		}
+
+	private:
+		void Push() {
+			first_[depth_++] = true;
+		}
+
+		void BeforeKey() {
+			if (!first_[depth_ - 1]) {
+				out_ += ',';
+			}
+			first_[depth_ - 1] = false;
+			after_key_ = true;
+		}
+
+		void BeforeValue() {
+			if (after_key_) {
+				after_key_ = false;
+				return;
+			}
+			if (depth_ > 0) {
+				if (!first_[depth_ - 1]) {
+					out_ += ',';
+				}
+				first_[depth_ - 1] = false;
+			}
+		}
+
+		template <typename T>
+		void AppendChars(T value) {
+			std::array<char, 24> buf;
+			const auto result = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+			out_.append(buf.data(), result.ptr);
+		}
+
+		void AppendQuoted(std::string_view value) {
+			constexpr std::string_view HEX = "0123456789abcdef";
+			out_ += '"';
+			size_t plain_begin = 0;
+			for (size_t i = 0; i < value.size(); ++i) {
+				const auto c = static_cast<unsigned char>(value[i]);
+				if (c >= 0x20 && c != '"' && c != '\\') {
+					continue;
+				}
+				// участки без спецсимволов копируются целиком
+				out_.append(value.data() + plain_begin, i - plain_begin);
+				plain_begin = i + 1;
+				switch (c) {
+				case '"': out_ += "\\\""; break;
+				case '\\': out_ += "\\\\"; break;
+				case '\n': out_ += "\\n"; break;
+				case '\r': out_ += "\\r"; break;
+				case '\t': out_ += "\\t"; break;
+				case '\b': out_ += "\\b"; break;
+				case '\f': out_ += "\\f"; break;
+				default:
+					out_ += "\\u00";
+					out_ += HEX[c >> 4];
+					out_ += HEX[c & 0xF];
+				}
+			}
+			out_.append(value.data() + plain_begin, value.size() - plain_begin);
+			out_ += '"';
+		}
+
+		std::string& out_;
+		// в текущем объекте или массиве ещё нет элементов
+		std::array<bool, MAX_DEPTH> first_{};
+		size_t depth_{ 0 };
+		// записан ключ, следующее значение - его значение
+		bool after_key_{ false };
+	};
+
+}  // namespace json_writer
@@ -0,0 +1,286 @@
+#include "leaderboard.h"
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+
+#include "random_functions.h"
+
+namespace leaderboard {
+	using namespace std::literals;
+
+	void WriteRecords(json_writer::JsonWriter& writer, const std::vector<retired_repository::RetiredPlayer>& records) {
+		constexpr json_writer::KeyFragment NAME_KEY{ "name" };
+		constexpr json_writer::KeyFragment SCORE_KEY{ "score" };
+		constexpr json_writer::KeyFragment PLAY_TIME_KEY{ "playTime" };
+		writer.StartArray();
+		for (const auto& record : records) {
+			writer.StartObject();
+			writer.Key(NAME_KEY);
+			writer.String(record.name);
+			writer.Key(SCORE_KEY);
+			writer.Int(record.score);
+			writer.Key(PLAY_TIME_KEY);
+			writer.Int(record.play_time_s);
+			writer.EndObject();
+		}
+		writer.EndArray();
+	}
+
+	std::string SerializeRecords(const std::vector<retired_repository::RetiredPlayer>& records) {
+		std::string out;
+		json_writer::JsonWriter writer{ out };
+		WriteRecords(writer, records);
+		return out;
+	}
+
+	std::string EncodeCursor(const retired_repository::RecordsCursor& cursor) {
+		constexpr static std::string_view HEX_DIGITS = "0123456789abcdef"sv;
+		std::string plain = std::to_string(cursor.score) + ":"s + std::to_string(cursor.play_time_s) + ":"s +
+			std::to_string(cursor.skip) + ":"s + cursor.name;
+		std::string encoded;
+		encoded.reserve(plain.size() * 2);
+		for (unsigned char c : plain) {
+			encoded.push_back(HEX_DIGITS[c >> 4]);
+			encoded.push_back(HEX_DIGITS[c & 0x0f]);
+		}
+		return encoded;
+	}
+
+	bool DecodeCursor(std::string_view encoded, retired_repository::RecordsCursor& cursor) {
+		if (encoded.size() % 2 != 0) {
+			return false;
+		}
+		std::string plain;
+		plain.reserve(encoded.size() / 2);
+		for (size_t i = 0; i < encoded.size(); i += 2) {
+			unsigned int byte{ 0 };
+			auto [ptr, ec] = std::from_chars(encoded.data() + i, encoded.data() + i + 2, byte, 16);
+			if (ec != std::errc{} || ptr != encoded.data() + i + 2) {
+				return false;
+			}
+			plain.push_back(static_cast<char>(byte));
+		}
+
+		std::string_view rest{ plain };
+		auto next_int = [&rest](int& value) {
+			auto delim = rest.find(':');
+			if (delim == std::string_view::npos) {
+				return false;
+			}
+			auto [ptr, ec] = std::from_chars(rest.data(), rest.data() + delim, value);
+			if (ec != std::errc{} || ptr != rest.data() + delim) {
+				return false;
+			}
+			rest.remove_prefix(delim + 1);
+			return true;
+		};
+		if (!next_int(cursor.score) || !next_int(cursor.play_time_s) || !next_int(cursor.skip) || cursor.skip < 0) {
+			return false;
+		}
+		cursor.name = std::string(rest);
+		return true;
+	}
+
+	retired_repository::RecordsCursor NextCursor(const retired_repository::RecordsCursor& prev,
+		const std::vector<retired_repository::RetiredPlayer>& records) {
+		const auto& last = records.back();
+		auto is_same_key = [&last](const retired_repository::RetiredPlayer& record) {
+			return record.score == last.score && record.play_time_s == last.play_time_s && record.name == last.name;
+		};
+		int same_key_count = static_cast<int>(std::find_if_not(records.rbegin(), records.rend(), is_same_key) - records.rbegin());
+
+		retired_repository::RecordsCursor next{ last.score, last.play_time_s, last.name, same_key_count };
+		// вся страница состоит из записей с ключом курсора - учитываем пропущенные ранее
+		if (same_key_count == static_cast<int>(records.size()) &&
+			prev.score == last.score && prev.play_time_s == last.play_time_s && prev.name == last.name) {
+			next.skip += prev.skip;
+		}
+		return next;
+	}
+
+	std::string SerializeCursorPage(const retired_repository::RecordsCursor& cursor, int max_items,
+		const std::vector<retired_repository::RetiredPlayer>& records) {
+		std::string out;
+		json_writer::JsonWriter writer{ out };
+		writer.StartObject();
+		writer.Key("records"sv);
+		WriteRecords(writer, records);
+		writer.Key("next"sv);
+		if (max_items > 0 && records.size() == static_cast<size_t>(max_items)) {
+			writer.String(EncodeCursor(NextCursor(cursor, records)));
+		} else {
+			writer.Null();
+		}
+		writer.EndObject();
+		return out;
+	}
+
+	bool Leaderboard::EntryOrder::operator()(const Entry& lhs, const Entry& rhs) const {
+		if (retired_repository::IsRankedHigher(lhs.player, rhs.player)) {
+			return true;
+		}
+		if (retired_repository::IsRankedHigher(rhs.player, lhs.player)) {
+			return false;
+		}
+		return lhs.seq < rhs.seq;
+	}
+
+	Leaderboard::Leaderboard(size_t max_records)
+		: max_records_(std::min(max_records, std::numeric_limits<size_t>::max() - 1))
+		, etag_epoch_(random_functions::RandomHexString(8)) {
+	}
+
+	bool Leaderboard::Load(retired_repository::RetiredPlayersRepository& repository) {
+		// на одну запись больше предела, чтобы узнать о его превышении
+		std::vector<retired_repository::RetiredPlayer> records;
+		repository.ReadAll(max_records_ + 1, records);
+
+		std::lock_guard<std::mutex> guard(mtx_);
+		Clear();
+		if (records.size() > max_records_) {
+			return false;
+		}
+		for (const auto& record : records) {
+			Insert(record);
+		}
+		loaded_ = true;
+		Invalidate();
+		return true;
+	}
+
+	void Leaderboard::AddRetired(const std::vector<retired_repository::RetiredPlayer>& retired_players) {
+		if (retired_players.empty()) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> guard(mtx_);
+		if (!loaded_) {
+			return;
+		}
+		bool changed = false;
+		for (const auto& retired : retired_players) {
+			changed = Insert(retired) || changed;
+		}
+		if (entries_.Size() > max_records_) {
+			Clear();
+		}
+		else if (changed) {
+			Invalidate();
+		}
+	}
+
+	void Leaderboard::Clear() {
+		entries_.Clear();
+		best_by_name_.clear();
+		record_ids_.clear();
+		loaded_ = false;
+		Invalidate();
+	}
+
+	bool Leaderboard::Insert(const retired_repository::RetiredPlayer& player) {
+		if (!player.record_id.empty() && !record_ids_.insert(player.record_id).second) {
+			return false;
+		}
+		Entry entry{ player, next_seq_++ };
+		// в записях из БД нет id игрока, в таблице он не нужен; идентификатор строки уже в record_ids_
+		entry.player.id = 0;
+		entry.player.record_id.clear();
+		auto [it, inserted] = best_by_name_.try_emplace(entry.player.name, entry);
+		if (!inserted && EntryOrder{}(entry, it->second)) {
+			it->second = entry;
+		}
+		entries_.Insert(std::move(entry));
+		return true;
+	}
+
+	void Leaderboard::SetCompressor(const content_encoding::Compressor& compressor) {
+		std::lock_guard<std::mutex> guard(mtx_);
+		compressor_ = compressor;
+	}
+
+	std::shared_ptr<const Page> Leaderboard::GetPage(int start, int max_items) {
+		if (start < 0 || max_items < 0) {
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> guard(mtx_);
+		if (!loaded_) {
+			return nullptr;
+		}
+
+		const uint64_t key = (static_cast<uint64_t>(start) << 32) | static_cast<uint64_t>(max_items);
+		if (auto it = pages_.find(key); it != pages_.end()) {
+			return it->second;
+		}
+
+		const size_t begin = static_cast<size_t>(start);
+		const size_t end = std::min(begin + static_cast<size_t>(max_items), entries_.Size());
+		std::vector<retired_repository::RetiredPlayer> records;
+		for (size_t i = begin; i < end; ++i) {
+			records.push_back(entries_.At(i).player);
+		}
+
+		auto page = std::make_shared<Page>();
+		page->body = SerializeRecords(records);
+		page->gzip_body = compressor_.Compress(page->body);
+		page->etag = "\""s + etag_epoch_ + "-"s + std::to_string(version_) + "-"s +
+			std::to_string(start) + "-"s + std::to_string(max_items) + "\""s;
+		if (pages_.size() >= MAX_CACHED_PAGES) {
+			pages_.clear();
+		}
+		pages_.emplace(key, page);
+		return page;
+	}
+
+	bool Leaderboard::GetPageAfter(const retired_repository::RecordsCursor& cursor, int max_items,
+		std::vector<retired_repository::RetiredPlayer>& records) {
+		if (cursor.skip < 0 || max_items < 0) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> guard(mtx_);
+		if (!loaded_) {
+			return false;
+		}
+
+		// первая запись с ключом не выше курсора, записи с тем же ключом пропускаем
+		Entry key{ { 0, cursor.name, cursor.score, cursor.play_time_s }, 0 };
+		const size_t begin = entries_.Rank(key) + static_cast<size_t>(cursor.skip);
+		const size_t end = std::min(begin + static_cast<size_t>(max_items), entries_.Size());
+		for (size_t i = begin; i < end; ++i) {
+			records.push_back(entries_.At(i).player);
+		}
+		return true;
+	}
+
+	bool Leaderboard::GetPlayerRank(const std::string& name, size_t neighbours, PlayerRank& player_rank) {
+		std::lock_guard<std::mutex> guard(mtx_);
+		if (!loaded_) {
+			return false;
+		}
+
+		auto best = best_by_name_.find(name);
+		if (best == best_by_name_.end()) {
+			return false;
+		}
+
+		const size_t index = entries_.Rank(best->second);
+		const size_t total = entries_.Size();
+		player_rank.rank = index + 1;
+		player_rank.total = total;
+		player_rank.around.clear();
+		const size_t begin = index > neighbours ? index - neighbours : 0;
+		const size_t end = std::min(index + neighbours + 1, total);
+		for (size_t i = begin; i < end; ++i) {
+			player_rank.around.push_back({ i + 1, entries_.At(i).player });
+		}
+		return true;
+	}
+
+	void Leaderboard::Invalidate() {
+		++version_;
+		pages_.clear();
+	}
+
+}  // namespace leaderboard
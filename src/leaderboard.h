@@ -0,0 +1,192 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "content_encoding.h"
+#include "json_writer.h"
+#include "retired_repository.h"
+#include "rank_tree.h"
+
+namespace leaderboard {
+	// Страница таблицы рекордов, сериализованная заранее
+	struct Page {
+		// json-массив рекордов
+		std::string body;
+		// значение заголовка ETag
+		std::string etag;
+		// сжатое gzip тело; nullptr - страница отдаётся без сжатия
+		std::shared_ptr<const std::string> gzip_body;
+	};
+
+	// Запись таблицы рекордов вместе с её местом
+	struct RankedRecord {
+		// место в таблице, начиная с 1
+		size_t rank;
+		retired_repository::RetiredPlayer player;
+	};
+
+	// Место игрока в таблице рекордов и его соседи
+	struct PlayerRank {
+		// место игрока, начиная с 1
+		size_t rank;
+		// всего записей в таблице
+		size_t total;
+		// записи вокруг игрока, включая его самого
+		std::vector<RankedRecord> around;
+	};
+
+	/// @brief запись рекордов json-массивом
+	/// @param writer ответ
+	/// @param records рекорды
+	void WriteRecords(json_writer::JsonWriter& writer, const std::vector<retired_repository::RetiredPlayer>& records);
+
+	/// @brief сериализация рекордов в json-массив для ответа на /api/v1/game/records
+	/// @param records рекорды
+	/// @return тело ответа
+	std::string SerializeRecords(const std::vector<retired_repository::RetiredPlayer>& records);
+
+	/// @brief кодирование курсора таблицы рекордов в непрозрачную для клиента строку
+	/// @param cursor курсор
+	/// @return строка из шестнадцатеричных цифр
+	std::string EncodeCursor(const retired_repository::RecordsCursor& cursor);
+
+	/// @brief декодирование курсора таблицы рекордов
+	/// @param encoded строка, полученная от EncodeCursor
+	/// @param cursor курсор
+	/// @return false - строка не является курсором
+	bool DecodeCursor(std::string_view encoded, retired_repository::RecordsCursor& cursor);
+
+	/// @brief курсор, указывающий на конец отданной страницы рекордов
+	/// @param prev курсор, по которому была прочитана страница
+	/// @param records непустая страница рекордов
+	/// @return курсор следующей страницы
+	retired_repository::RecordsCursor NextCursor(const retired_repository::RecordsCursor& prev,
+		const std::vector<retired_repository::RetiredPlayer>& records);
+
+	/// @brief сериализация страницы рекордов, прочитанной по курсору
+	/// @param cursor курсор, по которому прочитана страница
+	/// @param max_items запрошенное количество элементов
+	/// @param records записи страницы
+	/// @return {"records": [...], "next": курсор | null}
+	std::string SerializeCursorPage(const retired_repository::RecordsCursor& cursor, int max_items,
+		const std::vector<retired_repository::RetiredPlayer>& records);
+
+	/// @brief Таблица рекордов в памяти процесса.
+	/// Все записи retired_players лежат в дереве порядковых статистик в порядке индекса
+	/// scores_rating_keyset (score DESC, playtime, name). Таблица загружается один раз при старте
+	/// и дополняется при записи выбывших игроков в БД, поэтому страницы рекордов и место
+	/// игрока находятся за O(log n) без обращения к БД. Место игрока требует всей таблицы,
+	/// поэтому она держится целиком, но не больше max_records записей: таблица большего
+	/// размера не загружается (или выгружается), и запросы идут в БД.
+	class Leaderboard {
+	public:
+		// Сколько записей держим в памяти по умолчанию, около сотни мегабайт
+		constexpr static size_t DEFAULT_MAX_RECORDS{ 1'000'000 };
+
+		// Сколько сериализованных страниц держим между изменениями таблицы
+		constexpr static size_t MAX_CACHED_PAGES{ 1024 };
+
+		/// @param max_records наибольшее число записей в памяти
+		explicit Leaderboard(size_t max_records = DEFAULT_MAX_RECORDS);
+
+		Leaderboard(const Leaderboard&) = delete;
+		Leaderboard& operator=(const Leaderboard&) = delete;
+
+		/// @brief сжимать страницы для клиентов с Accept-Encoding: gzip; вызывается до обработки запросов
+		/// @param compressor параметры сжатия
+		void SetCompressor(const content_encoding::Compressor& compressor);
+
+		/// @brief загрузка таблицы рекордов из хранилища
+		/// @param repository хранилище выбывших игроков
+		/// @return false - в хранилище больше max_records записей, таблица не загружена
+		bool Load(retired_repository::RetiredPlayersRepository& repository);
+
+		/// @brief добавить выбывших игроков, уже записанных в БД. Записи с уже известным
+		/// идентификатором строки пропускаются: пачка из журнала может переноситься повторно.
+		/// Если таблица перерастает max_records, она выгружается
+		/// @param retired_players выбывшие игроки
+		void AddRetired(const std::vector<retired_repository::RetiredPlayer>& retired_players);
+
+		/// @brief получить страницу рекордов из памяти
+		/// @param start номер начального элемента
+		/// @param max_items максимальное количество элементов
+		/// @return nullptr - таблица ещё не загружена, нужно идти в БД
+		std::shared_ptr<const Page> GetPage(int start, int max_items);
+
+		/// @brief получить из памяти страницу рекордов, следующую за курсором
+		/// @param cursor позиция последней отданной записи
+		/// @param max_items максимальное количество элементов
+		/// @param records записи страницы
+		/// @return false - таблица ещё не загружена, нужно идти в БД
+		bool GetPageAfter(const retired_repository::RecordsCursor& cursor, int max_items,
+			std::vector<retired_repository::RetiredPlayer>& records);
+
+		/// @brief место игрока в таблице рекордов
+		/// @param name имя игрока, при нескольких записях берётся лучшая
+		/// @param neighbours сколько соседей взять сверху и снизу
+		/// @param player_rank место игрока и его соседи
+		/// @return false - игрок не найден или таблица ещё не загружена
+		bool GetPlayerRank(const std::string& name, size_t neighbours, PlayerRank& player_rank);
+
+	private:
+		// запись дерева: порядковый номер вставки различает записи с одинаковым ключом
+		struct Entry {
+			retired_repository::RetiredPlayer player;
+			uint64_t seq;
+		};
+
+		// порядок записей как в индексе scores_rating_keyset
+		struct EntryOrder {
+			bool operator()(const Entry& lhs, const Entry& rhs) const;
+		};
+
+		/// @brief добавить запись, вызывается под мьютексом
+		/// @return false - запись с таким идентификатором строки уже есть
+		bool Insert(const retired_repository::RetiredPlayer& player);
+
+		/// @brief удалить все записи, вызывается под мьютексом
+		void Clear();
+
+		/// @brief сброс сериализованных страниц после изменения таблицы
+		void Invalidate();
+
+		std::mutex mtx_;
+
+		// наибольшее число записей в памяти
+		size_t max_records_;
+
+		// все записи в порядке scores_rating_keyset
+		rank_tree::OrderStatisticTree<Entry, EntryOrder> entries_;
+
+		// лучшая запись каждого игрока для поиска места по имени
+		std::unordered_map<std::string, Entry> best_by_name_;
+
+		// идентификаторы строк БД добавленных записей
+		std::unordered_set<std::string> record_ids_;
+
+		// номер следующей вставки
+		uint64_t next_seq_{ 1 };
+
+		// таблица загружена из БД
+		bool loaded_{ false };
+
+		// случайный префикс ETag, чтобы значения не совпадали между перезапусками
+		std::string etag_epoch_;
+
+		// номер версии таблицы, увеличивается при каждом изменении
+		uint64_t version_{ 0 };
+
+		// сжатие сериализованных страниц
+		content_encoding::Compressor compressor_;
+
+		// сериализованные страницы текущей версии, ключ - (start, max_items)
+		std::unordered_map<uint64_t, std::shared_ptr<const Page>> pages_;
+	};
+
+}  // namespace leaderboard
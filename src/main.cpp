@@ -3,14 +3,27 @@
 #include <boost/asio/strand.hpp>
 #include <boost/program_options.hpp>
 #include <pqxx/pqxx>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <iostream>
 #include <optional>
+#include <mutex>
+#include <stop_token>
 #include <thread>
 
+#include "content_encoding.h"
+#include "game_socket.h"
 #include "json_loader.h"
+#include "leaderboard.h"
 #include "request_handler.h"
+#include "response_cache.h"
 #include "ticker.h"
 #include "postgres.h"
+#include "action_log.h"
+#include "retired_spool.h"
+#include "snapshot.h"
+#include "static_cache.h"
 
 
 using namespace std::literals;
@@ -19,6 +32,22 @@ using namespace boost::json;
 using namespace boost::posix_time;
 
 namespace {
+	// Соединений с БД, открываемых при старте
+	constexpr size_t DB_INITIAL_CONNECTIONS = 4;
+	// Предельное число соединений с БД
+	constexpr size_t DB_MAX_CONNECTIONS = 12;
+	// Случайная добавка к периоду записи снимков - до этой доли периода
+	constexpr int SAVE_STATE_JITTER_DIVISOR = 10;
+	// Пауза между попытками подготовить БД растёт до этого значения
+	constexpr std::chrono::milliseconds DB_MAX_RETRY_DELAY{ 5000 };
+
+	// Варианты хранилища выбывших игроков
+	struct RepositoryLiterals {
+		RepositoryLiterals() = delete;
+		constexpr static std::string_view POSTGRES = "postgres"sv;
+		constexpr static std::string_view MEMORY = "memory"sv;
+	};
+
 	// Cтруктура, которая будет хранить параметры приложения.
 	struct Args {
 		std::string tick_period;
@@ -29,7 +58,21 @@ namespace {
 		std::string static_files_path;
 		std::string state_file_path;
 		bool state_file_exist{ false };
+		std::string state_format{ snapshot::Literals::FORMAT_BINARY };
+		size_t state_keep{ 0 };
+		int state_compression{ snapshot::NO_COMPRESSION };
+		bool save_state_in_background{ false };
+		std::string action_log_path;
+		bool action_log_exist{ false };
 		bool random_spawn{ false };
+		std::string retired_spool_path;
+		bool retired_spool_exist{ false };
+		std::string retired_repository_type{ RepositoryLiterals::POSTGRES };
+		int response_compression{ content_encoding::NO_COMPRESSION };
+		size_t response_compression_threshold{ content_encoding::DEFAULT_THRESHOLD };
+		size_t static_cache_size{ static_cache::StaticCache::DEFAULT_MAX_SIZE };
+		std::string static_rescan_period;
+		bool static_rescan_period_exist{ false };
 
 	};
 
@@ -70,8 +113,41 @@ namespace {
 			// Опция --state-file задаёт путь к файлу, в который приложение должно сохранять своё состояние в процессе работы, а при старте — восстанавливать.
 			("state-file,st", po::value(&args.state_file_path)->value_name("state file"s),
 				"set state file path")
+			// Опция --state-format задаёт формат записи файла состояния: binary (по умолчанию), text
+			// или sharded - файлы по картам и манифест по пути --state-file
+			("state-format", po::value(&args.state_format)->value_name("binary|text|sharded"s),
+				"set state file format")
+			// Опция --state-keep задаёт, сколько предыдущих снимков хранить рядом с файлом состояния: <file>.1, <file>.2, ...
+			("state-keep", po::value(&args.state_keep)->value_name("count"s),
+				"set number of previous state snapshots to keep")
+			// Опция --state-compression задаёт уровень сжатия файла состояния gzip: 1 (быстрее) - 9 (меньше), 0 - без сжатия
+			("state-compression", po::value(&args.state_compression)->value_name("level"s),
+				"set state file compression level")
+			// Опция --save-state-in-background переносит сериализацию и запись файла состояния из потока тика в отдельный поток
+			("save-state-in-background", "write state file in background thread")
+			// Опция --action-log задаёт путь к журналу действий; снимки состояния становятся его контрольными точками
+			("action-log", po::value(&args.action_log_path)->value_name("file"s),
+				"set action log path")
 			// Опция randomize-spawn-points включает режим, при котором пёс игрока появляется в случайной точке случайно выбранной дороги карты
-			("randomize-spawn-points", "spawn dogs at random positions");
+			("randomize-spawn-points", "spawn dogs at random positions")
+			// Опция --retired-spool задаёт путь к локальному журналу выбывших игроков, из которого они переносятся в БД
+			("retired-spool", po::value(&args.retired_spool_path)->value_name("file"s),
+				"set retired players spool file path")
+			// Опция --retired-repository выбирает хранилище выбывших игроков: postgres (по умолчанию) или memory
+			("retired-repository", po::value(&args.retired_repository_type)->value_name("postgres|memory"s),
+				"set retired players repository")
+			// Опция --response-compression задаёт уровень сжатия gzip ответов API: 1 (быстрее) - 9 (меньше), 0 - без сжатия
+			("response-compression", po::value(&args.response_compression)->value_name("level"s),
+				"set API response compression level")
+			// Опция --response-compression-threshold задаёт размер тела в байтах, начиная с которого ответ сжимается
+			("response-compression-threshold", po::value(&args.response_compression_threshold)->value_name("bytes"s),
+				"set minimal compressed response size")
+			// Опция --static-cache-size задаёт, сколько байт статических файлов держать в памяти, 0 - читать файлы с диска
+			("static-cache-size", po::value(&args.static_cache_size)->value_name("bytes"s),
+				"set static files cache size")
+			// Опция --static-rescan-period задаёт период проверки каталога статических файлов на изменения
+			("static-rescan-period", po::value(&args.static_rescan_period)->value_name("milliseconds"s),
+				"set static files rescan period");
 
 		// variables_map хранит значения опций после разбора
 		po::variables_map vm;
@@ -105,6 +181,33 @@ namespace {
 			args.state_file_exist = true;
 		}
 
+		if (vm.contains("static-rescan-period"s)) {
+			args.static_rescan_period_exist = true;
+		}
+
+		if (args.state_compression < snapshot::NO_COMPRESSION || args.state_compression > 9) {
+			throw std::runtime_error("State compression level must be from 0 to 9"s);
+		}
+
+		if (args.response_compression < content_encoding::NO_COMPRESSION || args.response_compression > 9) {
+			throw std::runtime_error("Response compression level must be from 0 to 9"s);
+		}
+
+		if (vm.contains("save-state-in-background"s)) {
+			args.save_state_in_background = true;
+		}
+
+		if (vm.contains("action-log"s)) {
+			if (!vm.contains("state-file"s)) {
+				throw std::runtime_error("Action log requires state file"s);
+			}
+			args.action_log_exist = true;
+		}
+
+		if (vm.contains("retired-spool"s)) {
+			args.retired_spool_exist = true;
+		}
+
 		if (!vm.contains("config-file"s)) {
 			throw std::runtime_error("Config file path is not specified"s);
 		}
@@ -138,13 +241,15 @@ namespace {
 /// @brief логгирование запуска сервера
 /// @param port
 /// @param adress
-void LogStartServer(int port, std::string& adress) {
+/// @param time_to_listen время от запуска процесса до начала приёма соединений
+void LogStartServer(int port, std::string& adress, std::chrono::milliseconds time_to_listen) {
 	object obj;
 	obj[std::string(logger::Literals::TIMESTAMP)] =
 		to_iso_extended_string(microsec_clock::universal_time());
 	obj[std::string(logger::Literals::DATA)] = {
 		{std::string(logger::Literals::PORT), port},
-		{std::string(logger::Literals::ADDRESS), adress} };
+		{std::string(logger::Literals::ADDRESS), adress},
+		{std::string(logger::Literals::TIME_TO_LISTEN), time_to_listen.count()} };
 	obj[std::string(logger::Literals::MESSAGE)] = "server started"s;
 	LOG(serialize(obj));
 }
@@ -169,22 +274,84 @@ void LogExitServer(int code, std::optional<std::string> exception) {
 	LOG(serialize(obj));
 }
 
+/// @brief Подготовка БД в фоне: сервер уже принимает соединения, а БД может быть недоступна.
+/// Попытки создать таблицу и загрузить таблицу рекордов повторяются до успеха или остановки
+/// @param stop остановка сервера
+/// @param repository хранилище выбывших игроков
+/// @param leaderboard таблица рекордов
+/// @param on_ready вызывается один раз, когда БД готова
+void PrepareDatabase(std::stop_token stop, retired_repository::RetiredPlayersRepository& repository,
+	leaderboard::Leaderboard& leaderboard, const std::function<void()>& on_ready) {
+	std::mutex mtx;
+	std::condition_variable_any cond_var;
+	std::chrono::milliseconds retry_delay{ 0 };
+	while (!stop.stop_requested()) {
+		try {
+			repository.Init();
+			if (!leaderboard.Load(repository)) {
+				logger::LogError("database init"sv,
+					"retired players table is too large for the leaderboard, records are read from the database"sv);
+			}
+			on_ready();
+			return;
+		}
+		catch (const std::exception& ex) {
+			logger::LogError("database init"sv, ex.what());
+		}
+		retry_delay = std::min(std::max(retry_delay * 2, std::chrono::milliseconds{ 100 }), DB_MAX_RETRY_DELAY);
+		std::unique_lock lock{ mtx };
+		cond_var.wait_for(lock, stop, retry_delay, [] { return false; });
+	}
+}
+
 int main(int argc, const char* argv[]) {
+	// от запуска до готовности принимать соединения, включая загрузку состояния
+	const auto start_time = std::chrono::steady_clock::now();
 	try {
 		auto args = ParseCommandLine(argc, argv);
 
-		const char* db_url = std::getenv("GAME_DB_URL");
-		if (!db_url) {
-			throw std::runtime_error("GAME_DB_URL is not specified");
+		// Хранилище выбывших игроков: Postgres либо память процесса для замеров без БД
+		std::optional<postgres::ConnectionPool> connection_pool;
+		std::unique_ptr<retired_repository::RetiredPlayersRepository> repository;
+		if (args->retired_repository_type == RepositoryLiterals::MEMORY) {
+			repository = std::make_unique<retired_repository::InMemoryRetiredPlayersRepository>();
+		} else if (args->retired_repository_type == RepositoryLiterals::POSTGRES) {
+			const char* db_url = std::getenv("GAME_DB_URL");
+			if (!db_url) {
+				throw std::runtime_error("GAME_DB_URL is not specified");
+			}
+
+			// Соединения открываются в фоне, пул дорастает до предела по мере нагрузки
+			connection_pool.emplace(DB_INITIAL_CONNECTIONS, DB_MAX_CONNECTIONS, [db_url] {
+				auto conn = std::make_shared<pqxx::connection>(db_url);
+				return conn;
+			});
+			repository = std::make_unique<postgres::RetiredPlayersRepositoryImpl>(*connection_pool);
+		} else {
+			throw std::runtime_error("Unknown retired players repository: "s + args->retired_repository_type);
 		}
 
-		postgres::ConnectionPool connection_pool{ 12, [db_url] { //10
-									 auto conn = std::make_shared<pqxx::connection>(db_url);
-									 return conn;
-								 } };
-
 		// 1. Загружаем карту из файла и построить модель игры
-		model::Game game(connection_pool);
+		model::Game game(*repository);
+
+		// Таблица рекордов в памяти: загружается один раз, когда БД станет доступна
+		leaderboard::Leaderboard leaderboard;
+		// Сжатие заранее собранных ответов API для клиентов с Accept-Encoding: gzip
+		const content_encoding::Compressor compressor{ args->response_compression,
+			args->response_compression_threshold };
+		leaderboard.SetCompressor(compressor);
+		game.SetLeaderboard(leaderboard);
+
+		// Выбывшие игроки сначала пишутся в локальный журнал и переносятся в БД в фоне
+		std::optional<retired_spool::RetiredSpool> spool;
+		if (args->retired_spool_exist) {
+			spool.emplace(args->retired_spool_path,
+				[&repository, &leaderboard](const std::vector<retired_repository::RetiredPlayer>& retired) {
+					repository->Save(retired);
+					leaderboard.AddRetired(retired);
+				});
+			game.SetRetiredSpool(*spool);
+		}
 
 		json_loader::LoadGame(game, args->config_file_path);
 
@@ -192,24 +359,52 @@ int main(int argc, const char* argv[]) {
 			game.SetRandomStartPosOn();
 		}
 
+		// Журнал действий между снимками состояния
+		std::optional<action_log::ActionLog> action_log;
+		// Фоновая запись снимков состояния; тик только копирует состояние
+		std::optional<snapshot::BackgroundWriter> snapshot_writer;
+
 		// Когда сервер запускается без указания пути к файлу с сохранённым состоянием, он должен стартовать с чистого листа. 
 		if (args->state_file_exist) {
 			game.SetStateFilePath(std::string(args->state_file_path));
+			game.SetSnapshotFormat(snapshot::ParseFormat(args->state_format));
+			game.SetSnapshotKeepPrevious(args->state_keep);
+			game.SetSnapshotCompressionLevel(args->state_compression);
+			if (args->save_state_in_background) {
+				snapshot_writer.emplace();
+				game.SetSnapshotWriter(*snapshot_writer);
+			}
+			if (args->action_log_exist) {
+				action_log.emplace(args->action_log_path);
+				game.SetActionLog(*action_log);
+			}
 			// Когда сервер запускается с указанием пути к существующему файлу состояния, он должен должен восстановить это состояние. 
 			game.DeserilizeState();
 		}
 
 
-		if (args->save_state_period_exist) {
+		// при автоматическом тике снимки пишет отдельный таймер, иначе они идут по игровому времени
+		if (args->save_state_period_exist && !args->tick_period_exist) {
 			game.SetSaveStatePeriod(static_cast<std::chrono::milliseconds>(std::stoi(args->save_state_period)));
 		}
 
 		game.SetStaticPath(std::string(args->static_files_path));
+		// Статические файлы читаются и сжимаются один раз при старте
+		static_cache::StaticCache static_cache{ args->static_files_path, args->static_cache_size };
 
 		// 2. Инициализируем io_context
 		const unsigned num_threads = std::thread::hardware_concurrency();
 		net::io_context ioc(num_threads);
 
+		// Ответы на запросы состояния игры, собираемые после тика
+		response_cache::ResponseCache response_cache{ game };
+		response_cache.SetCompressor(compressor);
+
+		// strand, в котором выполняются запросы к API
+		auto handler_strand = net::make_strand(ioc);
+		// WebSocket-соединения игроков, получающих состояние после каждого тика
+		game_socket::Hub socket_hub{ game, response_cache, handler_strand };
+
 		// автоматическое обновление времени
 		if (args->tick_period_exist) {
 			// strand, используемый для доступа к API
@@ -218,10 +413,38 @@ int main(int argc, const char* argv[]) {
 			auto ticker = std::make_shared<ticker::Ticker>(
 				api_strand,
 				static_cast<std::chrono::milliseconds>(std::stoi(args->tick_period)),
-				[&game](std::chrono::milliseconds period_ms) {
+				[&game, &response_cache, &socket_hub](std::chrono::milliseconds period_ms) {
 					game.SpendTime(period_ms);
+					response_cache.Refresh();
+					socket_hub.Publish();
 				});
 			ticker->Start();
+
+			// Снимки состояния пишутся по своему таймеру в том же strand, что и тик, поэтому
+			// копия состояния согласована. Случайная добавка к периоду разносит запись снимков
+			// разных серверов на общем диске
+			if (args->save_state_period_exist && args->state_file_exist) {
+				const auto save_state_period = static_cast<std::chrono::milliseconds>(std::stoi(args->save_state_period));
+				auto snapshot_ticker = std::make_shared<ticker::Ticker>(
+					api_strand,
+					save_state_period,
+					[&game](std::chrono::milliseconds) {
+						game.SavePeriodicState();
+					},
+					save_state_period / SAVE_STATE_JITTER_DIVISOR);
+				snapshot_ticker->Start();
+			}
+		}
+		// Изменённые статические файлы перечитываются по таймеру; запросы к файлам
+		// обслуживаются по прежнему содержимому кэша, пока обход не закончится
+		if (args->static_rescan_period_exist) {
+			auto rescan_ticker = std::make_shared<ticker::Ticker>(
+				net::make_strand(ioc),
+				static_cast<std::chrono::milliseconds>(std::stoi(args->static_rescan_period)),
+				[&static_cache](std::chrono::milliseconds) {
+					static_cache.Rescan();
+				});
+			rescan_ticker->Start();
 		}
 		// Подписываемся на сигналы и при их получении завершаем работу сервера
 		net::signal_set signals(ioc, SIGINT, SIGTERM);
@@ -239,7 +462,7 @@ int main(int argc, const char* argv[]) {
 
 		// 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
 		auto handler = std::make_shared<http_handler::RequestHandler>(
-			game, connection_pool, "lol/kek", net::make_strand(ioc));
+			game, *repository, leaderboard, response_cache, socket_hub, compressor, static_cache, "lol/kek", handler_strand);
 
 		// 5. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
 		const auto address = net::ip::make_address("0.0.0.0");
@@ -253,7 +476,21 @@ int main(int argc, const char* argv[]) {
 					std::forward<decltype(send)>(send));
 			});
 
-		LogStartServer(port, adress_str);
+		LogStartServer(port, adress_str,
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time));
+
+		// БД готовится после начала приёма соединений: игра не ждёт БД, а выбывшие игроки
+		// копятся в журнале выбывших, пока он не начнёт переносить их в БД
+		std::jthread database_init([&repository, &leaderboard, &game, &spool, handler](std::stop_token stop) {
+			PrepareDatabase(stop, *repository, leaderboard, [&game, &spool, &handler] {
+				// запросы к БД допустимы только после создания таблицы
+				game.ResubmitReplayedRetired();
+				if (spool) {
+					spool->Start();
+				}
+				handler->SetDatabaseReady();
+			});
+		});
 
 		// Эта надпись сообщает тестам о том, что сервер запущен и готов
 		// обрабатывать запросы
@@ -262,6 +499,16 @@ int main(int argc, const char* argv[]) {
 		// 6. Запускаем обработку асинхронных операций
 		RunWorkers(std::max(1u, num_threads), [&ioc] { ioc.run(); });
 
+		// Подготовка БД прерывается между попытками; начатый запрос к БД дожидаемся
+		database_init.request_stop();
+		database_init.join();
+
+		// Журнал выбывших игроков останавливается до пула потоков БД: иначе его поток
+		// переноса ждал бы запроса, который остановленный пул уже не выполнит
+		spool.reset();
+		// Дописываем в БД выбывших игроков, запись которых ещё выполняется
+		repository->Wait();
+
 		// Когда сервер запускается без указания пути к файлу с сохранённым состоянием, он должен стартовать с чистого листа. 
 		// При получении сигнала о завершении работы сервер не должен создавать никаких файлов.
 		if (args->state_file_exist) {
@@ -271,6 +518,9 @@ int main(int argc, const char* argv[]) {
 			// Когда сервер запускается с указанием пути к существующему файлу состояния, он должен должен восстановить это состояние. 
 			// При получении сигнала о завершении работы сервер должен сохранить обновлённое состояние.
 			game.SerilizeState();
+			if (snapshot_writer) {
+				snapshot_writer->Flush();
+			}
 		}
 	}
 	catch (const std::exception& ex) {
@@ -5,14 +5,34 @@
 #include <stdexcept>
 #include <utility>
 #include <fstream>
+#include <iterator>
 #include <filesystem>
 #include <iostream>
+#include "action_log.h"
+#include "my_logger.h"
 #include "random_functions.h"
+#include "snapshot.h"
 
 namespace model {
 	const static double EPS{ 0.00000001 };
 	using namespace std::literals;
 
+	namespace {
+		void LogRetiredError(std::exception_ptr error) {
+			std::string text;
+			try {
+				std::rethrow_exception(error);
+			}
+			catch (const std::exception& ex) {
+				text = ex.what();
+			}
+			catch (...) {
+				text = "unknown error"s;
+			}
+			logger::LogError("retired players"sv, text);
+		}
+	}  // namespace
+
 	void Map::AddOffice(const Office& office) {
 		if (warehouse_id_to_index_.contains(office.GetId())) {
 			throw std::invalid_argument("Duplicate warehouse");
@@ -398,53 +418,47 @@ namespace model {
 	}
 
 	void Game::CopyGame(GameRepr& game_repr) {
-		for (const auto& value : hash_to_palyer_id_) {
-			game_repr.hash_to_palyer_id[value.first] = value.second;
-		}
-
-		for (const auto& value : hash_to_map_name_) {
-			game_repr.hash_to_map_name[value.first] = value.second;
-		}
-
-		for (const auto& value : palyer_id_to_player_name_) {
-			game_repr.palyer_id_to_player_name[value.first] = value.second;
-		}
-
-		for (const auto& value : map_name_to_players_) {
-			auto& map_name_to_players = game_repr.map_name_to_players[value.first];
-			std::copy(value.second.begin(), value.second.end(), inserter(map_name_to_players, map_name_to_players.begin()));
-		}
-
-		for (const auto& value : map_name_to_loot_) {
-			auto& map_name_to_loot = game_repr.map_name_to_loot[value.first];
-			std::copy(value.second.begin(), value.second.end(), inserter(map_name_to_loot, map_name_to_loot.begin()));
-		}
+		// копирование контейнеров целиком: память под копию выделяется один раз, без поэлементных вставок
+		game_repr.hash_to_palyer_id = hash_to_palyer_id_;
+		game_repr.hash_to_map_name = hash_to_map_name_;
+		game_repr.palyer_id_to_player_name = palyer_id_to_player_name_;
+		game_repr.map_name_to_players = map_name_to_players_;
+		game_repr.map_name_to_loot = map_name_to_loot_;
 	}
 
-	void Game::LoadGame(const GameRepr& game_repr) {
+	void Game::LoadGame(GameRepr&& game_repr) {
 		std::lock_guard<std::mutex> guard(mtx_map_name_to_players_);
 		std::lock_guard<std::mutex> guard2(mtx_map_name_to_loot_);
+		std::lock_guard<std::mutex> guard3(mtx_hash_to_map_name_);
 
-		for (const auto& value : game_repr.hash_to_palyer_id) {
-			hash_to_palyer_id_[value.first] = value.second;
-		}
+		// контейнеры снимка переносятся без копирования элементов
+		hash_to_palyer_id_.merge(game_repr.hash_to_palyer_id);
+		hash_to_map_name_.merge(game_repr.hash_to_map_name);
+		palyer_id_to_player_name_.merge(game_repr.palyer_id_to_player_name);
 
-		for (const auto& value : game_repr.hash_to_map_name) {
-			hash_to_map_name_[value.first] = value.second;
+		for (auto& [map_name, players] : game_repr.map_name_to_players) {
+			auto& target = map_name_to_players_[map_name];
+			if (target.empty()) {
+				target = std::move(players);
+			} else {
+				std::move(players.begin(), players.end(), std::back_inserter(target));
+			}
 		}
 
-		for (const auto& value : game_repr.palyer_id_to_player_name) {
-			palyer_id_to_player_name_[value.first] = value.second;
+		for (auto& [map_name, loot] : game_repr.map_name_to_loot) {
+			auto& target = map_name_to_loot_[map_name];
+			if (target.empty()) {
+				target = std::move(loot);
+			} else {
+				std::move(loot.begin(), loot.end(), std::back_inserter(target));
+			}
 		}
 
-		for (const auto& value : game_repr.map_name_to_players) {
-			auto& players = map_name_to_players_[value.first];
-			std::copy(value.second.begin(), value.second.end(), inserter(players, players.begin()));
+		for (const auto& [map_name, players] : map_name_to_players_) {
+			TouchMap(map_name);
 		}
-
-		for (const auto& value : game_repr.map_name_to_loot) {
-			auto& loot = map_name_to_loot_[value.first];
-			std::copy(value.second.begin(), value.second.end(), inserter(loot, loot.begin()));
+		for (const auto& [map_name, loot] : map_name_to_loot_) {
+			TouchMap(map_name);
 		}
 	}
 
@@ -461,59 +475,130 @@ namespace model {
 			return;
 		}
 
-		std::string temp_state_file_path(state_file_path_.value());
-		std::string original_state_file_path(state_file_path_.value());
-		temp_state_file_path.append("_tmp");
+		auto game_repr = std::make_shared<GameRepr>();
+		std::function<void()> on_written;
+		{
+			// копия и смена сегмента журнала под теми же блокировками, что и изменения игры:
+			// действие не может попасть в старый сегмент, не попав в снимок
+			std::lock_guard<std::mutex> guard(mtx_map_name_to_players_);
+			std::lock_guard<std::mutex> guard2(mtx_map_name_to_loot_);
+			std::lock_guard<std::mutex> guard3(mtx_hash_to_map_name_);
+			try {
+				CopyGame(*game_repr);
+			}
+			catch (...) {
+				throw std::invalid_argument("Wtf error");
+			}
+
+			// снимок - контрольная точка журнала действий: записи после неё пойдут в новый сегмент,
+			// а старые сегменты удаляются, когда снимок записан
+			if (action_log_ != nullptr) {
+				const uint64_t log_segment = action_log_->Rotate();
+				game_repr->log_segment = log_segment;
+				on_written = [action_log = action_log_, log_segment] {
+					action_log->RemoveBefore(log_segment);
+				};
+			}
+		}
+
+		snapshot::WriteOptions options;
+		options.format = snapshot_format_;
+		options.keep_previous = snapshot_keep_previous_;
+		options.compression_level = snapshot_compression_level_;
 
-		std::ofstream state_file{ temp_state_file_path }; // проверить, что в конце есть доп слеши
-		if (!state_file) {
-			throw std::invalid_argument("Open to state file to save error");
+		// в потоке тика остаётся только копирование, сериализация и запись на диск идут в фоне
+		if (snapshot_writer_ != nullptr) {
+			snapshot_writer_->Submit(std::move(game_repr), options, state_file_path_.value(), std::move(on_written));
+			return;
 		}
 
-		std::stringstream ss;
-		boost::archive::text_oarchive oa{ ss };
+		snapshot::WriteFile(*game_repr, options, state_file_path_.value());
+		if (on_written) {
+			on_written();
+		}
+	}
+
+	void Game::DeserilizeState() {
+		if (!state_file_path_.has_value()) {
+			return;
+		}
+
+		uint64_t log_segment{ 0 };
 		GameRepr game_repr;
 		try {
-			CopyGame(game_repr);
+			// Когда сервер запускается с указанием пути к отсутствующему файлу состояния, он должен стартовать с чистого листа. 
+			if (snapshot::LoadFile(state_file_path_.value(), game_repr)) {
+				log_segment = game_repr.log_segment;
+				LoadGame(std::move(game_repr));
+			}
 		}
 		catch (...) {
-			throw std::invalid_argument("Wtf error");
+			throw std::invalid_argument("Deserialization error");
 		}
 
-		oa << game_repr;
-		state_file << ss.rdbuf();
-		state_file.flush();
-		state_file.close();
 		try {
-			std::filesystem::rename(temp_state_file_path, original_state_file_path);
+			ReplayActionLog(log_segment);
 		}
 		catch (...) {
-			throw std::invalid_argument("Rename error");
+			throw std::invalid_argument("Action log replay error");
 		}
-
 	}
 
-	void Game::DeserilizeState() {
-		if (!state_file_path_.has_value()) {
+	void Game::ReplayActionLog(uint64_t from_segment) {
+		if (action_log_ == nullptr) {
 			return;
 		}
 
-		std::ifstream state_file{ state_file_path_.value() }; // проверить, что в конце есть доп слеши
-		if (!state_file) {
-			// Когда сервер запускается с указанием пути к отсутствующему файлу состояния, он должен стартовать с чистого листа. 
-			return;
-		}
-		std::stringstream ss;
-		ss << state_file.rdbuf();
-		boost::archive::text_iarchive ia{ ss };
-		GameRepr game_repr;
+		replaying_ = true;
 		try {
-			ia >> game_repr;
-			LoadGame(game_repr);
+			action_log_->Replay(from_segment, [this](const action_log::Record& record) {
+				if (const auto* join = std::get_if<action_log::Join>(&record)) {
+					if (const Map* map = FindMap(Map::Id{ join->map_name }); map != nullptr) {
+						std::lock_guard<std::mutex> guard(mtx_map_name_to_players_);
+						std::lock_guard<std::mutex> guard2(mtx_hash_to_map_name_);
+						PlacePlayer(map, join->map_name, join->token, join->user_name, join->id, join->pos);
+					}
+				} else if (const auto* move = std::get_if<action_log::Move>(&record)) {
+					std::string token{ move->token };
+					std::string map_name{ move->map_name };
+					MovePlayer(move->direction, token, map_name);
+				} else if (const auto* tick = std::get_if<action_log::Tick>(&record)) {
+					replay_loot_.clear();
+					for (const auto& spawn : tick->loot) {
+						replay_loot_[spawn.map_name] = spawn.loot;
+					}
+					SpendTime(std::chrono::milliseconds{ tick->period_ms });
+				} else if (const auto* retire = std::get_if<action_log::Retire>(&record)) {
+					replayed_retired_.insert(replayed_retired_.end(), retire->players.begin(), retire->players.end());
+				}
+			});
 		}
 		catch (...) {
-			throw std::invalid_argument("Deserialization error");
+			replaying_ = false;
+			throw;
+		}
+		replaying_ = false;
+		replay_loot_.clear();
+	}
+
+	void Game::SavePeriodicState() {
+		// на медленном диске снимки не должны копиться: пока предыдущий не записан, новый не снимается
+		if (snapshot_writer_ != nullptr && !snapshot_writer_->Idle()) {
+			return;
 		}
+		SerilizeState();
+	}
+
+	void Game::SetSnapshotKeepPrevious(size_t keep_previous) {
+		snapshot_keep_previous_ = keep_previous;
+	}
+
+	void Game::SetSnapshotCompressionLevel(int compression_level) {
+		snapshot_compression_level_ = compression_level;
+	}
+
+	void Game::SetSnapshotFormat(SnapshotFormat snapshot_format) {
+		snapshot_format_ = snapshot_format;
 	}
 
 	void Game::SetSaveStatePeriod(std::chrono::milliseconds save_state_period_ms) {
@@ -523,104 +608,206 @@ namespace model {
 		dog_retirement_time_ = dog_retirement_time;
 	}
 
-	void Game::WriteDataToDB(const std::vector<postgres::RetiredPlayer>& left_players) {
-		if (!left_players.empty()) {
-			auto connect_db = connection_pool_.GetConnection();
-			postgres::WriteRetiredToDatabase(*connect_db, left_players);
+	void Game::WriteDataToDB(const std::vector<retired_repository::RetiredPlayer>& left_players) {
+		if (left_players.empty()) {
+			return;
+		}
+		// при восстановлении из журнала действий выбывшие игроки берутся из записей Retire
+		if (replaying_) {
+			return;
 		}
+		if (action_log_ != nullptr) {
+			// идентификаторы строк БД выдаются до записи в журнал: повторная запись
+			// после восстановления не создаст дубликатов
+			action_log::Retire retire{ left_players };
+			for (auto& player : retire.players) {
+				if (player.record_id.empty()) {
+					player.record_id = random_functions::RandomHexString(32);
+				}
+			}
+			action_log_->Append(retire);
+			SubmitRetired(retire.players);
+			return;
+		}
+		SubmitRetired(left_players);
 	}
 
-	void Game::SpendTime(std::chrono::milliseconds period_ms) {
-		std::lock_guard<std::mutex> guard(mtx_map_name_to_players_);
-		std::lock_guard<std::mutex> guard2(mtx_map_name_to_loot_);
-		std::lock_guard<std::mutex> guard3(mtx_hash_to_map_name_);
+	void Game::SubmitRetired(const std::vector<retired_repository::RetiredPlayer>& left_players) {
+		// Журнал переживает недоступность БД и сам переносит записи в неё
+		if (retired_spool_ != nullptr && retired_spool_->Append(left_players)) {
+			return;
+		}
+		// Запись выполняется вне потока тика, тик не ждёт ответа от хранилища
+		auto retired = std::make_shared<const std::vector<retired_repository::RetiredPlayer>>(left_players);
+		repository_.AsyncExecute(
+			[retired](retired_repository::RetiredPlayersRepository& repository) {
+				repository.Save(*retired);
+			},
+			[leaderboard = leaderboard_, retired](std::exception_ptr error) {
+				if (error) {
+					LogRetiredError(error);
+					return;
+				}
+				if (leaderboard != nullptr) {
+					leaderboard->AddRetired(*retired);
+				}
+			});
+	}
+
+	void Game::SetLeaderboard(leaderboard::Leaderboard& leaderboard) {
+		leaderboard_ = &leaderboard;
+	}
+
+	void Game::SetRetiredSpool(retired_spool::RetiredSpool& spool) {
+		retired_spool_ = &spool;
+	}
+
+	void Game::SetSnapshotWriter(snapshot::BackgroundWriter& snapshot_writer) {
+		snapshot_writer_ = &snapshot_writer;
+	}
+
+	void Game::SetActionLog(action_log::ActionLog& action_log) {
+		action_log_ = &action_log;
+	}
 
+	void Game::ResubmitReplayedRetired() {
+		if (replayed_retired_.empty()) {
+			return;
+		}
+		// Тот же путь, что у новых выбывших: журнал выбывших повторяет запись до успеха
+		// и обновляет таблицу рекордов. Записи, уже попавшие в БД или в таблицу рекордов,
+		// отбрасываются по идентификатору строки
+		std::vector<retired_repository::RetiredPlayer> retired = std::move(replayed_retired_);
+		replayed_retired_.clear();
+		SubmitRetired(retired);
+	}
+
+	void Game::SpendTime(std::chrono::milliseconds period_ms) {
 		auto to_sec = [](std::chrono::milliseconds _period_ms) {
 			const double MS_TO_SEC = 1000.0;
 			return static_cast<double>(_period_ms.count()) / MS_TO_SEC; };
 		double delta_time = to_sec(period_ms);
 
+		// снимок берёт те же блокировки, поэтому пишется после их освобождения
+		{
+			std::lock_guard<std::mutex> guard(mtx_map_name_to_players_);
+			std::lock_guard<std::mutex> guard2(mtx_map_name_to_loot_);
+			std::lock_guard<std::mutex> guard3(mtx_hash_to_map_name_);
 
-		auto new_time = current_game_time_ + delta_time;
-		for (auto& map_palyers : map_name_to_players_) {
-			std::vector<postgres::RetiredPlayer> left_players;
-			for (auto& player : map_palyers.second) {
-				if (!player.join_time_.has_value()) {
-					player.join_time_ = current_game_time_;
-				}
-				// Перемещение текущего игрока по дороге текущей карты
-				// Дистанция на которую нужно выполнить перемещение
-				double distance{ 0.0 };
-				// игрок покинул игру, дальше идти смысла нет
-				if (player.is_left_game_) {
-					continue;
-				}
-				if (std::abs(player.speed_.x) < EPS && std::abs(player.speed_.y) < EPS) {
-					auto to_ms = [](double _period_s) {
-						const double SEC_TO_MS = 1000.0;
-						return static_cast<int>(_period_s * SEC_TO_MS); };
-					player.no_move_time_ += delta_time;
-					if (to_ms(player.no_move_time_) >= to_ms(dog_retirement_time_)) {
-						player.is_left_game_ = true;
-						invalid_tokens_.emplace_back(player.hash_);
-						hash_to_map_name_.erase(player.hash_);
-						left_players.emplace_back(static_cast<int>(player.id_), player.name_,
-							static_cast<int>(player.score_),
-							static_cast<int>(new_time - player.join_time_.value()));
+			// запись тика для журнала действий
+			action_log::Tick tick{ period_ms.count() };
+
+
+			auto new_time = current_game_time_ + delta_time;
+			for (auto& map_palyers : map_name_to_players_) {
+				std::vector<retired_repository::RetiredPlayer> left_players;
+				for (auto& player : map_palyers.second) {
+					if (!player.join_time_.has_value()) {
+						player.join_time_ = current_game_time_;
+					}
+					// Перемещение текущего игрока по дороге текущей карты
+					// Дистанция на которую нужно выполнить перемещение
+					double distance{ 0.0 };
+					// игрок покинул игру, дальше идти смысла нет
+					if (player.is_left_game_) {
+						continue;
+					}
+					if (std::abs(player.speed_.x) < EPS && std::abs(player.speed_.y) < EPS) {
+						auto to_ms = [](double _period_s) {
+							const double SEC_TO_MS = 1000.0;
+							return static_cast<int>(_period_s * SEC_TO_MS); };
+						player.no_move_time_ += delta_time;
+						if (to_ms(player.no_move_time_) >= to_ms(dog_retirement_time_)) {
+							player.is_left_game_ = true;
+							invalid_tokens_.emplace_back(player.hash_);
+							hash_to_map_name_.erase(player.hash_);
+							left_players.emplace_back(static_cast<int>(player.id_), player.name_,
+								static_cast<int>(player.score_),
+								static_cast<int>(new_time - player.join_time_.value()));
+						}
+						continue;
+					}
+					player.no_move_time_ = 0.0;
+					double delta_time_float = static_cast<double>(delta_time);
+					if (player.direction_ == Direction::EAST ||
+						player.direction_ == Direction::WEST) {
+						distance = player.speed_.x * delta_time_float;
+					} else {
+						distance = player.speed_.y * delta_time_float;
+					}
+					// позиция до начала перемещения
+					FloatCoord start_pos{ player.pos_ };
+					//вход в рекурсию
+					player.MoveOnDistance(*this, distance);
+
+					// Добавляем игрока к списку сборщиков лута
+					collision_detector::Gatherer gatherer{ {start_pos.x, start_pos.y}, {player.pos_.x, player.pos_.y}, PLAYER_WIDTH };
+					provider_.AddGatherer(gatherer);
+
+					// проверяем прошёл ли игрок базу
+					if (IsBaseReached(player, start_pos)) {
+						UpdatePlayerScore(player);
 					}
-					continue;
-				}
-				player.no_move_time_ = 0.0;
-				double delta_time_float = static_cast<double>(delta_time);
-				if (player.direction_ == Direction::EAST ||
-					player.direction_ == Direction::WEST) {
-					distance = player.speed_.x * delta_time_float;
-				} else {
-					distance = player.speed_.y * delta_time_float;
 				}
-				// позиция до начала перемещения
-				FloatCoord start_pos{ player.pos_ };
-				//вход в рекурсию
-				player.MoveOnDistance(*this, distance);
-
-				// Добавляем игрока к списку сборщиков лута
-				collision_detector::Gatherer gatherer{ {start_pos.x, start_pos.y}, {player.pos_.x, player.pos_.y}, PLAYER_WIDTH };
-				provider_.AddGatherer(gatherer);
-
-				// проверяем прошёл ли игрок базу
-				if (IsBaseReached(player, start_pos)) {
-					UpdatePlayerScore(player);
+				current_game_time_ = new_time;
+				WriteDataToDB(left_players);
+
+				// формируем список лута под удаление с карты
+				auto& loot_on_map = map_name_to_loot_[map_palyers.first];
+				Map::Id map_id{ map_palyers.second.at(0).map_name_ };
+				auto map_ptr = FindMap(map_id);
+				auto map_bag_capacity = map_ptr->GetBagCapacity();
+				auto current_bag_capacity = map_bag_capacity.has_value() ? map_bag_capacity.value() : default_bag_capacity_;
+				// предметы провайдера - лут этой карты: индексы событий подбора указывают в loot_on_map,
+				// и результат тика не зависит от порядка обхода карт
+				provider_.ClearItems();
+				for (const auto& current_loot : loot_on_map) {
+					collision_detector::Item item{ { current_loot.coord.x, current_loot.coord.y }, Game::LOOT_WIDTH };
+					provider_.AddItem(item);
 				}
-			}
-			current_game_time_ = new_time;
-			WriteDataToDB(left_players);
+				auto erased = LootIdsToEraseFromMap(provider_, map_palyers.second, loot_on_map, current_bag_capacity);
+
+				// удаление лута с карты
+				EraseLootFromMap(provider_, erased, loot_on_map);
 
-			// формируем список лута под удаление с карты
-			auto& loot_on_map = map_name_to_loot_[map_palyers.first];
-			Map::Id map_id{ map_palyers.second.at(0).map_name_ };
-			auto map_ptr = FindMap(map_id);
-			auto map_bag_capacity = map_ptr->GetBagCapacity();
-			auto current_bag_capacity = map_bag_capacity.has_value() ? map_bag_capacity.value() : default_bag_capacity_;
-			auto erased = LootIdsToEraseFromMap(provider_, map_palyers.second, loot_on_map, current_bag_capacity);
+				provider_.ClearGatherers();
 
-			// удаление лута с карты
-			EraseLootFromMap(provider_, erased, loot_on_map);
+				// генерация лута
+				if (replaying_) {
+					// при восстановлении из журнала лут берётся из записи тика, а не из генератора
+					if (auto spawn = replay_loot_.find(map_palyers.first); spawn != replay_loot_.end()) {
+						loot_on_map.push_back(spawn->second);
+					}
+				} else if (loot_generator_.has_value()) {
+					const size_t loot_count = loot_on_map.size();
+					GenerateLoot(loot_generator_, period_ms, loot_on_map, static_cast<unsigned int>(map_palyers.second.size()), *this, map_palyers.first, provider_);
+					if (loot_on_map.size() > loot_count) {
+						tick.loot.push_back({ map_palyers.first, loot_on_map.back() });
+					}
+				}
+			}
 
-			provider_.ClearGatherers();
+			if (action_log_ != nullptr && !replaying_) {
+				action_log_->Append(tick);
+			}
 
-			// генерация лута
-			if (loot_generator_.has_value()) {
-				GenerateLoot(loot_generator_, period_ms, loot_on_map, static_cast<unsigned int>(map_palyers.second.size()), *this, map_palyers.first, provider_);
+			// тик меняет позиции игроков и лут на всех картах
+			for (const auto& [map_name, players] : map_name_to_players_) {
+				TouchMap(map_name);
 			}
+			for (const auto& [map_name, loot] : map_name_to_loot_) {
+				TouchMap(map_name);
+			}
+			++tick_;
 		}
 
-		static double last_update_time{ 0.0 };
-		if (save_state_period_ms_.has_value()) {
-			last_update_time += delta_time;
-			double save_state_period_sec = to_sec(save_state_period_ms_.value());
-			if (last_update_time > save_state_period_sec) {
-				SerilizeState();
-				last_update_time = 0.0;
+		// без автоматического тика время идёт только по запросам, и снимки пишутся по игровому времени;
+		// при автоматическом тике снимки пишет отдельный таймер
+		if (save_state_period_ms_.has_value() && !replaying_) {
+			time_since_save_ += delta_time;
+			if (time_since_save_ > to_sec(save_state_period_ms_.value())) {
+				SavePeriodicState();
+				time_since_save_ = 0.0;
 			}
 		}
 
@@ -628,6 +815,9 @@ namespace model {
 
 	void Game::MovePlayer(std::string direction, std::string& token,
 		std::string& map_name) {
+		// изменение и его запись в журнал под одними блокировками: снимок видит либо оба, либо ничего
+		std::lock_guard<std::mutex> guard(mtx_map_name_to_players_);
+		std::lock_guard<std::mutex> guard2(mtx_hash_to_map_name_);
 		auto players_on_map = map_name_to_players_.find(map_name);
 		if (players_on_map == map_name_to_players_.end()) {
 			return;
@@ -669,12 +859,32 @@ namespace model {
 		} else {
 			assert(false);
 		};
+
+		TouchMap(map_name);
+
+		if (action_log_ != nullptr && !replaying_) {
+			action_log_->Append(action_log::Move{ map_name, token, direction });
+		}
+	}
+
+	uint64_t Game::GetMapVersion(const std::string& map_name) {
+		std::lock_guard<std::mutex> guard(mtx_map_versions_);
+		auto version = map_versions_.find(map_name);
+		return version == map_versions_.end() ? 0 : version->second;
+	}
+
+	void Game::TouchMap(const std::string& map_name) {
+		std::lock_guard<std::mutex> guard(mtx_map_versions_);
+		++map_versions_[map_name];
 	}
 
 	void Game::GetPlayersOnMap(std::deque<Player>& copy_players_on_map, const std::string& map_name) {
 		std::lock_guard<std::mutex> guard(mtx_map_name_to_players_);
 		copy_players_on_map.clear();
-		auto players_on_map = map_name_to_players_.find(map_name); //TODO не npos
+		auto players_on_map = map_name_to_players_.find(map_name);
+		if (players_on_map == map_name_to_players_.end()) {
+			return;
+		}
 		std::copy(players_on_map->second.begin(), players_on_map->second.end(), inserter(copy_players_on_map, copy_players_on_map.begin()));
 	}
 
@@ -704,32 +914,54 @@ namespace model {
 	int Game::AddPlayerOnMap(const Map* map, const std::string& map_name,
 		const std::string& hash,
 		const std::string& user_name) {
+		// изменение и его запись в журнал под одними блокировками: снимок видит либо оба, либо ничего
+		std::lock_guard<std::mutex> guard(mtx_map_name_to_players_);
+		std::lock_guard<std::mutex> guard2(mtx_hash_to_map_name_);
 
 		int new_id = static_cast<int>(hash_to_palyer_id_.size() + 1);// std::stoi(util::detail::UUIDToString(util::detail::NewUUID()));//
 
-		hash_to_palyer_id_[hash] = new_id;
-		hash_to_map_name_[hash] = map_name;
-		palyer_id_to_player_name_[new_id] = user_name;
-
 		// После добавления на карту пёс должен иметь имеет скорость, равную нулю.
 		// Координаты пса — случайно выбранная точка на случайно выбранном отрезке
 		// дороги этой карты. Направление пса по умолчанию — на север.
-		model::Player new_player;
+		FloatCoord pos;
 		if (random_start_pos_) {
-			new_player.pos_ = GetRandomPos(map);
+			pos = GetRandomPos(map);
 		} else {
 			auto roads{ map->GetRoads() };
-			new_player.pos_ = { static_cast<double>(roads.begin()->GetStart().x),
-							   static_cast<double>(roads.begin()->GetStart().y) };
+			pos = { static_cast<double>(roads.begin()->GetStart().x),
+				   static_cast<double>(roads.begin()->GetStart().y) };
+		}
+		if (!PlacePlayer(map, map_name, hash, user_name, new_id, pos)) {
+			return static_cast<int>(hash_to_palyer_id_.at(hash));
 		}
+
+		if (action_log_ != nullptr && !replaying_) {
+			action_log_->Append(action_log::Join{ map_name, hash, user_name, static_cast<uint64_t>(new_id), pos });
+		}
+		return new_id;
+	}
+
+	bool Game::PlacePlayer(const Map* map, const std::string& map_name, const std::string& hash,
+		const std::string& user_name, uint64_t id, FloatCoord pos) {
+		// игрок с этим токеном уже есть, например, в снимке, записанном после записи Join
+		if (hash_to_palyer_id_.contains(hash)) {
+			return false;
+		}
+		hash_to_palyer_id_[hash] = id;
+		hash_to_map_name_[hash] = map_name;
+		palyer_id_to_player_name_[id] = user_name;
+
+		model::Player new_player;
+		new_player.pos_ = pos;
 		//new_player.map_ = std::shared_ptr<const model::Map>(map);
 		new_player.map_name_ = *map->GetId();
-		new_player.id_ = new_id;
+		new_player.id_ = id;
 		new_player.name_ = user_name;
 		new_player.hash_ = hash;
 		new_player.base_pos_ = new_player.pos_;
 		map_name_to_players_[map_name].emplace_back(std::move(new_player));
-		return new_id;
+		TouchMap(map_name);
+		return true;
 	}
 
 	std::string DirectionToString(Direction direction) {
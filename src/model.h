@@ -1,7 +1,10 @@
 #pragma once
+#include <atomic>
 #include <deque>
+#include <functional>
 #include <list>
 #include <memory>
+#include <boost/serialization/version.hpp>
 #include <boost/serialization/optional.hpp>
 #include <string>
 #include <unordered_map>
@@ -11,7 +14,9 @@
 #include "loot_generator.h"
 #include "tagged.h"
 #include "collision_detector.h"
-#include "postgres.h"
+#include "retired_repository.h"
+#include "leaderboard.h"
+#include "retired_spool.h"
 
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
@@ -20,6 +25,14 @@
 #include <boost/serialization/deque.hpp>
 #include <boost/serialization/list.hpp>
 
+namespace snapshot {
+	class BackgroundWriter;
+}  // namespace snapshot
+
+namespace action_log {
+	class ActionLog;
+}  // namespace action_log
+
 namespace model {
 
 	class Provider : public collision_detector::ItemGathererProvider {
@@ -448,20 +461,35 @@ namespace model {
 		}
 	};
 
+	// Формат файла состояния игры
+	enum class SnapshotFormat {
+		// текстовый архив Boost.Serialization
+		TEXT,
+		// двоичный формат snapshot
+		BINARY,
+		// двоичные файлы по картам и манифест, который на них ссылается
+		SHARDED,
+	};
+
 	struct GameRepr {
 		std::unordered_map<std::string, uint64_t> hash_to_palyer_id;
 		std::unordered_map<std::string, std::string> hash_to_map_name;
 		std::unordered_map<uint64_t, std::string> palyer_id_to_player_name;
 		std::unordered_map<std::string, std::deque<Player>> map_name_to_players;
 		std::unordered_map<std::string, std::deque<Loot>> map_name_to_loot;
+		// номер первого сегмента журнала действий, не вошедшего в снимок; 0 - журнала нет
+		uint64_t log_segment{ 0 };
 
 		template<class Archive>
-		void serialize(Archive& ar, [[maybe_unused]] const unsigned int version) {
+		void serialize(Archive& ar, const unsigned int version) {
 			ar& hash_to_palyer_id;
 			ar& hash_to_map_name;
 			ar& palyer_id_to_player_name;
 			ar& map_name_to_players;
 			ar& map_name_to_loot;
+			if (version >= 1) {
+				ar& log_segment;
+			}
 		}
 	};
 
@@ -478,15 +506,8 @@ namespace model {
 
 		using Maps = std::vector<Map>;
 
-		Game(postgres::ConnectionPool& connection_pool) : connection_pool_(connection_pool) {
-			try {
-				auto connection = connection_pool_.GetConnection();
-				postgres::CreateTable(*connection);
-			}
-			catch (...)
-			{
-				throw std::invalid_argument("DataBase init error!");
-			}
+		/// @param repository хранилище выбывших игроков, подготовленное до начала игры
+		Game(retired_repository::RetiredPlayersRepository& repository) : repository_(repository) {
 		};
 
 		/// @brief Просчёт игрового времени
@@ -529,6 +550,16 @@ namespace model {
 		/// @param map_name имя карты
 		void GetLootOnMap(std::deque<Loot>& copy_loot_on_map, std::string map_name);
 
+		/// @brief версия состояния карты, меняется после каждого изменения игроков или лута на ней
+		/// @param map_name имя карты
+		/// @return 0 - карта ещё не менялась
+		uint64_t GetMapVersion(const std::string& map_name);
+
+		/// @brief номер последнего просчитанного тика
+		uint64_t GetTick() const noexcept {
+			return tick_;
+		}
+
 		/// @brief получить имя карты по хэшу
 		/// @param token токен игрока
 		/// @return nullptr такой карты нет
@@ -564,6 +595,10 @@ namespace model {
 		/// @brief сериализация состояния игры
 		void SerilizeState();
 
+		/// @brief периодическая запись снимка; пропускается, пока фоновая запись предыдущего
+		/// снимка не закончена, так что в работе не больше одного снимка
+		void SavePeriodicState();
+
 		/// @brief десериализация состояния игры
 		void DeserilizeState();
 
@@ -572,17 +607,30 @@ namespace model {
 		void CopyGame(GameRepr& game_repr);
 
 		/// @brief загрузка состония игры из файла
-		/// @param game_repr состояние игры из файла
-		void LoadGame(const GameRepr& game_repr);
+		/// @param game_repr состояние игры из файла, его контейнеры переносятся в игру
+		void LoadGame(GameRepr&& game_repr);
 
 		/// @brief установка пути к файлу с состоянием игры
 		/// @param state_file_path путь к файлу с состоянием игры
 		void SetStateFilePath(std::string state_file_path);
 
-		/// @brief установить период автоматической записи в файл состояния игры 
+		/// @brief установить формат записи файла состояния игры, читаются оба формата
+		/// @param snapshot_format формат файла состояния
+		void SetSnapshotFormat(SnapshotFormat snapshot_format);
+
+		/// @brief установить период записи в файл состояния игры по игровому времени,
+		/// используется без автоматического тика
 		/// @param save_state_period_ms_ период автоматической записи в файл состояния игры
 		void SetSaveStatePeriod(std::chrono::milliseconds save_state_period_ms);
 
+		/// @brief установить число хранимых предыдущих снимков
+		/// @param keep_previous сколько предыдущих снимков хранить рядом с файлом состояния
+		void SetSnapshotKeepPrevious(size_t keep_previous);
+
+		/// @brief установить уровень сжатия файла состояния, сжатые и несжатые снимки читаются одинаково
+		/// @param compression_level уровень сжатия zlib 1-9, 0 - без сжатия
+		void SetSnapshotCompressionLevel(int compression_level);
+
 		/// @brief обновляем счёт игрока
 		/// @param player игрок 
 		void UpdatePlayerScore(Player& player);
@@ -593,8 +641,45 @@ namespace model {
 
 		/// @brief Запись данных о выбывших игроках в БД
 		/// @param left_players выбывшие игроках в БД
-		void WriteDataToDB(const std::vector<postgres::RetiredPlayer>& left_players);
+		void WriteDataToDB(const std::vector<retired_repository::RetiredPlayer>& left_players);
+
+		/// @brief установить таблицу рекордов в памяти, обновляемую при записи в БД
+		/// @param leaderboard таблица рекордов
+		void SetLeaderboard(leaderboard::Leaderboard& leaderboard);
+
+		/// @brief установить локальный журнал, через который выбывшие игроки попадают в БД
+		/// @param spool журнал выбывших игроков
+		void SetRetiredSpool(retired_spool::RetiredSpool& spool);
+
+		/// @brief установить фоновую запись снимков; без неё снимок пишется в потоке тика
+		/// @param snapshot_writer фоновая запись снимков
+		void SetSnapshotWriter(snapshot::BackgroundWriter& snapshot_writer);
+
+		/// @brief установить журнал действий; снимки состояния становятся его контрольными точками
+		/// @param action_log журнал действий
+		void SetActionLog(action_log::ActionLog& action_log);
+
+		/// @brief передать в хранилище выбывших игроков, восстановленных из журнала действий;
+		/// вызывается, когда хранилище готово к записи
+		void ResubmitReplayedRetired();
 	private:
+		/// @brief размещение игрока на карте с заданными id и позицией;
+		/// вызывается под блокировками игроков и токенов
+		/// @return false - игрок с таким токеном уже есть, повторно не добавляется
+		bool PlacePlayer(const Map* map, const std::string& map_name, const std::string& hash,
+			const std::string& user_name, uint64_t id, FloatCoord pos);
+
+		/// @brief передача выбывших игроков в журнал выбывших или в хранилище
+		void SubmitRetired(const std::vector<retired_repository::RetiredPlayer>& left_players);
+
+		/// @brief отметить изменение состояния карты, вызывается после изменения
+		/// @param map_name имя карты
+		void TouchMap(const std::string& map_name);
+
+		/// @brief применение записей журнала действий поверх загруженного снимка
+		/// @param from_segment номер первого сегмента, не вошедшего в снимок
+		void ReplayActionLog(uint64_t from_segment);
+
 		using MapIdHasher = util::TaggedHasher<Map::Id>;
 		using MapIdToIndex = std::unordered_map<Map::Id, size_t, MapIdHasher>;
 
@@ -638,9 +723,41 @@ namespace model {
 
 		// период автоматической записи в файл состояния игры 
 		boost::optional<std::chrono::milliseconds> save_state_period_ms_;
+		// игровое время с последней записи снимка, сек
+		double time_since_save_{ 0.0 };
+
+		// сколько предыдущих снимков хранить
+		size_t snapshot_keep_previous_{ 0 };
+
+		// уровень сжатия файла состояния, 0 - без сжатия
+		int snapshot_compression_level_{ 0 };
+
+		// формат записи файла состояния игры
+		SnapshotFormat snapshot_format_{ SnapshotFormat::BINARY };
+
+		// хранилище выбывших игроков
+		retired_repository::RetiredPlayersRepository& repository_;
 
-		// пул потоков для работы с БД
-		postgres::ConnectionPool& connection_pool_;
+		// таблица рекордов в памяти
+		leaderboard::Leaderboard* leaderboard_{ nullptr };
+
+		// журнал выбывших игроков; без него запись идёт в БД напрямую
+		retired_spool::RetiredSpool* retired_spool_{ nullptr };
+
+		// фоновая запись снимков состояния игры
+		snapshot::BackgroundWriter* snapshot_writer_{ nullptr };
+
+		// журнал действий; без него состояние сохраняется только снимками
+		action_log::ActionLog* action_log_{ nullptr };
+
+		// идёт восстановление из журнала действий: новые записи в журнал не пишутся
+		bool replaying_{ false };
+
+		// лут, появившийся в восстанавливаемом тике, по именам карт
+		std::unordered_map<std::string, Loot> replay_loot_;
+
+		// выбывшие игроки из журнала действий, ожидающие готовности хранилища
+		std::vector<retired_repository::RetiredPlayer> replayed_retired_;
 
 		// Время бездействия по достижению которого будет сделана запись в БД
 		double dog_retirement_time_{ 60.0 };
@@ -648,8 +765,18 @@ namespace model {
 		// Текущее игровое время, сек
 		double current_game_time_{ 0.0 };
 
+		// номер последнего тика
+		std::atomic<uint64_t> tick_{ 0 };
+
+		// версии состояния карт для кэша ответов
+		std::mutex mtx_map_versions_;
+		std::unordered_map<std::string, uint64_t> map_versions_;
+
 		// токены покинувших игру игроков
 		std::deque<std::string> invalid_tokens_;
 	};
 
 }  // namespace model
+
+// версия 1: номер сегмента журнала действий
+BOOST_CLASS_VERSION(model::GameRepr, 1)
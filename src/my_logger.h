@@ -1,4 +1,6 @@
 #pragma once
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/json.hpp>
 #include <boost/log/core.hpp>  // для logging::core
 #include <boost/log/expressions.hpp>  // для выражения, задающего фильтр
 #include <boost/log/trivial.hpp>  // для BOOST_LOG_TRIVIAL
@@ -26,6 +28,7 @@ struct Literals {
   constexpr static std::string_view EXCEPTION = "exception"sv;
   constexpr static std::string_view CONTENT_TYPE = "content_type"sv;
   constexpr static std::string_view RESPONSE_TIME = "response_time"sv;
+  constexpr static std::string_view TIME_TO_LISTEN = "time_to_listen"sv;
   constexpr static std::string_view WHERE = "where"sv;
   constexpr static std::string_view TEXT = "text"sv;
 };
@@ -63,4 +66,17 @@ class LoggerSingleton {
 
   void Log(std::string_view message) { BOOST_LOG_TRIVIAL(info) << message; }
 };
+
+/// @brief запись ошибки фоновой работы: {"data": {"text": ..., "where": ...}, "message": "error"}
+/// @param where где произошла ошибка
+/// @param text текст ошибки
+inline void LogError(std::string_view where, std::string_view text) {
+  boost::json::object obj;
+  obj[std::string(Literals::TIMESTAMP)] = boost::posix_time::to_iso_extended_string(
+      boost::posix_time::microsec_clock::universal_time());
+  obj[std::string(Literals::DATA)] = {{std::string(Literals::TEXT), text},
+                                      {std::string(Literals::WHERE), where}};
+  obj[std::string(Literals::MESSAGE)] = "error"s;
+  LOG(boost::json::serialize(obj));
+}
 }  // namespace logger
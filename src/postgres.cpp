@@ -1,5 +1,6 @@
 #include "postgres.h"
 #include <pqxx/zview.hxx>
+#include <future>
 #include <iostream>
 #include "random_functions.h"
 
@@ -21,9 +22,17 @@ playTime int
 );
 )"_zv);
 
+		// Ключ рейтинга одним сравнением кортежей: (-score, playtime, name) по возрастанию.
+		// Имена сравниваются побайтово (COLLATE "C"), как в таблице рекордов в памяти
 		work.exec(R"(
-CREATE INDEX IF NOT EXISTS scores_rating ON
-retired_players (score DESC, playtime, name)
+CREATE INDEX IF NOT EXISTS scores_rating_keyset ON
+retired_players ((-score), playtime, (name COLLATE "C"))
+;
+)"_zv);
+
+		// Прежний индекс с сортировкой по правилам БД больше не используется
+		work.exec(R"(
+DROP INDEX IF EXISTS scores_rating
 ;
 )"_zv);
 
@@ -31,17 +40,35 @@ retired_players (score DESC, playtime, name)
 	}
 
 
+	void PrepareStatements(pqxx::connection& conn)
+	{
+		conn.prepare(Statements::INSERT_RETIRED, R"(INSERT INTO 
+retired_players (id, name, score, playtime) 
+VALUES ($1, $2, $3, $4)
+ON CONFLICT (id) DO NOTHING
+)"_zv);
+
+		conn.prepare(Statements::READ_RETIRED_PAGE, R"(SELECT name, score, playtime FROM retired_players
+ORDER BY -score, playtime, name COLLATE "C" OFFSET $1 LIMIT $2;
+)"_zv);
+
+		// Поиск по индексу scores_rating_keyset с ключа курсора. Записи с тем же ключом
+		// идут первыми, OFFSET пропускает только уже отданные из них
+		conn.prepare(Statements::READ_RETIRED_AFTER, R"(SELECT name, score, playtime FROM retired_players
+WHERE (-score, playtime, name COLLATE "C") >= (-$1::int, $2::int, $3::varchar COLLATE "C")
+ORDER BY -score, playtime, name COLLATE "C" OFFSET $4 LIMIT $5;
+)"_zv);
+	}
+
+
 	void WriteRetiredToDatabase(pqxx::connection& conn, const std::vector<RetiredPlayer >& vec_input)
 	{
 		pqxx::work work{ conn };
 
 		for (auto iter = vec_input.begin(); iter != vec_input.end(); iter++)
 		{
-			work.exec_params(R"(INSERT INTO 
-retired_players (id, name, score, playtime) 
-VALUES ($1, $2, $3, $4)
-)"_zv,
-random_functions::RandomHexString(32), iter->name, iter->score, iter->play_time_s);
+			const std::string id = iter->record_id.empty() ? random_functions::RandomHexString(32) : iter->record_id;
+			work.exec_prepared(Statements::INSERT_RETIRED, id, iter->name, iter->score, iter->play_time_s);
 		}
 		work.commit();
 	}
@@ -50,12 +77,154 @@ random_functions::RandomHexString(32), iter->name, iter->score, iter->play_time_
 	void ReadRetiredFromDatabase(pqxx::connection& conn, int start, int max_item, std::vector < RetiredPlayer >& vec_input)
 	{
 		pqxx::read_transaction read_trans(conn);
-		auto query_text = "SELECT name, score, playtime FROM retired_players ORDER BY score DESC, playtime, name OFFSET " +
-			read_trans.quote(start) + " LIMIT " + read_trans.quote(max_item) +
-			";";
-		for (auto [name, score, playtime] : read_trans.query<std::string, int, int>(query_text)) {
+		for (const auto& row : read_trans.exec_prepared(Statements::READ_RETIRED_PAGE, start, max_item)) {
+			vec_input.push_back({ 0, row[0].as<std::string>(), row[1].as<int>(), row[2].as<int>() });
+		}
+	}
+
+	void ReadAllRetiredFromDatabase(pqxx::connection& conn, size_t max_records, std::vector<RetiredPlayer>& vec_input)
+	{
+		pqxx::read_transaction read_trans(conn);
+		// Потоковое чтение: таблица может быть большой, не буферизуем результат целиком.
+		// Идентификатор строки читается в том же виде, в каком записывается: 32 hex-цифры без дефисов
+		const std::string query = "SELECT replace(id::text, '-', ''), name, score, playtime FROM retired_players LIMIT "s +
+			std::to_string(max_records);
+		for (auto [id, name, score, playtime] : read_trans.stream<std::string, std::string, int, int>(query)) {
+			vec_input.push_back({ 0, std::move(name), score, playtime, std::move(id) });
+		}
+	}
+
+	void ReadRetiredAfterCursor(pqxx::connection& conn, const RecordsCursor& cursor, int max_items,
+		std::vector<RetiredPlayer>& vec_input)
+	{
+		pqxx::read_transaction read_trans(conn);
+		auto result = read_trans.exec_prepared(Statements::READ_RETIRED_AFTER,
+			cursor.score, cursor.play_time_s, cursor.name, cursor.skip, max_items);
+		for (const auto& row : result) {
+			vec_input.push_back({ 0, row[0].as<std::string>(), row[1].as<int>(), row[2].as<int>() });
+		}
+	}
+
+	namespace {
+		/// @brief Хранилище на соединении, уже полученном из пула: работа, переданная в Post,
+		/// выполняется в пуле потоков БД и больше не ждёт соединения. Если соединение получить
+		/// не удалось, каждый метод выбрасывает ошибку его получения
+		class ConnectionRepository : public retired_repository::RetiredPlayersRepository {
+		public:
+			ConnectionRepository(ConnectionPool& pool, pqxx::connection* conn, std::exception_ptr error)
+				: pool_(pool)
+				, conn_(conn)
+				, error_(std::move(error)) {
+			}
+
+			void Init() override {
+				CreateTable(Connection(false));
+			}
+
+			void Save(const std::vector<RetiredPlayer>& retired_players) override {
+				WriteRetiredToDatabase(Connection(true), retired_players);
+			}
+
+			void ReadAll(size_t max_records, std::vector<RetiredPlayer>& retired_players) override {
+				ReadAllRetiredFromDatabase(Connection(false), max_records, retired_players);
+			}
+
+			void ReadPage(int start, int max_items, std::vector<RetiredPlayer>& retired_players) override {
+				ReadRetiredFromDatabase(Connection(true), start, max_items, retired_players);
+			}
+
+			void ReadAfter(const RecordsCursor& cursor, int max_items,
+				std::vector<RetiredPlayer>& retired_players) override {
+				ReadRetiredAfterCursor(Connection(true), cursor, max_items, retired_players);
+			}
+
+			/// @brief соединение уже получено, поэтому вложенная работа выполняется сразу
+			void Post(std::function<void(RetiredPlayersRepository&)> work) override {
+				work(*this);
+			}
+
+			void Wait() override {
+			}
+
+		private:
+			/// @param prepared нужны подготовленные запросы; таблица к этому времени должна существовать
+			pqxx::connection& Connection(bool prepared) {
+				if (error_) {
+					std::rethrow_exception(error_);
+				}
+				if (prepared) {
+					pool_.EnsurePrepared(*conn_);
+				}
+				return *conn_;
+			}
+
+			ConnectionPool& pool_;
+			pqxx::connection* conn_;
+			std::exception_ptr error_;
+		};
 
-			vec_input.push_back({ 0, name, score, playtime });
+		/// @brief выполнить работу в пуле потоков БД и дождаться её в вызывающем потоке
+		/// @param repository хранилище
+		/// @param work работа с хранилищем на полученном соединении
+		void ExecuteAndWait(retired_repository::RetiredPlayersRepository& repository,
+			const std::function<void(retired_repository::RetiredPlayersRepository&)>& work) {
+			std::promise<void> done;
+			auto result = done.get_future();
+			repository.Post([&done, &work](retired_repository::RetiredPlayersRepository& bound) {
+				try {
+					work(bound);
+					done.set_value();
+				}
+				catch (...) {
+					done.set_exception(std::current_exception());
+				}
+			});
+			result.get();
 		}
+	}  // namespace
+
+	void RetiredPlayersRepositoryImpl::Init() {
+		ExecuteAndWait(*this, [](RetiredPlayersRepository& repository) {
+			repository.Init();
+		});
+	}
+
+	void RetiredPlayersRepositoryImpl::Save(const std::vector<RetiredPlayer>& retired_players) {
+		ExecuteAndWait(*this, [&retired_players](RetiredPlayersRepository& repository) {
+			repository.Save(retired_players);
+		});
+	}
+
+	void RetiredPlayersRepositoryImpl::ReadAll(size_t max_records, std::vector<RetiredPlayer>& retired_players) {
+		ExecuteAndWait(*this, [max_records, &retired_players](RetiredPlayersRepository& repository) {
+			repository.ReadAll(max_records, retired_players);
+		});
+	}
+
+	void RetiredPlayersRepositoryImpl::ReadPage(int start, int max_items, std::vector<RetiredPlayer>& retired_players) {
+		ExecuteAndWait(*this, [start, max_items, &retired_players](RetiredPlayersRepository& repository) {
+			repository.ReadPage(start, max_items, retired_players);
+		});
+	}
+
+	void RetiredPlayersRepositoryImpl::ReadAfter(const RecordsCursor& cursor, int max_items,
+		std::vector<RetiredPlayer>& retired_players) {
+		ExecuteAndWait(*this, [&cursor, max_items, &retired_players](RetiredPlayersRepository& repository) {
+			repository.ReadAfter(cursor, max_items, retired_players);
+		});
+	}
+
+	void RetiredPlayersRepositoryImpl::Post(std::function<void(RetiredPlayersRepository&)> work) {
+		// Соединение ожидается в очереди пула без занятого потока; обработчик без своего
+		// executor'а выполняется в пуле потоков БД
+		connection_pool_.AsyncGetConnection(
+			[this, work = std::move(work)](std::exception_ptr error, ConnectionPool::ConnectionWrapper conn) {
+				ConnectionRepository repository{ connection_pool_, error ? nullptr : &*conn, error };
+				work(repository);
+			});
+	}
+
+	void RetiredPlayersRepositoryImpl::Wait() {
+		connection_pool_.Wait();
 	}
 }
@@ -3,24 +3,43 @@
 #include <pqxx/transaction>
 #include <pqxx/result>
 #include <pqxx/pqxx>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <mutex>
-#include <condition_variable>
+#include <unordered_set>
 #include <vector>
 
+#include "retired_repository.h"
 
 namespace postgres {
-	// Игрок покинувший игру
-	struct RetiredPlayer {
-		int id;
-		std::string name;
-		int score;
-		int play_time_s;
+	namespace net = boost::asio;
+
+	using retired_repository::RetiredPlayer;
+	using retired_repository::RecordsCursor;
+
+	// Имена подготовленных запросов
+	struct Statements {
+		Statements() = delete;
+		constexpr static const char* INSERT_RETIRED = "insert_retired";
+		constexpr static const char* READ_RETIRED_PAGE = "read_retired_page";
+		constexpr static const char* READ_RETIRED_AFTER = "read_retired_after";
 	};
 
 	/// @brief создать таблицу
 	/// @param conn соединение с БД
 	void CreateTable(pqxx::connection& conn);
 
+	/// @brief подготовить запросы к таблице retired_players на соединении.
+	/// Запросы живут, пока открыто соединение, таблица уже должна существовать
+	/// @param conn соединение с БД
+	void PrepareStatements(pqxx::connection& conn);
+
 	/// @brief записать покинвших игру игроков в БД
 	/// @param conn соединение с БД
 	/// @param retired_players покинвшие игру игроки
@@ -33,6 +52,21 @@ namespace postgres {
 	/// @param retired_players 
 	void ReadRetiredFromDatabase(pqxx::connection& conn, int start, int max_items, std::vector<RetiredPlayer>& retired_players);
 
+	/// @brief чтение из БД всей таблицы покинувших игру игроков, но не больше max_records записей
+	/// @param conn соединение с БД
+	/// @param max_records наибольшее число записей
+	/// @param retired_players прочитанные записи
+	void ReadAllRetiredFromDatabase(pqxx::connection& conn, size_t max_records, std::vector<RetiredPlayer>& retired_players);
+
+	/// @brief чтение из БД страницы рекордов, следующей за курсором.
+	/// Поиск идёт по индексу scores_rating_keyset, поэтому стоимость не зависит от глубины страницы
+	/// @param conn соединение с БД
+	/// @param cursor позиция последней отданной записи
+	/// @param max_items целое число, задающее максимальное количество элементов
+	/// @param retired_players прочитанные записи
+	void ReadRetiredAfterCursor(pqxx::connection& conn, const RecordsCursor& cursor, int max_items,
+		std::vector<RetiredPlayer>& retired_players);
+
 
 	class ConnectionPool {
 		using PoolType = ConnectionPool;
@@ -73,42 +107,234 @@ namespace postgres {
 		};
 
 		// ConnectionFactory is a functional object returning std::shared_ptr<pqxx::connection>
-		template <typename ConnectionFactory>
-		ConnectionPool(size_t capacity, ConnectionFactory&& connection_factory) {
-			pool_.reserve(capacity);
-			for (size_t i = 0; i < capacity; ++i) {
-				pool_.emplace_back(connection_factory());
+		using ConnectionFactory = std::function<ConnectionPtr()>;
+
+		/// @brief Пул не ждёт открытия соединений: первые initial_size соединений открываются
+		/// параллельно в отдельных потоках, остальные - по мере нехватки, но не больше max_size
+		/// @param initial_size число соединений, открываемых сразу
+		/// @param max_size максимальное число соединений
+		/// @param connection_factory функция открытия соединения
+		/// @param blocking_threads число потоков, в которых выполняются асинхронные запросы к БД
+		ConnectionPool(size_t initial_size, size_t max_size, ConnectionFactory connection_factory, size_t blocking_threads = 0)
+			: connection_factory_(std::move(connection_factory))
+			, max_size_(max_size)
+			, blocking_pool_(blocking_threads == 0 ? max_size : blocking_threads)
+			, connect_pool_(std::max<size_t>(1, std::min(initial_size, max_size))) {
+			pool_.reserve(max_size);
+			std::lock_guard lock{ mutex_ };
+			for (size_t i = 0; i < std::min(initial_size, max_size); ++i) {
+				StartConnect();
+			}
+		}
+
+		ConnectionPool(const ConnectionPool&) = delete;
+		ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+		~ConnectionPool() {
+			Wait();
+		}
+
+		/// @brief Дождаться завершения работы, уже переданной в пул потоков БД.
+		/// Запросы, ещё ждущие соединения, после этого не выполняются
+		void Wait() {
+			blocking_pool_.join();
+			connect_pool_.join();
+		}
+
+		/// @brief Подготовить запросы на соединении, если это ещё не сделано.
+		/// Подготовка выполняется один раз за время жизни соединения, при первом использовании
+		/// @param conn соединение, полученное из пула
+		void EnsurePrepared(pqxx::connection& conn) {
+			{
+				std::lock_guard lock{ mutex_ };
+				if (prepared_.count(&conn) != 0) {
+					return;
+				}
 			}
+			// Соединение принадлежит только вызывающему, поэтому готовим его без блокировки пула
+			PrepareStatements(conn);
+			std::lock_guard lock{ mutex_ };
+			prepared_.insert(&conn);
 		}
 
-		ConnectionWrapper GetConnection() {
-			std::unique_lock lock{ mutex_ };
-			// Блокируем текущий поток и ждём, пока cond_var_ не получит уведомление и не освободится
-			// хотя бы одно соединение
-			cond_var_.wait(lock, [this] {
-				return used_connections_ < pool_.size();
-				});
-			// После выхода из цикла ожидания мьютекс остаётся захваченным
+		/// @brief Асинхронное получение соединения без блокировки вызывающего потока.
+		/// Если свободных соединений нет, запрос встаёт в очередь и будет выполнен при возврате соединения.
+		/// Если ни одно соединение не открыто и открыть его не удалось, запрос завершается с ошибкой
+		/// последней попытки, а соединение в обработчике пустое.
+		/// Обработчик вызывается на своём executor'е (для use_awaitable - на executor'е корутины).
+		/// @param token обработчик вида void(std::exception_ptr, ConnectionWrapper) либо net::use_awaitable
+		template <typename CompletionToken>
+		auto AsyncGetConnection(CompletionToken&& token) {
+			return net::async_initiate<CompletionToken, void(std::exception_ptr, ConnectionWrapper)>(
+				[this](auto handler) {
+					auto ex = net::get_associated_executor(handler, blocking_pool_.get_executor());
+					// std::function требует копируемости, а обработчики asio бывают только перемещаемыми
+					auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+					Waiter waiter = [this, ex, shared_handler](std::exception_ptr error, ConnectionPtr&& conn) {
+						// Соединение сразу оборачиваем: если обработчик так и не будет вызван, оно вернётся в пул
+						net::post(ex, [shared_handler, error, wrapper = ConnectionWrapper{ std::move(conn), *this }]() mutable {
+							(*shared_handler)(error, std::move(wrapper));
+						});
+					};
 
-			return { std::move(pool_[used_connections_++]), *this };
+					ConnectionPtr conn;
+					{
+						std::lock_guard lock{ mutex_ };
+						if (used_connections_ == pool_.size()) {
+							GrowIfExhausted();
+							waiters_.push_back(std::move(waiter));
+							return;
+						}
+						conn = std::move(pool_[used_connections_++]);
+					}
+					waiter(nullptr, std::move(conn));
+				},
+				token);
 		}
 
 	private:
+		// ожидающий соединения асинхронный запрос: ошибка открытия соединения либо соединение
+		using Waiter = std::function<void(std::exception_ptr, ConnectionPtr&&)>;
+
+		/// @brief Открыть ещё одно соединение, если все заняты и предел не достигнут.
+		/// Вызывается под мьютексом
+		void GrowIfExhausted() {
+			if (used_connections_ == pool_.size() && pool_.size() + connecting_ < max_size_) {
+				StartConnect();
+			}
+		}
+
+		/// @brief Убрать из пула выданное соединение. Вызывается под мьютексом
+		void DropConnection(const pqxx::connection* conn) {
+			prepared_.erase(conn);
+			assert(used_connections_ != 0);
+			// на место освободившейся ячейки выданных соединений переносим последнее свободное
+			--used_connections_;
+			if (used_connections_ != pool_.size() - 1) {
+				pool_[used_connections_] = std::move(pool_.back());
+			}
+			pool_.pop_back();
+			GrowIfExhausted();
+		}
+
+		/// @brief Открыть соединение в отдельном пуле потоков. Вызывается под мьютексом
+		void StartConnect() {
+			++connecting_;
+			net::post(connect_pool_, [this] {
+				ConnectionPtr conn;
+				try {
+					conn = connection_factory_();
+				}
+				catch (...) {
+					const auto error = std::current_exception();
+					std::deque<Waiter> failed;
+					{
+						std::lock_guard lock{ mutex_ };
+						--connecting_;
+						// Соединений нет и никто их не открывает: асинхронные запросы не дождутся
+						// соединения, они завершаются с ошибкой. Следующий запрос снова попробует открыть соединение
+						if (pool_.empty() && connecting_ == 0) {
+							failed.swap(waiters_);
+						}
+					}
+					for (auto& waiter : failed) {
+						waiter(error, nullptr);
+					}
+					return;
+				}
+				AddConnection(std::move(conn));
+			});
+		}
+
+		/// @brief Добавить в пул новое соединение
+		void AddConnection(ConnectionPtr&& conn) {
+			Waiter waiter;
+			{
+				std::lock_guard lock{ mutex_ };
+				--connecting_;
+				pool_.push_back(std::move(conn));
+				if (!waiters_.empty()) {
+					// Новое соединение сразу передаётся первому асинхронному запросу из очереди
+					waiter = std::move(waiters_.front());
+					waiters_.pop_front();
+					conn = std::move(pool_[used_connections_++]);
+				}
+			}
+			if (waiter) {
+				waiter(nullptr, std::move(conn));
+			}
+		}
+
 		void ReturnConnection(ConnectionPtr&& conn) {
+			Waiter waiter;
 			// Возвращаем соединение обратно в пул
 			{
 				std::lock_guard lock{ mutex_ };
-				assert(used_connections_ != 0);
-				pool_[--used_connections_] = std::move(conn);
+				if (!conn->is_open()) {
+					// Соединение порвано (например, БД перезапускалась) - выбрасываем его,
+					// вместо него по мере нужды будет открыто новое
+					DropConnection(conn.get());
+					return;
+				}
+				if (!waiters_.empty()) {
+					// Соединение сразу передаётся первому асинхронному запросу из очереди
+					waiter = std::move(waiters_.front());
+					waiters_.pop_front();
+				} else {
+					assert(used_connections_ != 0);
+					pool_[--used_connections_] = std::move(conn);
+				}
+			}
+			if (waiter) {
+				waiter(nullptr, std::move(conn));
 			}
-			// Уведомляем один из ожидающих потоков об изменении состояния пула
-			cond_var_.notify_one();
 		}
 
+		ConnectionFactory connection_factory_;
+		// предельное число соединений
+		size_t max_size_;
+
 		std::mutex mutex_;
-		std::condition_variable cond_var_;
+		// открытые соединения: первые used_connections_ выданы, остальные свободны
 		std::vector<ConnectionPtr> pool_;
 		size_t used_connections_ = 0;
+		// соединения, которые открываются прямо сейчас
+		size_t connecting_ = 0;
+		// асинхронные запросы, ожидающие освобождения соединения
+		std::deque<Waiter> waiters_;
+		// соединения, на которых уже подготовлены запросы
+		std::unordered_set<const pqxx::connection*> prepared_;
+		// потоки, в которых выполняются асинхронные запросы к БД, чтобы не занимать потоки io_context
+		net::thread_pool blocking_pool_;
+		// потоки, открывающие соединения: они не должны стоять в очереди за запросами,
+		// ждущими этих соединений
+		net::thread_pool connect_pool_;
+	};
+
+	/// @brief Хранилище выбывших игроков в Postgres.
+	/// Соединение ожидается асинхронно, без занятого потока, а запрос выполняется в пуле
+	/// потоков БД. Методы чтения и записи ждут результата в вызывающем потоке, поэтому их не
+	/// вызывают из пула потоков БД: работа, переданная в Post, получает хранилище на уже
+	/// полученном соединении
+	class RetiredPlayersRepositoryImpl : public retired_repository::RetiredPlayersRepository {
+	public:
+		explicit RetiredPlayersRepositoryImpl(ConnectionPool& connection_pool)
+			: connection_pool_(connection_pool) {
+		}
+
+		void Init() override;
+		void Save(const std::vector<RetiredPlayer>& retired_players) override;
+		void ReadAll(size_t max_records, std::vector<RetiredPlayer>& retired_players) override;
+		void ReadPage(int start, int max_items, std::vector<RetiredPlayer>& retired_players) override;
+		void ReadAfter(const RecordsCursor& cursor, int max_items,
+			std::vector<RetiredPlayer>& retired_players) override;
+
+		/// @brief работа выполняется в пуле потоков БД, когда для неё освободится соединение
+		void Post(std::function<void(RetiredPlayersRepository&)> work) override;
+		void Wait() override;
+
+	private:
+		ConnectionPool& connection_pool_;
 	};
 
 }  // namespace postgres
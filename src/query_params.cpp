@@ -0,0 +1,65 @@
+#include "query_params.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+namespace query_params {
+
+	std::string DecodeUrl(const std::string& s) {
+		std::string result;
+		for (std::size_t i = 0; i < s.size(); i++) {
+			if (s[i] == '%') {
+				unsigned char v{ 0 };
+				const char* end = s.data() + std::min(i + 3, s.size());
+				auto [ptr, ec] = std::from_chars(s.data() + i + 1, end, v, 16);
+				if (ec != std::errc{} || ptr != s.data() + i + 3) {
+					throw std::invalid_argument("DecodeUrl error!");
+				}
+				result.push_back(static_cast<char>(v));
+				i += 2;
+			} else {
+				result.push_back(s[i]);
+			}
+		}
+		return result;
+	}
+
+	std::optional<std::unordered_map<std::string, std::string>> ParseQueryParams(std::string_view target) {
+		std::unordered_map<std::string, std::string> params;
+		auto query_begin = target.find('?');
+		if (query_begin == std::string_view::npos) {
+			return params;
+		}
+		std::string_view query = target.substr(query_begin + 1);
+		while (!query.empty()) {
+			auto param_end = query.find('&');
+			std::string_view param = query.substr(0, param_end);
+			query = param_end == std::string_view::npos ? std::string_view{} : query.substr(param_end + 1);
+			if (param.empty()) {
+				continue;
+			}
+			auto eq_pos = param.find('=');
+			try {
+				std::string key = DecodeUrl(std::string(param.substr(0, eq_pos)));
+				std::string value = eq_pos == std::string_view::npos ? std::string{} : DecodeUrl(std::string(param.substr(eq_pos + 1)));
+				params[std::move(key)] = std::move(value);
+			}
+			catch (const std::invalid_argument&) {
+				return std::nullopt;
+			}
+		}
+		return params;
+	}
+
+	bool ParseNonNegativeInt(std::string_view str, int& value) {
+		int result{ 0 };
+		auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), result);
+		if (ec != std::errc{} || ptr != str.data() + str.size() || result < 0) {
+			return false;
+		}
+		value = result;
+		return true;
+	}
+
+}  // namespace query_params
@@ -0,0 +1,27 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace query_params {
+
+	/// @brief декодировщик URI строки
+	/// @param s
+	/// @return
+	/// @throw std::invalid_argument после % нет двух шестнадцатеричных цифр
+	std::string DecodeUrl(const std::string& s);
+
+	/// @brief разбор параметров URI-строки запроса
+	/// @param target URI-строка запроса
+	/// @return декодированные параметры запроса в произвольном порядке;
+	/// std::nullopt - в параметрах неверная %-последовательность
+	std::optional<std::unordered_map<std::string, std::string>> ParseQueryParams(std::string_view target);
+
+	/// @brief разбор неотрицательного целого числа из параметра запроса
+	/// @param str значение параметра
+	/// @param value результат
+	/// @return false - значение не является неотрицательным целым числом
+	bool ParseNonNegativeInt(std::string_view str, int& value);
+
+}  // namespace query_params
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace rank_tree {
+
+	/// @brief Дерево порядковых статистик: декартово дерево, в узлах которого хранятся размеры поддеревьев.
+	/// Вставка, поиск места элемента и поиск элемента по месту выполняются за O(log n).
+	/// Допускаются равные элементы.
+	/// @tparam Value тип элемента
+	/// @tparam Compare строгий порядок элементов
+	template <typename Value, typename Compare = std::less<Value>>
+	class OrderStatisticTree {
+	public:
+		explicit OrderStatisticTree(Compare compare = Compare{})
+			: compare_(std::move(compare)) {
+		}
+
+		/// @brief добавить элемент
+		/// @param value элемент
+		void Insert(Value value) {
+			auto node = std::make_unique<Node>(std::move(value), priority_generator_());
+			// элементы, не превосходящие новый, уходят влево - новый встаёт после равных ему
+			auto [not_greater, greater] = Split(std::move(root_), node->value);
+			root_ = Merge(Merge(std::move(not_greater), std::move(node)), std::move(greater));
+		}
+
+		/// @brief количество элементов
+		size_t Size() const noexcept {
+			return SizeOf(root_.get());
+		}
+
+		bool Empty() const noexcept {
+			return root_ == nullptr;
+		}
+
+		/// @brief место элемента в дереве
+		/// @param value элемент
+		/// @return количество элементов, строго меньших value
+		size_t Rank(const Value& value) const {
+			size_t rank{ 0 };
+			const Node* node = root_.get();
+			while (node != nullptr) {
+				if (compare_(node->value, value)) {
+					rank += SizeOf(node->left.get()) + 1;
+					node = node->right.get();
+				} else {
+					node = node->left.get();
+				}
+			}
+			return rank;
+		}
+
+		/// @brief элемент по месту
+		/// @param index место элемента, начиная с 0
+		/// @return элемент
+		const Value& At(size_t index) const {
+			if (index >= Size()) {
+				throw std::out_of_range("OrderStatisticTree index out of range");
+			}
+			const Node* node = root_.get();
+			while (true) {
+				const size_t left_size = SizeOf(node->left.get());
+				if (index < left_size) {
+					node = node->left.get();
+				} else if (index == left_size) {
+					return node->value;
+				} else {
+					index -= left_size + 1;
+					node = node->right.get();
+				}
+			}
+		}
+
+		/// @brief удалить все элементы
+		void Clear() noexcept {
+			root_.reset();
+		}
+
+	private:
+		struct Node;
+		using NodePtr = std::unique_ptr<Node>;
+
+		struct Node {
+			Node(Value v, uint32_t p)
+				: value(std::move(v))
+				, priority(p) {
+			}
+
+			Value value;
+			uint32_t priority;
+			size_t size{ 1 };
+			NodePtr left;
+			NodePtr right;
+		};
+
+		static size_t SizeOf(const Node* node) noexcept {
+			return node == nullptr ? 0 : node->size;
+		}
+
+		static void Update(Node* node) noexcept {
+			node->size = SizeOf(node->left.get()) + SizeOf(node->right.get()) + 1;
+		}
+
+		/// @brief разрезать дерево на элементы, не превосходящие value, и элементы больше value
+		std::pair<NodePtr, NodePtr> Split(NodePtr node, const Value& value) {
+			if (node == nullptr) {
+				return { nullptr, nullptr };
+			}
+			if (compare_(value, node->value)) {
+				auto [left, right] = Split(std::move(node->left), value);
+				node->left = std::move(right);
+				Update(node.get());
+				return { std::move(left), std::move(node) };
+			}
+			auto [left, right] = Split(std::move(node->right), value);
+			node->right = std::move(left);
+			Update(node.get());
+			return { std::move(node), std::move(right) };
+		}
+
+		/// @brief слить два дерева, все элементы left не больше элементов right
+		static NodePtr Merge(NodePtr left, NodePtr right) {
+			if (left == nullptr) {
+				return right;
+			}
+			if (right == nullptr) {
+				return left;
+			}
+			if (left->priority > right->priority) {
+				left->right = Merge(std::move(left->right), std::move(right));
+				Update(left.get());
+				return left;
+			}
+			right->left = Merge(std::move(left), std::move(right->left));
+			Update(right.get());
+			return right;
+		}
+
+		Compare compare_;
+		NodePtr root_;
+		std::mt19937 priority_generator_{ std::random_device{}() };
+	};
+
+}  // namespace rank_tree
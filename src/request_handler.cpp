@@ -2,37 +2,26 @@
 
 #include "request_handler.h"
 
+#include <boost/crc.hpp>
 #include <boost/json.hpp>
+#include <algorithm>
+#include <charconv>
 #include <filesystem>
+#include <limits>
+#include <optional>
 #include <random>
+#include <sstream>
+#include <unordered_map>
 
+#include "content_encoding.h"
+#include "http_cache.h"
+#include "json_writer.h"
+#include "query_params.h"
 #include "random_functions.h"
 
 namespace http_handler {
 	using namespace boost::json;
 
-	/// @brief декодировщик URI строки
-	/// @param s
-	/// @return
-	std::string DecodeUrl(const std::string& s) {
-		std::string result;
-		for (std::size_t i = 0; i < s.size(); i++) {
-			if (s[i] == '%') {
-				try {
-					auto v = std::stoi(s.substr(i + 1, 2), nullptr, 16);
-					result.push_back(0xff & v);
-				}
-				catch (...) {
-					throw std::invalid_argument("DecodeUrl error!");
-				}
-				i += 2;
-			} else {
-				result.push_back(s[i]);
-			}
-		}
-		return result;
-	}
-
 	StringResponse MakeStringResponse(http::status status, std::string_view body,
 		unsigned http_version, bool keep_alive,
 		http::verb method,
@@ -136,6 +125,53 @@ namespace http_handler {
 		return response;
 	}
 
+	SharedStringResponse MakeSharedStringResponse(http::status status,
+		std::shared_ptr<const std::string> body,
+		unsigned http_version, bool keep_alive,
+		http::verb method,
+		std::string_view content_type) {
+		SharedStringResponse response(status, http_version);
+		response.set(http::field::content_type, content_type);
+		response.set(http::field::cache_control, "no-cache"sv);
+		response.content_length(http_server::SharedStringBody::size(body));
+		if (method != http::verb::head) {
+			response.body() = std::move(body);
+		}
+		response.keep_alive(keep_alive);
+		return response;
+	}
+
+	StringResponse MakeRecordsResponse(const StatusAndResponse& response, unsigned http_version,
+		bool keep_alive, http::verb method) {
+		auto records_response = MakeStringResponse(response.http_status, response.body,
+			http_version, keep_alive, method, ContentType::API_JSON);
+		if (!response.etag.empty()) {
+			records_response.set(http::field::etag, response.etag);
+		}
+		return records_response;
+	}
+
+	SharedStringResponse MakeSharedBodyResponse(const StringRequest& request,
+		StatusAndResponse&& response, std::string_view content_type) {
+		const auto representation = http_cache::SelectRepresentation(request[http::field::accept_encoding],
+			response.gzip_body != nullptr, response.vary_accept, response.etag);
+		// 304 без тела, но с ETag и Vary выбранного представления
+		const bool not_modified = response.http_status == http::status::not_modified;
+		auto shared_response = MakeSharedStringResponse(response.http_status,
+			not_modified ? nullptr : representation.gzip ? std::move(response.gzip_body) : std::move(response.shared_body),
+			request.version(), request.keep_alive(), request.method(), content_type);
+		if (representation.gzip && !not_modified) {
+			shared_response.set(http::field::content_encoding, content_encoding::Literals::GZIP);
+		}
+		if (!representation.vary.empty()) {
+			shared_response.set(http::field::vary, representation.vary);
+		}
+		if (!representation.etag.empty()) {
+			shared_response.set(http::field::etag, representation.etag);
+		}
+		return shared_response;
+	}
+
 	bool IsApiRequest(std::string_view request_target) {
 		const std::string api_request = "/api/"s;
 		if (request_target.size() >= api_request.size() &&
@@ -145,126 +181,208 @@ namespace http_handler {
 		return false;
 	}
 
-	void RequestHandler::GenerateMapsResponse(StatusAndResponse& response) {
-		// запрос возвращает в теле ответа краткую информацию обо всех картах в виде
-		// JSON-массива объектов с полями id и name
-		array maps_arr;
-		auto maps{ game_.GetMaps() };
+	bool IsRecordsRequest(std::string_view request_target) {
+		return request_target.find(Literals::API_RECORDS) != std::string_view::npos &&
+			request_target.find(Literals::API_RECORDS_RANK) == std::string_view::npos;
+	}
+
+	bool IsStateRequest(std::string_view request_target) {
+		return request_target.find(Literals::API_STATE) != std::string_view::npos;
+	}
+
+	/// @brief сериализация краткой информации обо всех картах: [{"id": ..., "name": ...}]
+	/// @param maps карты
+	/// @return тело ответа
+	std::string SerializeMaps(const model::Game::Maps& maps) {
+		std::string out;
+		json_writer::JsonWriter writer{ out };
+		writer.StartArray();
 		for (const auto& map : maps) {
-			object obj;
-			obj[std::string(model::Literals::ID)] = *map.GetId();
-			obj[std::string(model::Literals::NAME)] = map.GetName();
-			maps_arr.push_back(obj);
+			writer.StartObject();
+			writer.Key(model::Literals::ID);
+			writer.String(*map.GetId());
+			writer.Key(model::Literals::NAME);
+			writer.String(map.GetName());
+			writer.EndObject();
 		}
-		response.http_status = http::status::ok;
-		response.body = serialize(maps_arr);
+		writer.EndArray();
+		return out;
+	}
+
+	/// @brief сильный ETag тела: длина и crc32, одинаковые для одинаковых карт и после перезапуска
+	/// @param body тело ответа
+	/// @return значение заголовка ETag в кавычках
+	std::string MakeStrongEtag(std::string_view body) {
+		boost::crc_32_type crc;
+		crc.process_bytes(body.data(), body.size());
+		std::ostringstream etag;
+		etag << '"' << std::hex << body.size() << '-' << crc.checksum() << '"';
+		return etag.str();
 	}
 
 	/// @brief добавление дорог в ответ на щапрос
 	/// @param map_ptr карта
-	/// @param obj ответ
-	void AddRoadsToResponse(const model::Map* map_ptr, object& obj) {
-		array roads_arr;
-		auto roads{ map_ptr->GetRoads() };
-		for (const auto& road : roads) {
-			object road_obj;
-			road_obj[std::string(model::Literals::X0)] = road.GetStart().x;
-			road_obj[std::string(model::Literals::Y0)] = road.GetStart().y;
+	/// @param writer ответ
+	void AddRoadsToResponse(const model::Map* map_ptr, json_writer::JsonWriter& writer) {
+		writer.Key(model::Literals::ROADS);
+		writer.StartArray();
+		for (const auto& road : map_ptr->GetRoads()) {
+			writer.StartObject();
+			writer.Key(model::Literals::X0);
+			writer.Int(road.GetStart().x);
+			writer.Key(model::Literals::Y0);
+			writer.Int(road.GetStart().y);
 			if (road.IsHorizontal()) {
-				road_obj[std::string(model::Literals::X1)] = road.GetEnd().x;
+				writer.Key(model::Literals::X1);
+				writer.Int(road.GetEnd().x);
 			} else {
-				road_obj[std::string(model::Literals::Y1)] = road.GetEnd().y;
+				writer.Key(model::Literals::Y1);
+				writer.Int(road.GetEnd().y);
 			}
-			roads_arr.push_back(road_obj);
+			writer.EndObject();
 		}
-		obj[std::string(model::Literals::ROADS)] = roads_arr;
+		writer.EndArray();
 	}
 
 	/// @brief добавление зданий в ответ на запрос
 	/// @param map_ptr карта
-	/// @param obj ответ
-	void AddBuildingsToResponse(const model::Map* map_ptr, object& obj) {
-		array buildings_arr;
-		auto buildings{ map_ptr->GetBuildings() };
-		for (const auto& building : buildings) {
-			object builing_obj;
-			builing_obj[std::string(model::Literals::X)] = building.GetBounds().position.x;
-			builing_obj[std::string(model::Literals::Y)] = building.GetBounds().position.y;
-			builing_obj[std::string(model::Literals::W)] = building.GetBounds().size.width;
-			builing_obj[std::string(model::Literals::H)] = building.GetBounds().size.height;
-			buildings_arr.push_back(builing_obj);
+	/// @param writer ответ
+	void AddBuildingsToResponse(const model::Map* map_ptr, json_writer::JsonWriter& writer) {
+		writer.Key(model::Literals::BUILDINGS);
+		writer.StartArray();
+		for (const auto& building : map_ptr->GetBuildings()) {
+			writer.StartObject();
+			writer.Key(model::Literals::X);
+			writer.Int(building.GetBounds().position.x);
+			writer.Key(model::Literals::Y);
+			writer.Int(building.GetBounds().position.y);
+			writer.Key(model::Literals::W);
+			writer.Int(building.GetBounds().size.width);
+			writer.Key(model::Literals::H);
+			writer.Int(building.GetBounds().size.height);
+			writer.EndObject();
 		}
-		obj[std::string(model::Literals::BUILDINGS)] = buildings_arr;
+		writer.EndArray();
 	}
 
 	/// @brief добавление офисов в ответ на запрос
 	/// @param map_ptr карта
-	/// @param obj ответ
-	void AddOfficesToResponse(const model::Map* map_ptr, object& obj) {
-		array offices_arr;
-		auto offices{ map_ptr->GetOffices() };
-		for (const auto& office : offices) {
-			object office_obj;
-			office_obj[std::string(model::Literals::ID)] = *office.GetId();
-			office_obj[std::string(model::Literals::X)] = office.GetPosition().x;
-			office_obj[std::string(model::Literals::Y)] = office.GetPosition().y;
-			office_obj[std::string(model::Literals::OFFSET_X)] = office.GetOffset().dx;
-			office_obj[std::string(model::Literals::OFFSET_Y)] = office.GetOffset().dy;
-			offices_arr.push_back(office_obj);
-		}
-		obj[std::string(model::Literals::OFFICES)] = offices_arr;
+	/// @param writer ответ
+	void AddOfficesToResponse(const model::Map* map_ptr, json_writer::JsonWriter& writer) {
+		writer.Key(model::Literals::OFFICES);
+		writer.StartArray();
+		for (const auto& office : map_ptr->GetOffices()) {
+			writer.StartObject();
+			writer.Key(model::Literals::ID);
+			writer.String(*office.GetId());
+			writer.Key(model::Literals::X);
+			writer.Int(office.GetPosition().x);
+			writer.Key(model::Literals::Y);
+			writer.Int(office.GetPosition().y);
+			writer.Key(model::Literals::OFFSET_X);
+			writer.Int(office.GetOffset().dx);
+			writer.Key(model::Literals::OFFSET_Y);
+			writer.Int(office.GetOffset().dy);
+			writer.EndObject();
+		}
+		writer.EndArray();
 	}
 
 	/// @brief Добавить типы лута в ответ на запрос
 	/// @param map_ptr карта
-	/// @param obj ответ
-	void AddLootTypesToResponse(const model::Map* map_ptr, object& obj) {
-		array loot_types_arr;
-		auto loot_types{ map_ptr->GetLootTypes() };
-		for (const auto& loot_type : loot_types) {
-			object loot_type_obj;
-			loot_type_obj[std::string(model::Literals::NAME)] = std::string(loot_type.name);
-			loot_type_obj[std::string(model::Literals::FILE)] = std::string(loot_type.file);
-			loot_type_obj[std::string(model::Literals::TYPE)] = std::string(loot_type.type);
+	/// @param writer ответ
+	void AddLootTypesToResponse(const model::Map* map_ptr, json_writer::JsonWriter& writer) {
+		writer.Key(model::Literals::LOOT_TYPES);
+		writer.StartArray();
+		for (const auto& loot_type : map_ptr->GetLootTypes()) {
+			writer.StartObject();
+			writer.Key(model::Literals::NAME);
+			writer.String(loot_type.name);
+			writer.Key(model::Literals::FILE);
+			writer.String(loot_type.file);
+			writer.Key(model::Literals::TYPE);
+			writer.String(loot_type.type);
 			if (loot_type.rotation.has_value()) {
-				loot_type_obj[std::string(model::Literals::ROTATION)] = loot_type.rotation.value();
+				writer.Key(model::Literals::ROTATION);
+				writer.Uint(loot_type.rotation.value());
 			}
 			if (loot_type.color.has_value()) {
-				loot_type_obj[std::string(model::Literals::COLOR)] = std::string(loot_type.color.value());
+				writer.Key(model::Literals::COLOR);
+				writer.String(loot_type.color.value());
 			}
-			loot_type_obj[std::string(model::Literals::SCALE)] = loot_type.scale;
-			loot_type_obj[std::string(model::Literals::VALUE)] = loot_type.value;
-			loot_types_arr.push_back(loot_type_obj);
+			writer.Key(model::Literals::SCALE);
+			writer.Double(loot_type.scale);
+			writer.Key(model::Literals::VALUE);
+			writer.Uint(loot_type.value);
+			writer.EndObject();
 		}
-		obj[std::string(model::Literals::LOOT_TYPES)] = loot_types_arr;
+		writer.EndArray();
 	}
 
-	void RequestHandler::GenerateMapResponse(const std::string& map_id_str, StatusAndResponse& response) {
-		model::Map::Id map_id{ map_id_str };
-		// запрос возвращает в теле ответа JSON-описание карты с указанным id,
-		// семантически эквивалентное представлению карты из конфигурационного файла
-		auto map_ptr = game_.FindMap(map_id);
-		if (map_ptr != nullptr) {
-			object obj;
-			obj[std::string(model::Literals::ID)] = *map_ptr->GetId();
-			obj[std::string(model::Literals::NAME)] = map_ptr->GetName();
-			// Дороги
-			AddRoadsToResponse(map_ptr, obj);
-			// Здания
-			AddBuildingsToResponse(map_ptr, obj);
-			// Офисы
-			AddOfficesToResponse(map_ptr, obj);
-			// Типы лута
-			AddLootTypesToResponse(map_ptr, obj);
-			response.http_status = http::status::ok;
-			response.body = serialize(obj);
-		} else {
-			object obj;
-			obj[std::string(model::Literals::CODE)] = "mapNotFound";
-			obj[std::string(model::Literals::MESSAGE)] = "Map not found";
-			response.http_status = http::status::not_found;
-			response.body = serialize(obj);
+	/// @brief сериализация карты, семантически эквивалентная её представлению в конфигурационном файле
+	/// @param map карта
+	/// @return тело ответа
+	std::string SerializeMap(const model::Map& map) {
+		std::string out;
+		json_writer::JsonWriter writer{ out };
+		writer.StartObject();
+		writer.Key(model::Literals::ID);
+		writer.String(*map.GetId());
+		writer.Key(model::Literals::NAME);
+		writer.String(map.GetName());
+		// Дороги
+		AddRoadsToResponse(&map, writer);
+		// Здания
+		AddBuildingsToResponse(&map, writer);
+		// Офисы
+		AddOfficesToResponse(&map, writer);
+		// Типы лута
+		AddLootTypesToResponse(&map, writer);
+		writer.EndObject();
+		return out;
+	}
+
+	void RequestHandler::PrecomputeMapResponses(const content_encoding::Compressor& compressor) {
+		auto precompute = [&compressor](std::string body) {
+			PrecomputedResponse precomputed;
+			precomputed.etag = MakeStrongEtag(body);
+			precomputed.gzip_body = compressor.Compress(body);
+			precomputed.body = std::make_shared<const std::string>(std::move(body));
+			return precomputed;
+		};
+		maps_response_ = precompute(SerializeMaps(game_.GetMaps()));
+		for (const auto& map : game_.GetMaps()) {
+			map_responses_[*map.GetId()] = precompute(SerializeMap(map));
+		}
+	}
+
+	void RequestHandler::GeneratePrecomputedResponse(const StringRequest& request,
+		const PrecomputedResponse& precomputed, StatusAndResponse& response) {
+		response.etag = precomputed.etag;
+		// тела нужны и для 304: по ним выбирается ETag представления
+		response.shared_body = precomputed.body;
+		response.gzip_body = precomputed.gzip_body;
+		response.http_status = http_cache::IsEtagMatched(request[http::field::if_none_match], precomputed.etag)
+			? http::status::not_modified : http::status::ok;
+	}
+
+	void RequestHandler::GenerateMapsResponse(const StringRequest& request, StatusAndResponse& response) {
+		// запрос возвращает в теле ответа краткую информацию обо всех картах в виде
+		// JSON-массива объектов с полями id и name
+		GeneratePrecomputedResponse(request, maps_response_, response);
+	}
+
+	void RequestHandler::GenerateMapResponse(const StringRequest& request, const std::string& map_id_str,
+		StatusAndResponse& response) {
+		// запрос возвращает в теле ответа JSON-описание карты с указанным id
+		if (auto it = map_responses_.find(map_id_str); it != map_responses_.end()) {
+			return GeneratePrecomputedResponse(request, it->second, response);
 		}
+		object obj;
+		obj[std::string(model::Literals::CODE)] = "mapNotFound";
+		obj[std::string(model::Literals::MESSAGE)] = "Map not found";
+		response.http_status = http::status::not_found;
+		response.body = serialize(obj);
 	}
 
 	void RequestHandler::GenerateBadRequestResponse(StatusAndResponse& response) {
@@ -354,7 +472,22 @@ namespace http_handler {
 	void RequestHandler::GenerateStaticFileResponse(
 		std::string_view target, StatusAndFileResponse& response) {
 		std::string request_path_str{ target };
-		request_path_str = DecodeUrl(request_path_str);
+		try {
+			request_path_str = query_params::DecodeUrl(request_path_str);
+		}
+		catch (const std::invalid_argument&) {
+			response.http_status = http::status::bad_request;
+			response.content_type = Literals::TEXT_PLAIN;
+			return;
+		}
+		// файлы из кэша отдаются без обращения к диску
+		const std::string cache_path = request_path_str == "/"s ? "/index.html"s : request_path_str;
+		if (auto asset = static_cache_.Find(cache_path)) {
+			response.http_status = http::status::ok;
+			response.asset = std::move(asset);
+			response.content_type = GetFileContentType(cache_path);
+			return;
+		}
 #ifdef WIN32
 		std::replace(request_path_str.begin(), request_path_str.end(), '/', '\\');
 #endif
@@ -395,6 +528,16 @@ namespace http_handler {
 		}
 	}
 
+	void RequestHandler::GenerateCachedFileResponse(const StringRequest& request,
+		const static_cache::Asset& asset, StatusAndResponse& response) {
+		response.etag = asset.etag;
+		// тела нужны и для 304: по ним выбирается ETag представления
+		response.shared_body = asset.body;
+		response.gzip_body = asset.gzip_body;
+		response.http_status = http_cache::IsEtagMatched(request[http::field::if_none_match], asset.etag)
+			? http::status::not_modified : http::status::ok;
+	}
+
 	/// @brief генерация ответа что-то пошло в не так внутри логики работы сервера
 	/// @param response
 	void GenerateSomethingWrongResponse(StatusAndResponse& response) {
@@ -440,6 +583,8 @@ namespace http_handler {
 			std::string hash{ random_functions::RandomHexString(32) };
 			obj["authToken"] = hash;
 			obj["playerId"] = game_.AddPlayerOnMap(map_ptr, map_name, hash, config_json.at("userName"s).as_string().c_str());
+			// вошедший игрок сразу видит себя, не дожидаясь тика
+			response_cache_.Refresh(map_name);
 
 			response.http_status = http::status::ok;
 			response.body = serialize(obj);
@@ -463,7 +608,26 @@ namespace http_handler {
 		response.body = serialize(obj);
 	}
 
+	/// @brief генерация ответа на запрос рекордов, пока БД не готова
+	/// @param response
+	void GenerateDatabaseUnavailableResponse(StatusAndResponse& response) {
+		object obj;
+		response.http_status = http::status::service_unavailable;
+		obj[std::string(model::Literals::CODE)] = "databaseUnavailable";
+		obj[std::string(model::Literals::MESSAGE)] = "Database is not ready yet";
+		response.body = serialize(obj);
+	}
 
+	/// @brief генерация ответа на запрос с неверным параметром
+	/// @param response
+	/// @param message текст ошибки
+	void GenerateInvalidArgumentResponse(StatusAndResponse& response, std::string_view message) {
+		object obj;
+		response.http_status = http::status::bad_request;
+		obj[std::string(model::Literals::CODE)] = "invalidArgument";
+		obj[std::string(model::Literals::MESSAGE)] = message;
+		response.body = serialize(obj);
+	}
 
 	/// @brief проверка соответствия токена требованиям
 	/// @param request
@@ -522,53 +686,8 @@ namespace http_handler {
 		return false;
 	}
 
-	object GetPlayersData(const std::string& map_name, model::Game& game) {
-		std::deque<model::Player> players_on_map;
-		game.GetPlayersOnMap(players_on_map, map_name);
-		object players;
-		for (const auto& player : players_on_map) {
-			array pos;
-			pos.push_back(player.pos_.x);
-			pos.push_back(player.pos_.y);
-			array speed;
-			speed.push_back(player.speed_.x);
-			speed.push_back(player.speed_.y);
-			array bag;
-			object loot;
-			for (const auto loot_with_id : player.bag_) {
-				loot["id"] = loot_with_id.id;
-				loot["type"] = loot_with_id.type;
-				bag.push_back(loot);
-			}
-			players[std::to_string(player.id_)] = {
-			{"pos", pos},
-			{"speed", speed},
-			{"dir", model::DirectionToString(player.direction_)} ,
-			{"bag" , bag },
-			{"score" , player.score_ } };
-		}
-		return players;
-	}
-
-	object GetLootData(const std::string& map_name, model::Game& game) {
-		std::deque<model::Loot> loot_on_map;
-		game.GetLootOnMap(loot_on_map, map_name);
-		object all_loot;
-		unsigned int id{ 0 };
-		for (const auto& loot : loot_on_map) {
-			array pos;
-			pos.push_back(loot.coord.x);
-			pos.push_back(loot.coord.y);
-			all_loot[std::to_string(id)] = {
-				{"type", loot.type},
-				{"pos", pos} };
-			++id;
-		}
-		return all_loot;
-	}
-
 	void RequestHandler::GenerateStateResponse(const StringRequest& request,
-		StatusAndResponse& response) {
+		StatusAndResponse& response, bool allow_wait) {
 		if (request.method() != http::verb::head &&
 			request.method() != http::verb::get) {
 			return GenerateInvalidMethodResponse(response);
@@ -579,14 +698,56 @@ namespace http_handler {
 			return;
 		}
 
-		object obj;
 		std::string map_name;
-		if (!IsTokenUnknown(token, response, map_name)) {
-			obj["players"] = GetPlayersData(map_name, game_);
-			obj["lostObjects"] = GetLootData(map_name, game_);
+		if (IsTokenUnknown(token, response, map_name)) {
+			return;
+		}
+
+		const auto query = query_params::ParseQueryParams(request.target());
+		if (!query) {
+			return GenerateInvalidArgumentResponse(response, "Invalid query string"sv);
+		}
+		const auto& params = *query;
+		// ?since=<версия> - только изменения после версии из предыдущего ответа
+		std::optional<uint64_t> since_version;
+		if (auto since = params.find("since"s); since != params.end()) {
+			uint64_t version{ 0 };
+			const auto& str = since->second;
+			auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), version);
+			if (ec != std::errc{} || ptr != str.data() + str.size()) {
+				return GenerateBadRequestResponse(response);
+			}
+			since_version = version;
+		}
+
+		// ?wait=1 - ответ после следующего тика, а не сразу
+		if (auto wait = params.find("wait"s); wait != params.end()) {
+			if (wait->second != "0"sv && wait->second != "1"sv) {
+				return GenerateBadRequestResponse(response);
+			}
+			if (allow_wait && wait->second == "1"sv) {
+				response.wait_map_name = std::move(map_name);
+				return;
+			}
+		}
+
+		if (since_version) {
 			response.http_status = http::status::ok;
-			response.body = serialize(obj);
+			response.body = response_cache_.GetDelta(map_name, *since_version);
+			return;
+		}
+
+		response.http_status = http::status::ok;
+		response.vary_accept = true;
+		// компактный двоичный формат вместо JSON, если клиент его принимает
+		if (request[http::field::accept].find(state_encoding::Literals::CONTENT_TYPE) != std::string_view::npos) {
+			response.content_type = state_encoding::Literals::CONTENT_TYPE;
+			response.shared_body = response_cache_.Get(map_name).binary_state;
+			return;
 		}
+		const auto responses = response_cache_.Get(map_name);
+		response.shared_body = responses.state;
+		response.gzip_body = responses.state_gzip;
 	}
 
 	void RequestHandler::GeneratePlayersResponse(const StringRequest& request,
@@ -602,18 +763,55 @@ namespace http_handler {
 			return;
 		}
 
-		object obj;
 		std::string map_name;
 		if (!IsTokenUnknown(token, response, map_name)) {
-			std::deque<model::Player> players_on_map;
-			game_.GetPlayersOnMap(players_on_map, map_name);
-			for (const auto& player : players_on_map) {
-				obj[std::to_string(player.id_)] = {
-					"name", player.name_ };  // player.GetPlayerId(), player.GetName()
-			}
 			response.http_status = http::status::ok;
-			response.body = serialize(obj);
+			const auto responses = response_cache_.Get(map_name);
+			response.shared_body = responses.players;
+			response.gzip_body = responses.players_gzip;
+		}
+	}
+
+	bool RequestHandler::GenerateSocketResponse(const StringRequest& request,
+		StatusAndResponse& response, std::string& token, std::string& map_name) {
+		std::string_view target = request.target();
+		if (target.substr(0, target.find('?')) != Literals::API_SOCKET) {
+			GenerateBadRequestResponse(response);
+			return false;
+		}
+		if (request.method() != http::verb::get) {
+			GenerateInvalidMethodResponse(response);
+			return false;
+		}
+
+		// браузер не может выставить заголовок Authorization для WebSocket,
+		// поэтому токен можно передать параметром запроса
+		const auto query = query_params::ParseQueryParams(target);
+		if (!query) {
+			GenerateInvalidArgumentResponse(response, "Invalid query string"sv);
+			return false;
+		}
+		const auto& params = *query;
+		if (auto token_param = params.find("token"s); token_param != params.end()) {
+			token = token_param->second;
+		} else if (IsTokenInvalid(request, response, "required", token)) {
+			return false;
 		}
+		return !IsTokenUnknown(token, response, map_name);
+	}
+
+	void RequestHandler::HandleSocketRequest(StringRequest&& request, beast::tcp_stream&& stream) {
+		auto request_time = std::chrono::system_clock::now();
+		StatusAndResponse response;
+		std::string token;
+		std::string map_name;
+		if (!GenerateSocketResponse(request, response, token, map_name)) {
+			LogResponse(ip_, request_time, response.http_status, ContentType::API_JSON);
+			return game_socket::Reject(std::move(stream), MakeStringResponse(response.http_status,
+				response.body, request.version(), false, request.method(), ContentType::API_JSON));
+		}
+		LogResponse(ip_, request_time, http::status::switching_protocols, ContentType::API_JSON);
+		socket_hub_.Accept(std::move(stream), std::move(request), std::move(token), std::move(map_name));
 	}
 
 	void RequestHandler::GenerateTickResponse(const StringRequest& request,
@@ -649,6 +847,8 @@ namespace http_handler {
 
 		std::chrono::milliseconds period_ms{ time_tick_json.at("timeDelta"s).as_int64() };
 		game_.SpendTime(period_ms);
+		response_cache_.Refresh();
+		socket_hub_.Publish();
 
 		obj.clear();
 		response.http_status = http::status::ok;
@@ -711,62 +911,154 @@ namespace http_handler {
 		response.body = serialize(obj);
 	}
 
-	std::string RequestHandler::GetRecordsFromDB(int start, int max_items) {
-		StringResponse ret;
-		std::vector<postgres::RetiredPlayer > left_players;
-		auto connect_db = connection_pool_.GetConnection();
-		postgres::ReadRetiredFromDatabase(*connect_db, start, max_items, left_players);
-		if (left_players.size() > 0)
-		{
-			array records;
-			for (auto iter = left_players.begin(); iter != left_players.end(); iter++) {
-				object obj;
-				obj["name"] = iter->name;
-				obj["score"] = iter->score;
-				obj["playTime"] = iter->play_time_s;
-				records.push_back(obj);
-			}
-			return serialize(records);
+	void RequestHandler::GenerateRecordsPage(const StringRequest& request, int start, int max_items,
+		StatusAndResponse& response) {
+		auto page = leaderboard_.GetPage(start, max_items);
+		if (page == nullptr) {
+			response.http_status = http::status::ok;
+			response.db_body = [start, max_items](retired_repository::RetiredPlayersRepository& repository) {
+				std::vector<retired_repository::RetiredPlayer> left_players;
+				repository.ReadPage(start, max_items, left_players);
+				return leaderboard::SerializeRecords(left_players);
+			};
+			return;
 		}
-		return R"([])"s;
+
+		response.etag = page->etag;
+		// тело остаётся в странице, указатель продлевает её жизнь; для 304 по телам выбирается ETag
+		response.shared_body = std::shared_ptr<const std::string>(page, &page->body);
+		response.gzip_body = page->gzip_body;
+		response.http_status = http_cache::IsEtagMatched(request[http::field::if_none_match], page->etag)
+			? http::status::not_modified : http::status::ok;
+	}
+
+	void RequestHandler::GenerateRecordsCursorPage(std::string_view encoded_cursor, int max_items,
+		StatusAndResponse& response) {
+		// пустой курсор - первая страница: ключ выше любой записи в таблице
+		retired_repository::RecordsCursor cursor{ std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), ""s, 0 };
+		if (!encoded_cursor.empty() && !leaderboard::DecodeCursor(encoded_cursor, cursor)) {
+			return GenerateBadRequestResponse(response);
+		}
+
+		response.http_status = http::status::ok;
+		std::vector<retired_repository::RetiredPlayer> records;
+		if (!leaderboard_.GetPageAfter(cursor, max_items, records)) {
+			response.db_body = [cursor, max_items](retired_repository::RetiredPlayersRepository& repository) {
+				std::vector<retired_repository::RetiredPlayer> db_records;
+				repository.ReadAfter(cursor, max_items, db_records);
+				return leaderboard::SerializeCursorPage(cursor, max_items, db_records);
+			};
+			return;
+		}
+		response.body = leaderboard::SerializeCursorPage(cursor, max_items, records);
 	}
 
 	void RequestHandler::GenerateRecordsResponse(const StringRequest& request,
 		StatusAndResponse& response) {
-		if (request.target().size() > Literals::API_RECORDS.size() && request.target()[Literals::API_RECORDS.size()] == '?') {
-			std::string str_params(request.target().substr(Literals::API_RECORDS.size() + 1, request.target().size()));
-			int delim_pos = 0;
+		// Если maxItems превышает 100, должна вернуться ошибка с кодом 400 Bad Request.
+		constexpr int MAX_RECORDS_ITEMS{ 100 };
+		const auto query = query_params::ParseQueryParams(request.target());
+		if (!query) {
+			return GenerateInvalidArgumentResponse(response, "Invalid query string"sv);
+		}
+		const auto& params = *query;
 
-			auto start_begin = str_params.find('=');
-			++start_begin;
+		int start{ 0 };
+		if (auto it = params.find("start"s); it != params.end() && !query_params::ParseNonNegativeInt(it->second, start)) {
+			return GenerateBadRequestResponse(response);
+		}
 
-			auto start_end = str_params.find('&');
-			auto digits_count = start_end - start_begin;
-			auto start = str_params.substr(start_begin, digits_count);
+		int max_items{ MAX_RECORDS_ITEMS };
+		if (auto it = params.find("maxItems"s); it != params.end() && !query_params::ParseNonNegativeInt(it->second, max_items)) {
+			return GenerateBadRequestResponse(response);
+		}
+		if (max_items > MAX_RECORDS_ITEMS) {
+			return GenerateBadRequestResponse(response);
+		}
+		if (!database_ready_) {
+			return GenerateDatabaseUnavailableResponse(response);
+		}
 
-			str_params = str_params.substr(start_begin + digits_count);
-			auto max_item_begin = str_params.find('=');
-			++max_item_begin;
-			auto max_item = str_params.substr(max_item_begin);
+		// постраничное чтение по курсору: ?cursor=&maxItems=N, далее ?cursor=<next>
+		if (auto it = params.find("cursor"s); it != params.end()) {
+			return GenerateRecordsCursorPage(it->second, max_items, response);
+		}
+		GenerateRecordsPage(request, start, max_items, response);
+	}
 
-			int start_digit = std::stoi(start);
-			int max_item_digit = std::stoi(max_item);
-			if (max_item_digit > 100) {
-				return GenerateBadRequestResponse(response);
-			} else {
-				response.http_status = http::status::ok;
-				response.body = GetRecordsFromDB(start_digit, max_item_digit);
-			}
-		} else {
-			response.http_status = http::status::ok;
-			response.body = GetRecordsFromDB(0, 100);
+	void RequestHandler::GenerateRecordsRankResponse(const StringRequest& request,
+		StatusAndResponse& response) {
+		if (request.method() != http::verb::head &&
+			request.method() != http::verb::get) {
+			return GenerateInvalidMethodResponse(response);
+		}
+
+		// по-умолчанию и максимально отдаём столько соседей сверху и снизу
+		constexpr int DEFAULT_NEIGHBOURS{ 5 };
+		constexpr int MAX_NEIGHBOURS{ 50 };
+		const auto query = query_params::ParseQueryParams(request.target());
+		if (!query) {
+			return GenerateInvalidArgumentResponse(response, "Invalid query string"sv);
+		}
+		const auto& params = *query;
+
+		auto name = params.find("name"s);
+		if (name == params.end() || name->second.empty()) {
+			return GenerateBadRequestResponse(response);
+		}
+
+		int neighbours{ DEFAULT_NEIGHBOURS };
+		if (auto it = params.find("neighbours"s); it != params.end() && !query_params::ParseNonNegativeInt(it->second, neighbours)) {
+			return GenerateBadRequestResponse(response);
+		}
+		if (neighbours > MAX_NEIGHBOURS) {
+			return GenerateBadRequestResponse(response);
 		}
+		if (!database_ready_) {
+			return GenerateDatabaseUnavailableResponse(response);
+		}
+
+		object obj;
+		leaderboard::PlayerRank player_rank;
+		if (!leaderboard_.GetPlayerRank(name->second, static_cast<size_t>(neighbours), player_rank)) {
+			response.http_status = http::status::not_found;
+			obj[std::string(model::Literals::CODE)] = "playerNotFound";
+			obj[std::string(model::Literals::MESSAGE)] = "Retired player not found";
+			response.body = serialize(obj);
+			return;
+		}
+
+		json_writer::JsonWriter writer{ response.body };
+		writer.StartObject();
+		writer.Key("name"sv);
+		writer.String(name->second);
+		writer.Key("rank"sv);
+		writer.Uint(player_rank.rank);
+		writer.Key("total"sv);
+		writer.Uint(player_rank.total);
+		writer.Key("around"sv);
+		writer.StartArray();
+		for (const auto& record : player_rank.around) {
+			writer.StartObject();
+			writer.Key("rank"sv);
+			writer.Uint(record.rank);
+			writer.Key("name"sv);
+			writer.String(record.player.name);
+			writer.Key("score"sv);
+			writer.Int(record.player.score);
+			writer.Key("playTime"sv);
+			writer.Int(record.player.play_time_s);
+			writer.EndObject();
+		}
+		writer.EndArray();
+		writer.EndObject();
+		response.http_status = http::status::ok;
 	}
 
 	void RequestHandler::GenerateResponse(const StringRequest& request,
 		StatusAndResponse& response) {
 		if (request.target() == Literals::API_MAPS) {
-			return GenerateMapsResponse(response);
+			return GenerateMapsResponse(request, response);
 		} else if (request.target().find(Literals::API_MAP) != std::string::npos) {
 			// TODO Убрать в метод
 			object obj;
@@ -777,7 +1069,7 @@ namespace http_handler {
 				response.body = serialize(obj);
 				return;
 			}
-			return GenerateMapResponse(std::string(request.target().substr(13)), response);
+			return GenerateMapResponse(request, std::string(request.target().substr(13)), response);
 		} else {
 			if (request.target().find(Literals::API) != std::string::npos) {
 				GenerateBadRequestResponse(response);
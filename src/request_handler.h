@@ -4,13 +4,23 @@
 #include <boost/asio/io_context.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/json.hpp>
+#include <atomic>
 #include <filesystem>
+#include <functional>
 #include <iostream>
+#include <unordered_map>
 #include <variant>
 
+#include "content_encoding.h"
+#include "game_socket.h"
 #include "http_server.h"
+#include "shared_body.h"
+#include "leaderboard.h"
 #include "model.h"
-#include "postgres.h"
+#include "response_cache.h"
+#include "retired_repository.h"
+#include "state_encoding.h"
+#include "static_cache.h"
 
 namespace http_handler {
 	using namespace boost::posix_time;
@@ -26,6 +36,8 @@ namespace http_handler {
 
 	// Ответ, тело которого представлено в виде строки
 	using StringResponse = http::response<http::string_body>;
+	// Ответ, тело которого - разделяемая строка из кэша ответов
+	using SharedStringResponse = http::response<http_server::SharedStringBody>;
 	// Ответ, тело которого представлено в виде файла
 	using FileResponse = http::response<http::file_body>;
 	// Ответ, тело которого отсутствует
@@ -45,6 +57,8 @@ namespace http_handler {
 		constexpr static std::string_view API_ACTION = "/api/v1/game/player/action"sv;
 		constexpr static std::string_view API_TICK = "/api/v1/game/tick"sv;
 		constexpr static std::string_view API_RECORDS = "/api/v1/game/records"sv;
+		constexpr static std::string_view API_RECORDS_RANK = "/api/v1/game/records/rank"sv;
+		constexpr static std::string_view API_SOCKET = "/api/v1/game/socket"sv;
 	};
 
 	// Структура ContentType задаёт область видимости для констант,
@@ -132,6 +146,19 @@ namespace http_handler {
 		bool keep_alive, http::verb method,
 		std::string_view content_type = ContentType::API_JSON);
 
+	/// @brief Создаёт ответ, тело которого не копируется, а разделяется с кэшем ответов
+	/// @param status
+	/// @param body тело ответа
+	/// @param http_version
+	/// @param keep_alive
+	/// @param method
+	/// @param content_type
+	/// @return
+	SharedStringResponse MakeSharedStringResponse(
+		http::status status, std::shared_ptr<const std::string> body, unsigned http_version,
+		bool keep_alive, http::verb method,
+		std::string_view content_type = ContentType::API_JSON);
+
 	// Создаёт FileResponse с заданными параметрами
 	FileResponse MakeStaticFileResponse(http::status status,
 		http::file_body::value_type&& file,
@@ -143,6 +170,20 @@ namespace http_handler {
 	struct StatusAndResponse {
 		http::status http_status;
 		std::string body;
+		// если задано, ответ отправляется с этим телом без копирования вместо body
+		std::shared_ptr<const std::string> shared_body;
+		// сжатая gzip версия shared_body для клиентов с Accept-Encoding: gzip
+		std::shared_ptr<const std::string> gzip_body;
+		// значение заголовка ETag, пустое - заголовок не выставляется
+		std::string etag;
+		// если задано, тело ответа читается из хранилища вне потоков io_context
+		std::function<std::string(retired_repository::RetiredPlayersRepository&)> db_body;
+		// если не пусто, ответ собирается после следующего тика на этой карте
+		std::string wait_map_name;
+		// тип содержимого тела ответа
+		std::string_view content_type{ ContentType::API_JSON };
+		// тело выбрано по заголовку Accept, кэши должны это учитывать
+		bool vary_accept{ false };
 	};
 
 	// полный ответ с файлом от сервера
@@ -150,28 +191,91 @@ namespace http_handler {
 		http::status http_status;
 		http::file_body::value_type file;
 		std::string content_type;
+		// если задан, файл отдаётся из памяти, а file не открывается
+		std::shared_ptr<const static_cache::Asset> asset;
 	};
 
+	/// @brief Создаёт ответ на запрос рекордов с заголовком ETag
+	/// @param response статус, тело и ETag ответа
+	/// @param http_version
+	/// @param keep_alive
+	/// @param method
+	/// @return
+	StringResponse MakeRecordsResponse(const StatusAndResponse& response, unsigned http_version,
+		bool keep_alive, http::verb method);
+
+	/// @brief Создаёт ответ с разделяемым телом shared_body и заголовком ETag. Клиенту,
+	/// принимающему gzip, отдаётся сжатая версия с собственным ETag. Ответ 304 отправляется
+	/// без тела, с ETag и Vary того представления, которое получил бы клиент
+	/// @param request запрос
+	/// @param response статус, тела и ETag ответа
+	/// @param content_type
+	/// @return
+	SharedStringResponse MakeSharedBodyResponse(const StringRequest& request,
+		StatusAndResponse&& response, std::string_view content_type);
+
 	/// @brief Запрос содержит api?
 	/// @param request_target
 	/// @return
 	bool IsApiRequest(std::string_view request_target);
 
+	/// @brief Запрос к таблице рекордов, тело которого может читаться из БД?
+	/// @param request_target
+	/// @return
+	bool IsRecordsRequest(std::string_view request_target);
+
+	/// @brief Запрос состояния игры, ответ на который может ждать тика?
+	/// @param request_target
+	/// @return
+	bool IsStateRequest(std::string_view request_target);
+
 	class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
 	private:
+		// Ответ, собранный заранее, и его ETag
+		struct PrecomputedResponse {
+			std::shared_ptr<const std::string> body;
+			// nullptr - тело отдаётся без сжатия
+			std::shared_ptr<const std::string> gzip_body;
+			std::string etag;
+		};
+
 		model::Game& game_;
-		postgres::ConnectionPool& connection_pool_;
+		retired_repository::RetiredPlayersRepository& repository_;
+		leaderboard::Leaderboard& leaderboard_;
+		response_cache::ResponseCache& response_cache_;
+		game_socket::Hub& socket_hub_;
+		const static_cache::StaticCache& static_cache_;
 		fs::path root_;
 		Strand api_strand_;
 		std::string ip_{};
+		// ответы на /api/v1/maps и /api/v1/maps/<id>: карты не меняются после загрузки игры
+		PrecomputedResponse maps_response_;
+		std::unordered_map<std::string, PrecomputedResponse> map_responses_;
+		// таблица выбывших игроков создана и таблица рекордов загружена; до этого
+		// запросы рекордов получают 503, остальное API работает
+		std::atomic<bool> database_ready_{ false };
 
 	public:
-		explicit RequestHandler(model::Game& game, postgres::ConnectionPool& connection_pool, fs::path root, Strand api_strand)
-			: game_{ game }, connection_pool_(connection_pool), root_{ std::move(root) }, api_strand_{ api_strand } {}
+		explicit RequestHandler(model::Game& game, retired_repository::RetiredPlayersRepository& repository,
+			leaderboard::Leaderboard& leaderboard, response_cache::ResponseCache& response_cache,
+			game_socket::Hub& socket_hub, const content_encoding::Compressor& compressor,
+			const static_cache::StaticCache& static_cache, fs::path root, Strand api_strand)
+			: game_{ game }, repository_(repository), leaderboard_(leaderboard),
+			response_cache_(response_cache), socket_hub_(socket_hub), static_cache_(static_cache),
+			root_{ std::move(root) },
+			api_strand_{ api_strand } {
+			PrecomputeMapResponses(compressor);
+		}
 
 		RequestHandler(const RequestHandler&) = delete;
 		RequestHandler& operator=(const RequestHandler&) = delete;
 
+		/// @brief БД готова: запросы рекордов обслуживаются из таблицы рекордов и БД.
+		/// Вызывается из потока подготовки БД
+		void SetDatabaseReady() {
+			database_ready_ = true;
+		}
+
 		template <typename Body, typename Allocator, typename Send>
 		void operator()(http::request<Body, http::basic_fields<Allocator>>&& req,
 			std::string ip, Send&& send) {
@@ -189,7 +293,17 @@ namespace http_handler {
 						// Этот assert не выстрелит, так как лямбда-функция будет
 						// выполняться внутри strand
 						assert(self->api_strand_.running_in_this_thread());
-						return send(self->HandleApiRequest(req));
+						if (IsRecordsRequest(req.target())) {
+							return self->HandleRecordsRequest(req, send);
+						}
+						if (IsStateRequest(req.target())) {
+							return self->HandleStateRequest(req, send);
+						}
+						return std::visit(
+							[&send](auto&& result) {
+								send(std::forward<decltype(result)>(result));
+							},
+							self->HandleApiRequest(req));
 					  }
 			 catch (...) {
 			send(self->ReportServerError(version, keep_alive));
@@ -209,6 +323,20 @@ namespace http_handler {
 			}
 		}
 
+		/// @brief Обработка запроса на переход к WebSocket; соединение передаётся игре
+		/// или закрывается с ответом об ошибке
+		/// @param req запрос на переход к WebSocket
+		/// @param ip адрес клиента
+		/// @param stream соединение клиента
+		void operator()(StringRequest&& req, std::string ip, beast::tcp_stream&& stream) {
+			ip_ = std::move(ip);
+			LogRequest(req, ip_);
+			net::dispatch(api_strand_, [self = shared_from_this(), req = std::move(req),
+				stream = std::move(stream)]() mutable {
+					self->HandleSocketRequest(std::move(req), std::move(stream));
+				});
+		}
+
 	private:
 		/// @brief Логгирование ответа сервера
 		/// @param ip
@@ -247,14 +375,27 @@ namespace http_handler {
 			LOG(serialize(obj));
 		}
 
+		/// @brief сборка ответов на запросы карт, вызывается один раз после загрузки игры
+		/// @param compressor сжатие собранных тел
+		void PrecomputeMapResponses(const content_encoding::Compressor& compressor);
+
+		/// @brief ответ заранее собранным телом; 304, если клиент прислал его ETag в If-None-Match
+		/// @param request запрос
+		/// @param precomputed собранный ответ
+		/// @param response ответ
+		void GeneratePrecomputedResponse(const StringRequest& request,
+			const PrecomputedResponse& precomputed, StatusAndResponse& response);
+
 		/// @brief генерация ответа на запрос краткой онформации обо всех всех картах
+		/// @param request запрос
 		/// @param response ответ
-		void GenerateMapsResponse(StatusAndResponse& response);
+		void GenerateMapsResponse(const StringRequest& request, StatusAndResponse& response);
 
 		/// @brief генерация ответа на запрос конкретной карты
+		/// @param request запрос
 		/// @param map_id_str id карты
 		/// @param response ответ
-		void GenerateMapResponse(const std::string& map_id_str,
+		void GenerateMapResponse(const StringRequest& request, const std::string& map_id_str,
 			StatusAndResponse& response);
 
 		/// @brief генерация ответа на плохой запрос
@@ -286,9 +427,10 @@ namespace http_handler {
 
 		/// @brief генерация ответа на запрос состояния игры на карте
 		/// @param request
-		/// @return
+		/// @param response
+		/// @param allow_wait false - ?wait=1 не откладывает ответ, запрос уже дождался тика
 		void GenerateStateResponse(const StringRequest& request,
-			StatusAndResponse& response);
+			StatusAndResponse& response, bool allow_wait = true);
 
 		/// @brief генерация ответа на запрос пермещения игрока
 		/// @param request
@@ -296,6 +438,20 @@ namespace http_handler {
 		void GenerateActionResponse(const StringRequest& request,
 			StatusAndResponse& response);
 
+		/// @brief проверка запроса на переход к WebSocket /api/v1/game/socket
+		/// @param request запрос; токен передаётся в заголовке Authorization или в параметре ?token=
+		/// @param response ответ об ошибке
+		/// @param token токен игрока
+		/// @param map_name карта игрока
+		/// @return true - соединение можно принять
+		bool GenerateSocketResponse(const StringRequest& request, StatusAndResponse& response,
+			std::string& token, std::string& map_name);
+
+		/// @brief принять WebSocket-соединение игрока либо ответить ошибкой, выполняется в api_strand_
+		/// @param request запрос на переход к WebSocket
+		/// @param stream соединение клиента
+		void HandleSocketRequest(StringRequest&& request, beast::tcp_stream&& stream);
+
 		/// @brief генерация ответа на изменение времени
 		/// @param request
 		/// @return
@@ -308,19 +464,47 @@ namespace http_handler {
 		void GenerateRecordsResponse(const StringRequest& request,
 			StatusAndResponse& response);
 
-		/// @brief Запрос к БД
-		/// @param start целое число, задающее номер начального элемента (0 — начальный элемент).
-		/// @param max_items целое число, задающее максимальное количество элементов. Если maxItems превышает 100, должна вернуться ошибка с кодом 400 Bad Request.
-		/// @return body от ответа на запрос
-		std::string GetRecordsFromDB(int start, int max_items);
+		/// @brief генерация ответа на запрос места игрока в таблице рекордов
+		/// @param request /api/v1/game/records/rank?name=<имя>&neighbours=<число>
+		/// @param response ответ
+		void GenerateRecordsRankResponse(const StringRequest& request,
+			StatusAndResponse& response);
+
+		/// @brief ответ на запрос рекордов: из таблицы в памяти, либо из БД для глубоких страниц
+		/// @param request запрос
+		/// @param start целое число, задающее номер начального элемента
+		/// @param max_items целое число, задающее максимальное количество элементов
+		/// @param response ответ
+		void GenerateRecordsPage(const StringRequest& request, int start, int max_items,
+			StatusAndResponse& response);
+
+		/// @brief ответ на запрос рекордов по курсору: {"records": [...], "next": курсор | null}
+		/// @param encoded_cursor курсор из предыдущего ответа, пустой - первая страница
+		/// @param max_items целое число, задающее максимальное количество элементов
+		/// @param response ответ
+		void GenerateRecordsCursorPage(std::string_view encoded_cursor, int max_items,
+			StatusAndResponse& response);
+
+		/// @brief генерация ответа с файлом из кэша статических файлов
+		/// @param request запрос
+		/// @param asset файл
+		/// @param response ответ; 304, если у клиента актуальная версия
+		void GenerateCachedFileResponse(const StringRequest& request, const static_cache::Asset& asset,
+			StatusAndResponse& response);
 
 		using FileRequestResult =
-			std::variant<EmptyResponse, StringResponse, FileResponse>;
+			std::variant<EmptyResponse, StringResponse, FileResponse, SharedStringResponse>;
 
 		FileRequestResult HandleFileRequest(const StringRequest& request) {
 			auto request_time = std::chrono::system_clock::now();
 			StatusAndFileResponse response;
 			GenerateStaticFileResponse(request.target(), response);
+			if (response.asset) {
+				StatusAndResponse cached;
+				GenerateCachedFileResponse(request, *response.asset, cached);
+				LogResponse(ip_, request_time, cached.http_status, response.content_type);
+				return MakeSharedBodyResponse(request, std::move(cached), response.content_type);
+			}
 			if (response.http_status == http::status::ok) {
 				LogResponse(ip_, request_time, response.http_status,
 					response.content_type);
@@ -335,7 +519,9 @@ namespace http_handler {
 
 		}
 
-		StringResponse HandleApiRequest(const StringRequest& request) {
+		using ApiRequestResult = std::variant<StringResponse, SharedStringResponse>;
+
+		ApiRequestResult HandleApiRequest(const StringRequest& request) {
 			// if (request.method() != http::verb::get && request.method() !=
 			// http::verb::head) {
 			//}
@@ -354,17 +540,12 @@ namespace http_handler {
 				GeneratePlayersResponse(request, response);
 				LogResponse(ip_, request_time, response.http_status,
 					ContentType::API_JSON);
+				if (response.shared_body) {
+					return MakeSharedBodyResponse(request, std::move(response), ContentType::API_JSON);
+				}
 				return MakePlayersStringResponse(response.http_status, response.body,
 					request.version(), request.keep_alive(),
 					request.method(), ContentType::API_JSON);
-			} else if (request.target().find(Literals::API_STATE) !=
-				std::string::npos) {
-				GenerateStateResponse(request, response);
-				LogResponse(ip_, request_time, response.http_status,
-					ContentType::API_JSON);
-				return MakeStateStringResponse(response.http_status, response.body,
-					request.version(), request.keep_alive(),
-					request.method(), ContentType::API_JSON);
 			} else if (request.target().find(Literals::API_ACTION) !=
 				std::string::npos) {
 				GenerateActionResponse(request, response);
@@ -380,8 +561,8 @@ namespace http_handler {
 				return MakeTickStringResponse(response.http_status, response.body,
 					request.version(), request.keep_alive(),
 					request.method(), ContentType::API_JSON);
-			} else if (request.target().find(Literals::API_RECORDS) != std::string::npos) {
-				GenerateRecordsResponse(request, response);
+			} else if (request.target().find(Literals::API_RECORDS_RANK) != std::string::npos) {
+				GenerateRecordsRankResponse(request, response);
 				LogResponse(ip_, request_time, response.http_status,
 					ContentType::API_JSON);
 				return MakeStringResponse(response.http_status, response.body,
@@ -391,10 +572,96 @@ namespace http_handler {
 				GenerateResponse(request, response);
 				LogResponse(ip_, request_time, response.http_status,
 					ContentType::API_JSON);
-				return MakeStringResponse(response.http_status, response.body,
+				if (response.shared_body) {
+					return MakeSharedBodyResponse(request, std::move(response), ContentType::API_JSON);
+				}
+				auto string_response = MakeStringResponse(response.http_status, response.body,
 					request.version(), request.keep_alive(),
 					request.method(), ContentType::API_JSON);
+				if (!response.etag.empty()) {
+					string_response.set(http::field::etag, response.etag);
+				}
+				return string_response;
+			}
+		}
+
+		/// @brief Обработка запроса к таблице рекордов. Если страницы нет в памяти,
+		/// чтение из хранилища выполняется вне потоков io_context, а ответ отправляется из api_strand_
+		/// @tparam Send
+		/// @param request запрос
+		/// @param send отправка ответа
+		template <typename Send>
+		void HandleRecordsRequest(const StringRequest& request, Send&& send) {
+			auto request_time = std::chrono::system_clock::now();
+			StatusAndResponse response;
+			GenerateRecordsResponse(request, response);
+			if (!response.db_body) {
+				LogResponse(ip_, request_time, response.http_status,
+					ContentType::API_JSON);
+				if (response.shared_body) {
+					return send(MakeSharedBodyResponse(request, std::move(response), ContentType::API_JSON));
+				}
+				return send(MakeRecordsResponse(response, request.version(),
+					request.keep_alive(), request.method()));
+			}
+
+			auto version = request.version();
+			auto keep_alive = request.keep_alive();
+			auto method = request.method();
+			auto db_body = std::move(response.db_body);
+			repository_.AsyncExecute(std::move(db_body), net::bind_executor(api_strand_,
+				[self = shared_from_this(), send, response = std::move(response), request_time,
+				version, keep_alive, method](std::exception_ptr error, std::string body) mutable {
+					if (error) {
+						return send(self->ReportServerError(version, keep_alive));
+					}
+					response.body = std::move(body);
+					self->LogResponse(self->ip_, request_time, response.http_status,
+						ContentType::API_JSON);
+					send(MakeRecordsResponse(response, version, keep_alive, method));
+				}));
+		}
+
+		/// @brief Обработка запроса состояния игры. С ?wait=1 ответ отправляется
+		/// после следующего тика на карте игрока либо по таймауту ожидания
+		/// @tparam Send
+		/// @param request запрос
+		/// @param send отправка ответа
+		template <typename Send>
+		void HandleStateRequest(const StringRequest& request, Send&& send) {
+			auto request_time = std::chrono::system_clock::now();
+			StatusAndResponse response;
+			GenerateStateResponse(request, response);
+			if (response.wait_map_name.empty()) {
+				return SendStateResponse(request, request_time, std::move(response), send);
+			}
+
+			socket_hub_.Wait(response.wait_map_name,
+				[self = shared_from_this(), send, request, request_time]() mutable {
+					try {
+						StatusAndResponse response;
+						self->GenerateStateResponse(request, response, false);
+						self->SendStateResponse(request, request_time, std::move(response), send);
+					}
+					catch (...) {
+						send(self->ReportServerError(request.version(), request.keep_alive()));
+					}
+				});
+		}
+
+		template <typename Send>
+		void SendStateResponse(const StringRequest& request,
+			const std::chrono::system_clock::time_point& request_time,
+			StatusAndResponse&& response, Send&& send) {
+			LogResponse(ip_, request_time, response.http_status,
+				response.content_type);
+			if (response.shared_body) {
+				const auto content_type = response.content_type;
+				return send(MakeSharedBodyResponse(request, std::move(response), content_type));
 			}
+			send(MakeStateStringResponse(response.http_status, response.body,
+				request.version(), request.keep_alive(),
+				request.method(), ContentType::API_JSON));
 		}
 
 		StringResponse ReportServerError(unsigned version, bool keep_alive) {
@@ -0,0 +1,332 @@
+#include "response_cache.h"
+
+#include <algorithm>
+#include <set>
+
+#include "json_writer.h"
+#include "state_encoding.h"
+
+namespace response_cache {
+	using namespace std::literals;
+
+	namespace {
+		constexpr json_writer::KeyFragment POS_KEY{ "pos" };
+		constexpr json_writer::KeyFragment SPEED_KEY{ "speed" };
+		constexpr json_writer::KeyFragment DIR_KEY{ "dir" };
+		constexpr json_writer::KeyFragment BAG_KEY{ "bag" };
+		constexpr json_writer::KeyFragment SCORE_KEY{ "score" };
+		constexpr json_writer::KeyFragment ID_KEY{ "id" };
+		constexpr json_writer::KeyFragment TYPE_KEY{ "type" };
+		constexpr json_writer::KeyFragment NAME_KEY{ "name" };
+		constexpr json_writer::KeyFragment VERSION_KEY{ "version" };
+		constexpr json_writer::KeyFragment FULL_KEY{ "full" };
+		constexpr json_writer::KeyFragment PLAYERS_KEY{ "players" };
+		constexpr json_writer::KeyFragment LOST_OBJECTS_KEY{ "lostObjects" };
+		constexpr json_writer::KeyFragment REMOVED_PLAYERS_KEY{ "removedPlayers" };
+		constexpr json_writer::KeyFragment REMOVED_OBJECTS_KEY{ "removedObjects" };
+
+		void WriteCoord(json_writer::JsonWriter& writer, const model::FloatCoord& coord) {
+			writer.StartArray();
+			writer.Double(coord.x);
+			writer.Double(coord.y);
+			writer.EndArray();
+		}
+
+		void WritePlayerData(json_writer::JsonWriter& writer, const model::Player& player) {
+			writer.StartObject();
+			writer.Key(POS_KEY);
+			WriteCoord(writer, player.pos_);
+			writer.Key(SPEED_KEY);
+			WriteCoord(writer, player.speed_);
+			writer.Key(DIR_KEY);
+			writer.String(model::DirectionToString(player.direction_));
+			writer.Key(BAG_KEY);
+			writer.StartArray();
+			for (const auto& loot_with_id : player.bag_) {
+				writer.StartObject();
+				writer.Key(ID_KEY);
+				writer.Uint(loot_with_id.id);
+				writer.Key(TYPE_KEY);
+				writer.Uint(loot_with_id.type);
+				writer.EndObject();
+			}
+			writer.EndArray();
+			writer.Key(SCORE_KEY);
+			writer.Uint(player.score_);
+			writer.EndObject();
+		}
+
+		void WriteLootData(json_writer::JsonWriter& writer, const model::Loot& loot) {
+			writer.StartObject();
+			writer.Key(TYPE_KEY);
+			writer.Uint(loot.type);
+			writer.Key(POS_KEY);
+			WriteCoord(writer, loot.coord);
+			writer.EndObject();
+		}
+
+		/// @brief массив строк с id
+		void WriteIds(json_writer::JsonWriter& writer, const std::vector<std::string>& ids) {
+			writer.StartArray();
+			for (const auto& id : ids) {
+				writer.String(id);
+			}
+			writer.EndArray();
+		}
+	}  // namespace
+
+	std::string SerializePlayers(const std::deque<model::Player>& players) {
+		std::string out;
+		json_writer::JsonWriter writer{ out };
+		writer.StartObject();
+		for (const auto& player : players) {
+			writer.Key(std::to_string(player.id_));
+			writer.StartObject();
+			writer.Key(NAME_KEY);
+			writer.String(player.name_);
+			writer.EndObject();
+		}
+		writer.EndObject();
+		return out;
+	}
+
+	ResponseCache::ResponseCache(model::Game& game, size_t journal_depth)
+		: game_(game)
+		, journal_depth_(journal_depth) {
+		for (const auto& map : game_.GetMaps()) {
+			slots_.try_emplace(*map.GetId());
+		}
+	}
+
+	void ResponseCache::SetCompressor(const content_encoding::Compressor& compressor) {
+		compressor_ = compressor;
+	}
+
+	void ResponseCache::Refresh() {
+		for (auto& [map_name, slot] : slots_) {
+			// на карте ещё никого не было
+			if (game_.GetMapVersion(map_name) == 0) {
+				continue;
+			}
+			Publish(slot, map_name);
+		}
+	}
+
+	void ResponseCache::Refresh(const std::string& map_name) {
+		Publish(slots_.at(map_name), map_name);
+	}
+
+	MapResponses ResponseCache::Get(const std::string& map_name) {
+		return Published(map_name)->responses;
+	}
+
+	std::string ResponseCache::GetDelta(const std::string& map_name, uint64_t since) {
+		const auto published = Published(map_name);
+		const MapState& entry = *published;
+		const uint64_t version = entry.responses.version;
+
+		// журнал не помнит такую версию: полное состояние
+		if (since == 0 || since < entry.journal_base || since > version) {
+			const std::string& state = *entry.responses.state;
+			std::string out;
+			out.reserve(state.size() + 32);
+			json_writer::JsonWriter writer{ out };
+			writer.StartObject();
+			writer.Key(VERSION_KEY);
+			writer.Uint(version);
+			writer.Key(FULL_KEY);
+			writer.Bool(true);
+			// поля полного состояния без его фигурных скобок
+			out += ',';
+			out.append(state, 1, state.size() - 1);
+			return out;
+		}
+
+		std::set<std::string> touched_players;
+		std::set<size_t> touched_loot;
+		for (auto it = entry.journal.rbegin(); it != entry.journal.rend() && (*it)->version > since; ++it) {
+			touched_players.insert((*it)->players.begin(), (*it)->players.end());
+			touched_loot.insert((*it)->loot.begin(), (*it)->loot.end());
+		}
+
+		std::string out;
+		json_writer::JsonWriter writer{ out };
+		writer.StartObject();
+		writer.Key(VERSION_KEY);
+		writer.Uint(version);
+
+		std::vector<std::string> removed_players;
+		writer.Key(PLAYERS_KEY);
+		writer.StartObject();
+		for (const auto& id : touched_players) {
+			if (auto index = entry.player_index.find(id); index != entry.player_index.end()) {
+				writer.Key(id);
+				writer.Raw(entry.players[index->second].second);
+			} else {
+				removed_players.push_back(id);
+			}
+		}
+		writer.EndObject();
+
+		std::vector<std::string> removed_loot;
+		writer.Key(LOST_OBJECTS_KEY);
+		writer.StartObject();
+		for (const size_t id : touched_loot) {
+			if (id < entry.loot.size()) {
+				writer.Key(std::to_string(id));
+				writer.Raw(entry.loot[id]);
+			} else {
+				removed_loot.push_back(std::to_string(id));
+			}
+		}
+		writer.EndObject();
+
+		writer.Key(REMOVED_PLAYERS_KEY);
+		WriteIds(writer, removed_players);
+		writer.Key(REMOVED_OBJECTS_KEY);
+		WriteIds(writer, removed_loot);
+		writer.EndObject();
+		return out;
+	}
+
+	std::shared_ptr<const ResponseCache::MapState> ResponseCache::Published(const std::string& map_name) {
+		MapSlot& slot = slots_.at(map_name);
+		{
+			std::lock_guard lock{ slot.mtx };
+			if (slot.state) {
+				return slot.state;
+			}
+		}
+		// карту ещё не собирали: собираем один раз, дальше её пересобирает тик
+		Publish(slot, map_name);
+		std::lock_guard lock{ slot.mtx };
+		return slot.state;
+	}
+
+	void ResponseCache::Publish(MapSlot& slot, const std::string& map_name) {
+		std::lock_guard build_lock{ slot.build_mtx };
+		// сборку меняет только владелец build_mtx, поэтому её можно читать без mtx
+		const MapState* previous = slot.state.get();
+		if (previous != nullptr && previous->responses.version == game_.GetMapVersion(map_name)) {
+			return;
+		}
+		auto state = Build(map_name, previous);
+		std::lock_guard lock{ slot.mtx };
+		slot.state = std::move(state);
+	}
+
+	std::shared_ptr<const ResponseCache::MapState> ResponseCache::Build(const std::string& map_name,
+		const MapState* previous) const {
+		const uint64_t version = game_.GetMapVersion(map_name);
+		const uint64_t tick = game_.GetTick();
+
+		std::deque<model::Player> players_on_map;
+		game_.GetPlayersOnMap(players_on_map, map_name);
+		std::deque<model::Loot> loot_on_map;
+		game_.GetLootOnMap(loot_on_map, map_name);
+
+		// каждый объект сериализуется один раз: из этих строк собираются и полное состояние, и изменения.
+		// Объекты пишутся в общий буфер, который переиспользуется между ними
+		std::string buffer;
+		std::vector<std::pair<std::string, std::string>> players;
+		std::unordered_map<std::string, size_t> player_index;
+		players.reserve(players_on_map.size());
+		for (const auto& player : players_on_map) {
+			buffer.clear();
+			json_writer::JsonWriter writer{ buffer };
+			WritePlayerData(writer, player);
+			player_index[std::to_string(player.id_)] = players.size();
+			players.emplace_back(std::to_string(player.id_), buffer);
+		}
+		std::vector<std::string> loot;
+		loot.reserve(loot_on_map.size());
+		for (const auto& item : loot_on_map) {
+			buffer.clear();
+			json_writer::JsonWriter writer{ buffer };
+			WriteLootData(writer, item);
+			loot.push_back(buffer);
+		}
+
+		// первая сборка сравнивается с пустой картой
+		const MapState empty;
+		const MapState& old = previous != nullptr ? *previous : empty;
+		auto changes = std::make_shared<JournalEntry>();
+		changes->version = version;
+		for (const auto& [id, data] : players) {
+			auto index = old.player_index.find(id);
+			if (index == old.player_index.end() || old.players[index->second].second != data) {
+				changes->players.push_back(id);
+			}
+		}
+		for (const auto& [id, data] : old.players) {
+			if (!player_index.contains(id)) {
+				changes->players.push_back(id);
+			}
+		}
+		for (size_t id = 0; id < std::max(loot.size(), old.loot.size()); ++id) {
+			if (id >= loot.size() || id >= old.loot.size() || loot[id] != old.loot[id]) {
+				changes->loot.push_back(id);
+			}
+		}
+
+		// {"players": {...}, "lostObjects": {...}}
+		std::string state;
+		{
+			size_t state_size = 32;
+			for (const auto& [id, data] : players) {
+				state_size += id.size() + data.size() + 4;
+			}
+			for (const auto& data : loot) {
+				state_size += data.size() + 16;
+			}
+			state.reserve(state_size);
+
+			json_writer::JsonWriter writer{ state };
+			writer.StartObject();
+			writer.Key(PLAYERS_KEY);
+			writer.StartObject();
+			for (const auto& [id, data] : players) {
+				writer.Key(id);
+				writer.Raw(data);
+			}
+			writer.EndObject();
+			writer.Key(LOST_OBJECTS_KEY);
+			writer.StartObject();
+			for (size_t id = 0; id < loot.size(); ++id) {
+				writer.Key(std::to_string(id));
+				writer.Raw(loot[id]);
+			}
+			writer.EndObject();
+			writer.EndObject();
+		}
+
+		auto entry = std::make_shared<MapState>();
+		// первая сборка - начало журнала, изменений относительно неё ещё нет
+		if (previous == nullptr) {
+			entry->journal_base = version;
+		} else {
+			entry->journal = previous->journal;
+			entry->journal_base = previous->journal_base;
+			entry->journal.push_back(std::move(changes));
+			while (entry->journal.size() > journal_depth_) {
+				entry->journal_base = entry->journal.front()->version;
+				entry->journal.pop_front();
+			}
+		}
+
+		entry->responses.version = version;
+		entry->responses.tick = tick;
+		entry->responses.state = std::make_shared<const std::string>(std::move(state));
+		entry->responses.binary_state = std::make_shared<const std::string>(
+			state_encoding::EncodeState(players_on_map, loot_on_map));
+		entry->responses.players = std::make_shared<const std::string>(SerializePlayers(players_on_map));
+		// сжатие один раз на версию карты, а не на каждый запрос
+		entry->responses.state_gzip = compressor_.Compress(*entry->responses.state);
+		entry->responses.players_gzip = compressor_.Compress(*entry->responses.players);
+		entry->players = std::move(players);
+		entry->player_index = std::move(player_index);
+		entry->loot = std::move(loot);
+		return entry;
+	}
+
+}  // namespace response_cache
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "content_encoding.h"
+#include "model.h"
+
+namespace response_cache {
+
+	// Ответы по одной карте, общие для всех её игроков
+	struct MapResponses {
+		// версия состояния карты, по которой собраны ответы
+		uint64_t version{ 0 };
+		// тик, после которого собраны ответы
+		uint64_t tick{ 0 };
+		// тело ответа на /api/v1/game/state
+		std::shared_ptr<const std::string> state;
+		// тело ответа на /api/v1/game/state в двоичном формате state_encoding
+		std::shared_ptr<const std::string> binary_state;
+		// тело ответа на /api/v1/game/players
+		std::shared_ptr<const std::string> players;
+		// сжатые gzip тела state и players; nullptr - тело отдаётся без сжатия
+		std::shared_ptr<const std::string> state_gzip;
+		std::shared_ptr<const std::string> players_gzip;
+	};
+
+	/// @brief сериализация списка игроков на карте: {"<id>": {"name": "<имя>"}}
+	/// @param players игроки на карте
+	/// @return тело ответа
+	std::string SerializePlayers(const std::deque<model::Player>& players);
+
+	/// @brief Кэш ответов на запросы состояния игры и списка игроков по картам.
+	/// После тика ответы собираются один раз на карту и публикуются, а обработчики запросов
+	/// только копируют указатель на опубликованную сборку под блокировкой своей карты, так что
+	/// работа растёт с числом карт и тиков, а не запросов. Движение игрока между тиками
+	/// попадает в ответы со следующим тиком; вход игрока пересобирает ответы его карты сразу.
+	/// Для каждой карты ведётся журнал изменений за последние сборки: какие игроки и
+	/// предметы лута изменились, появились или пропали. По нему собираются ответы
+	/// /api/v1/game/state?since=<версия> только с изменившимися объектами
+	class ResponseCache {
+	public:
+		// Сколько последних сборок ответов по карте помнит журнал изменений
+		constexpr static size_t JOURNAL_DEPTH = 128;
+
+		/// @param game игра
+		/// @param journal_depth сколько сборок помнит журнал изменений каждой карты
+		explicit ResponseCache(model::Game& game, size_t journal_depth = JOURNAL_DEPTH);
+
+		ResponseCache(const ResponseCache&) = delete;
+		ResponseCache& operator=(const ResponseCache&) = delete;
+
+		/// @brief сжимать тела ответов для клиентов с Accept-Encoding: gzip;
+		/// вызывается до обработки запросов
+		/// @param compressor параметры сжатия
+		void SetCompressor(const content_encoding::Compressor& compressor);
+
+		/// @brief пересобрать ответы по изменившимся картам, вызывается после тика
+		void Refresh();
+
+		/// @brief пересобрать ответы по карте, если она изменилась; вызывается после входа игрока,
+		/// чтобы он сразу видел себя в состоянии карты
+		/// @param map_name имя карты
+		void Refresh(const std::string& map_name);
+
+		/// @brief ответы, опубликованные последней сборкой по карте
+		/// @param map_name имя карты с игроками
+		MapResponses Get(const std::string& map_name);
+
+		/// @brief изменения состояния карты после версии since:
+		/// {"version": V, "players": {...}, "lostObjects": {...}, "removedPlayers": [...], "removedObjects": [...]}.
+		/// Если журнал не помнит версию since, возвращается полное состояние с "full": true
+		/// @param map_name имя карты с игроками
+		/// @param since версия из предыдущего ответа, 0 - полное состояние
+		/// @return тело ответа
+		std::string GetDelta(const std::string& map_name, uint64_t since);
+
+	private:
+		// Объекты, изменившиеся в одной сборке
+		struct JournalEntry {
+			uint64_t version{ 0 };
+			std::vector<std::string> players;
+			std::vector<size_t> loot;
+		};
+
+		// Сборка ответов и сериализованных объектов карты; после публикации не меняется
+		struct MapState {
+			MapResponses responses;
+			// id игрока и его сериализованное состояние в порядке игроков на карте
+			std::vector<std::pair<std::string, std::string>> players;
+			// индекс игрока в players по id
+			std::unordered_map<std::string, size_t> player_index;
+			// сериализованный лут, id предмета - его индекс
+			std::vector<std::string> loot;
+			// записи общие у соседних сборок, копируются только указатели
+			std::deque<std::shared_ptr<const JournalEntry>> journal;
+			// версия, начиная с которой журнал хранит все изменения
+			uint64_t journal_base{ 0 };
+		};
+
+		// Опубликованная сборка карты
+		struct MapSlot {
+			// одна сборка карты за раз: тик и вход игрока могут пересобирать её одновременно
+			std::mutex build_mtx;
+			// защищает только указатель, запросы не ждут сборку
+			std::mutex mtx;
+			std::shared_ptr<const MapState> state;
+		};
+
+		/// @brief последняя опубликованная сборка карты; до первой сборки собирает её
+		std::shared_ptr<const MapState> Published(const std::string& map_name);
+
+		/// @brief пересобрать и опубликовать ответы по карте, если её версия изменилась
+		void Publish(MapSlot& slot, const std::string& map_name);
+
+		/// @brief сборка ответов и запись изменений в журнал; версия берётся до копирования
+		/// состояния, поэтому изменение во время сборки только приводит к лишней пересборке
+		/// @param previous предыдущая сборка, nullptr - первая
+		std::shared_ptr<const MapState> Build(const std::string& map_name, const MapState* previous) const;
+
+		model::Game& game_;
+		size_t journal_depth_;
+		// сжатие собранных тел; задаётся до обработки запросов
+		content_encoding::Compressor compressor_;
+
+		// карты игры не меняются после загрузки, поэтому словарь заполняется в конструкторе
+		// и дальше только читается
+		std::unordered_map<std::string, MapSlot> slots_;
+	};
+
+}  // namespace response_cache
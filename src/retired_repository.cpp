@@ -0,0 +1,72 @@
+#include "retired_repository.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace retired_repository {
+
+	bool IsRankedHigher(const RetiredPlayer& lhs, const RetiredPlayer& rhs) {
+		if (lhs.score != rhs.score) {
+			return lhs.score > rhs.score;
+		}
+		if (lhs.play_time_s != rhs.play_time_s) {
+			return lhs.play_time_s < rhs.play_time_s;
+		}
+		return lhs.name < rhs.name;
+	}
+
+	void InMemoryRetiredPlayersRepository::Init() {
+	}
+
+	void InMemoryRetiredPlayersRepository::Save(const std::vector<RetiredPlayer>& retired_players) {
+		std::lock_guard lock{ mtx_ };
+		for (const auto& player : retired_players) {
+			if (!player.record_id.empty() && !record_ids_.insert(player.record_id).second) {
+				continue;
+			}
+			// как и в БД, id игрока не хранится
+			RetiredPlayer record = player;
+			record.id = 0;
+			records_.insert(std::move(record));
+		}
+	}
+
+	void InMemoryRetiredPlayersRepository::ReadAll(size_t max_records, std::vector<RetiredPlayer>& retired_players) {
+		std::lock_guard lock{ mtx_ };
+		auto end = std::next(records_.begin(), std::min(max_records, records_.size()));
+		retired_players.insert(retired_players.end(), records_.begin(), end);
+	}
+
+	void InMemoryRetiredPlayersRepository::ReadPage(int start, int max_items,
+		std::vector<RetiredPlayer>& retired_players) {
+		std::lock_guard lock{ mtx_ };
+		if (start < 0 || max_items <= 0 || static_cast<size_t>(start) >= records_.size()) {
+			return;
+		}
+		auto it = std::next(records_.begin(), start);
+		for (int i = 0; i < max_items && it != records_.end(); ++i, ++it) {
+			retired_players.push_back(*it);
+		}
+	}
+
+	void InMemoryRetiredPlayersRepository::ReadAfter(const RecordsCursor& cursor, int max_items,
+		std::vector<RetiredPlayer>& retired_players) {
+		std::lock_guard lock{ mtx_ };
+		// первая запись с ключом не выше курсора, записи с тем же ключом пропускаем
+		auto it = records_.lower_bound({ 0, cursor.name, cursor.score, cursor.play_time_s });
+		for (int i = 0; i < cursor.skip && it != records_.end(); ++i) {
+			++it;
+		}
+		for (int i = 0; i < max_items && it != records_.end(); ++i, ++it) {
+			retired_players.push_back(*it);
+		}
+	}
+
+	void InMemoryRetiredPlayersRepository::Post(std::function<void(RetiredPlayersRepository&)> work) {
+		work(*this);
+	}
+
+	void InMemoryRetiredPlayersRepository::Wait() {
+	}
+
+}  // namespace retired_repository
@@ -0,0 +1,170 @@
+#pragma once
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+namespace retired_repository {
+	namespace net = boost::asio;
+
+	// Игрок покинувший игру
+	struct RetiredPlayer {
+		int id;
+		std::string name;
+		int score;
+		int play_time_s;
+		// идентификатор строки в БД; пустой - сгенерировать при записи.
+		// Повторная запись с тем же идентификатором ничего не меняет
+		std::string record_id{};
+	};
+
+	// Позиция в таблице рекордов для постраничного чтения по ключу индекса scores_rating_keyset
+	struct RecordsCursor {
+		// ключ последней отданной записи
+		int score;
+		int play_time_s;
+		std::string name;
+		// сколько записей с этим же ключом уже отдано
+		int skip{ 0 };
+	};
+
+	/// @brief порядок записей как в индексе scores_rating_keyset; имена сравниваются побайтово, как COLLATE "C"
+	/// @param lhs
+	/// @param rhs
+	/// @return true - lhs выше в таблице рекордов
+	bool IsRankedHigher(const RetiredPlayer& lhs, const RetiredPlayer& rhs);
+
+	// Сигнатура обработчика результата асинхронного запроса к хранилищу
+	template <typename Result>
+	struct ExecuteSignature {
+		using type = void(std::exception_ptr, Result);
+	};
+
+	template <>
+	struct ExecuteSignature<void> {
+		using type = void(std::exception_ptr);
+	};
+
+	/// @brief Хранилище выбывших игроков.
+	/// Методы чтения и записи блокирующие; чтобы не занимать потоки io_context, их вызывают
+	/// через AsyncExecute. Работа, переданная в Post, получает хранилище, методы которого
+	/// не ждут ресурсов (для Postgres - привязанное к уже полученному соединению)
+	class RetiredPlayersRepository {
+	public:
+		virtual ~RetiredPlayersRepository() = default;
+
+		/// @brief подготовить хранилище к работе (создать таблицу)
+		virtual void Init() = 0;
+
+		/// @brief записать выбывших игроков
+		/// @param retired_players выбывшие игроки
+		virtual void Save(const std::vector<RetiredPlayer>& retired_players) = 0;
+
+		/// @brief прочитать все записи вместе с идентификаторами строк, но не больше max_records
+		/// @param max_records наибольшее число записей
+		/// @param retired_players прочитанные записи
+		virtual void ReadAll(size_t max_records, std::vector<RetiredPlayer>& retired_players) = 0;
+
+		/// @brief прочитать страницу рекордов
+		/// @param start номер начального элемента (0 — начальный элемент)
+		/// @param max_items максимальное количество элементов
+		/// @param retired_players прочитанные записи
+		virtual void ReadPage(int start, int max_items, std::vector<RetiredPlayer>& retired_players) = 0;
+
+		/// @brief прочитать страницу рекордов, следующую за курсором
+		/// @param cursor позиция последней отданной записи
+		/// @param max_items максимальное количество элементов
+		/// @param retired_players прочитанные записи
+		virtual void ReadAfter(const RecordsCursor& cursor, int max_items,
+			std::vector<RetiredPlayer>& retired_players) = 0;
+
+		/// @brief выполнить блокирующую работу с хранилищем вне потоков io_context
+		/// @param work работа; исключения она обрабатывает сама
+		virtual void Post(std::function<void(RetiredPlayersRepository&)> work) = 0;
+
+		/// @brief дождаться завершения работы, уже переданной в Post
+		virtual void Wait() = 0;
+
+		/// @brief Асинхронное выполнение запроса к хранилищу.
+		/// Результат передаётся обработчику на его executor'е
+		/// @param work функция вида Result(RetiredPlayersRepository&)
+		/// @param token обработчик вида void(std::exception_ptr, Result), для void - void(std::exception_ptr)
+		template <typename Work, typename CompletionToken>
+		auto AsyncExecute(Work&& work, CompletionToken&& token) {
+			using Result = std::invoke_result_t<std::decay_t<Work>&, RetiredPlayersRepository&>;
+			using Signature = typename ExecuteSignature<Result>::type;
+
+			return net::async_initiate<CompletionToken, Signature>(
+				[this](auto handler, auto work) {
+					// std::function требует копируемости, а обработчики asio бывают только перемещаемыми
+					auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+					auto shared_work = std::make_shared<decltype(work)>(std::move(work));
+					Post([shared_handler, shared_work](RetiredPlayersRepository& repository) {
+						auto ex = net::get_associated_executor(*shared_handler);
+						std::exception_ptr error;
+						if constexpr (std::is_void_v<Result>) {
+							try {
+								(*shared_work)(repository);
+							}
+							catch (...) {
+								error = std::current_exception();
+							}
+							net::dispatch(ex, [shared_handler, error] {
+								(*shared_handler)(error);
+							});
+						} else {
+							Result result{};
+							try {
+								result = (*shared_work)(repository);
+							}
+							catch (...) {
+								error = std::current_exception();
+							}
+							net::dispatch(ex, [shared_handler, error, result = std::move(result)]() mutable {
+								(*shared_handler)(error, std::move(result));
+							});
+						}
+					});
+				},
+				token, std::forward<Work>(work));
+		}
+	};
+
+	/// @brief Хранилище выбывших игроков в памяти процесса.
+	/// Работает без БД: для замеров и тестов модели и HTTP-обработчиков
+	class InMemoryRetiredPlayersRepository : public RetiredPlayersRepository {
+	public:
+		void Init() override;
+		void Save(const std::vector<RetiredPlayer>& retired_players) override;
+		void ReadAll(size_t max_records, std::vector<RetiredPlayer>& retired_players) override;
+		void ReadPage(int start, int max_items, std::vector<RetiredPlayer>& retired_players) override;
+		void ReadAfter(const RecordsCursor& cursor, int max_items,
+			std::vector<RetiredPlayer>& retired_players) override;
+
+		/// @brief работа выполняется сразу в вызывающем потоке: запросы к памяти не блокируются
+		void Post(std::function<void(RetiredPlayersRepository&)> work) override;
+		void Wait() override;
+
+	private:
+		struct RankOrder {
+			bool operator()(const RetiredPlayer& lhs, const RetiredPlayer& rhs) const {
+				return IsRankedHigher(lhs, rhs);
+			}
+		};
+
+		std::mutex mtx_;
+		// записи в порядке индекса scores_rating_keyset
+		std::multiset<RetiredPlayer, RankOrder> records_;
+		// идентификаторы записанных строк, повторная запись игнорируется
+		std::unordered_set<std::string> record_ids_;
+	};
+
+}  // namespace retired_repository
@@ -0,0 +1,358 @@
+#include "retired_spool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+
+#include "file_io.h"
+#include "my_logger.h"
+#include "random_functions.h"
+
+namespace retired_spool {
+	using namespace std::literals;
+	using file_io::Crc32;
+	using file_io::ThrowSystemError;
+	using file_io::WriteAll;
+
+	namespace {
+		// Заголовок файла журнала: сигнатура и версия формата
+		constexpr std::string_view FILE_HEADER = "RSPOOL01"sv;
+		// Размер идентификатора строки БД
+		constexpr size_t RECORD_ID_SIZE = 32;
+		// Размер и crc32 данных записи
+		constexpr size_t RECORD_PREFIX_SIZE = 8;
+		// Идентификатор, очки и время игры
+		constexpr size_t RECORD_FIXED_SIZE = RECORD_ID_SIZE + 8;
+		// Запись больше этого размера считаем повреждённой
+		constexpr size_t MAX_RECORD_SIZE = 64 * 1024;
+		// Сколько байт журнала читается за раз
+		constexpr size_t READ_CHUNK_SIZE = 256 * 1024;
+
+		void PutUint32(uint32_t value, std::string& out) {
+			for (int i = 0; i < 4; ++i) {
+				out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+			}
+		}
+
+		uint32_t GetUint32(const char* data) {
+			uint32_t value = 0;
+			for (int i = 0; i < 4; ++i) {
+				value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+			}
+			return value;
+		}
+
+		/// @brief прочитать до size байт с позиции offset
+		std::string ReadAt(int fd, uint64_t offset, size_t size) {
+			std::string data(size, '\0');
+			size_t total = 0;
+			while (total < size) {
+				const ssize_t read = ::pread(fd, data.data() + total, size - total, static_cast<off_t>(offset + total));
+				if (read < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					ThrowSystemError("pread"s);
+				}
+				if (read == 0) {
+					break;
+				}
+				total += static_cast<size_t>(read);
+			}
+			data.resize(total);
+			return data;
+		}
+
+	}  // namespace
+
+	void EncodeRecord(const retired_repository::RetiredPlayer& player, std::string& out) {
+		std::string payload;
+		payload.reserve(RECORD_FIXED_SIZE + player.name.size());
+		payload.append(player.record_id, 0, RECORD_ID_SIZE);
+		payload.resize(RECORD_ID_SIZE, '0');
+		PutUint32(static_cast<uint32_t>(player.score), payload);
+		PutUint32(static_cast<uint32_t>(player.play_time_s), payload);
+		payload += player.name;
+
+		PutUint32(static_cast<uint32_t>(payload.size()), out);
+		PutUint32(Crc32(payload), out);
+		out += payload;
+	}
+
+	size_t DecodeRecord(std::string_view data, retired_repository::RetiredPlayer& player) {
+		if (data.size() < RECORD_PREFIX_SIZE) {
+			return 0;
+		}
+		const size_t payload_size = GetUint32(data.data());
+		if (payload_size < RECORD_FIXED_SIZE || payload_size > MAX_RECORD_SIZE
+			|| data.size() - RECORD_PREFIX_SIZE < payload_size) {
+			return 0;
+		}
+		const std::string_view payload = data.substr(RECORD_PREFIX_SIZE, payload_size);
+		if (GetUint32(data.data() + 4) != Crc32(payload)) {
+			return 0;
+		}
+
+		player.id = 0;
+		player.record_id = std::string(payload.substr(0, RECORD_ID_SIZE));
+		player.score = static_cast<int>(GetUint32(payload.data() + RECORD_ID_SIZE));
+		player.play_time_s = static_cast<int>(GetUint32(payload.data() + RECORD_ID_SIZE + 4));
+		player.name = std::string(payload.substr(RECORD_FIXED_SIZE));
+		return RECORD_PREFIX_SIZE + payload_size;
+	}
+
+	RetiredSpool::RetiredSpool(std::filesystem::path path, Sink sink)
+		: path_(std::move(path))
+		, offset_path_(path_.string() + std::string(Literals::OFFSET_SUFFIX))
+		, sink_(std::move(sink)) {
+		OpenFile();
+		flush_thread_ = std::thread([this] { FlushLoop(); });
+	}
+
+	RetiredSpool::~RetiredSpool() {
+		{
+			std::lock_guard lock{ mtx_ };
+			stop_ = true;
+		}
+		cond_var_.notify_all();
+		if (replay_thread_.joinable()) {
+			replay_thread_.join();
+		}
+		flush_thread_.join();
+		::close(fd_);
+	}
+
+	void RetiredSpool::OpenFile() {
+		fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (fd_ < 0) {
+			ThrowSystemError("Failed to open retired spool "s + path_.string());
+		}
+
+		const uint64_t size = static_cast<uint64_t>(::lseek(fd_, 0, SEEK_END));
+		if (size < FILE_HEADER.size()) {
+			if (::ftruncate(fd_, 0) != 0) {
+				ThrowSystemError("ftruncate"s);
+			}
+			WriteAll(fd_, FILE_HEADER);
+			::fdatasync(fd_);
+			end_ = FILE_HEADER.size();
+		} else {
+			if (ReadAt(fd_, 0, FILE_HEADER.size()) != FILE_HEADER) {
+				throw std::runtime_error("Unknown retired spool format: "s + path_.string());
+			}
+			// Хвост, записанный не полностью перед падением, отрезаем
+			uint64_t valid_end = FILE_HEADER.size();
+			while (valid_end < size) {
+				const std::string chunk = ReadAt(fd_, valid_end, READ_CHUNK_SIZE);
+				std::string_view rest{ chunk };
+				retired_repository::RetiredPlayer player;
+				size_t parsed = 0;
+				while (size_t record_size = DecodeRecord(rest.substr(parsed), player)) {
+					parsed += record_size;
+				}
+				if (parsed == 0) {
+					break;
+				}
+				valid_end += parsed;
+			}
+			if (valid_end < size && ::ftruncate(fd_, static_cast<off_t>(valid_end)) != 0) {
+				ThrowSystemError("ftruncate"s);
+			}
+			end_ = valid_end;
+		}
+
+		replayed_ = LoadReplayedOffset();
+		// позиция за концом журнала остаётся от журнала до обрезки
+		if (replayed_ < FILE_HEADER.size() || replayed_ > end_) {
+			replayed_ = FILE_HEADER.size();
+		}
+	}
+
+	bool RetiredSpool::Append(const std::vector<retired_repository::RetiredPlayer>& players) {
+		if (players.empty()) {
+			return true;
+		}
+		std::string data;
+		for (const auto& player : players) {
+			if (player.record_id.empty()) {
+				retired_repository::RetiredPlayer with_id = player;
+				with_id.record_id = random_functions::RandomHexString(RECORD_ID_SIZE);
+				EncodeRecord(with_id, data);
+			} else {
+				EncodeRecord(player, data);
+			}
+		}
+
+		{
+			std::lock_guard lock{ mtx_ };
+			try {
+				WriteAll(fd_, data);
+			}
+			catch (const std::exception& ex) {
+				logger::LogError("retired spool append"sv, ex.what());
+				// недописанную запись отрезаем, чтобы журнал остался целым
+				if (::ftruncate(fd_, static_cast<off_t>(end_)) != 0) {
+					logger::LogError("retired spool append"sv, std::strerror(errno));
+				}
+				return false;
+			}
+			end_ += data.size();
+			dirty_ = true;
+		}
+		cond_var_.notify_all();
+		return true;
+	}
+
+	void RetiredSpool::Start() {
+		std::lock_guard lock{ mtx_ };
+		if (!replay_thread_.joinable()) {
+			replay_thread_ = std::thread([this] { ReplayLoop(); });
+		}
+	}
+
+	uint64_t RetiredSpool::PendingBytes() const {
+		std::lock_guard lock{ mtx_ };
+		return end_ - replayed_;
+	}
+
+	void RetiredSpool::FlushLoop() {
+		std::unique_lock lock{ mtx_ };
+		while (true) {
+			const bool stop = cond_var_.wait_for(lock, SYNC_PERIOD, [this] { return stop_; });
+			if (dirty_) {
+				// одна синхронизация на все записи, сделанные за период
+				dirty_ = false;
+				lock.unlock();
+				::fdatasync(fd_);
+				lock.lock();
+			}
+			if (stop) {
+				return;
+			}
+		}
+	}
+
+	void RetiredSpool::ReplayLoop() {
+		std::chrono::milliseconds retry_delay{ 0 };
+		std::unique_lock lock{ mtx_ };
+		while (true) {
+			cond_var_.wait(lock, [this] { return stop_ || replayed_ < end_; });
+			if (stop_) {
+				return;
+			}
+			const uint64_t from = replayed_;
+			const uint64_t end = end_;
+			lock.unlock();
+
+			std::vector<retired_repository::RetiredPlayer> batch;
+			uint64_t next = from;
+			bool replayed = false;
+			bool corrupted = false;
+			try {
+				next = ReadBatch(from, end, batch);
+				if (next == from) {
+					corrupted = true;
+					throw std::runtime_error("Corrupted retired spool record at "s + std::to_string(from));
+				}
+				sink_(batch);
+				StoreReplayedOffset(next);
+				replayed = true;
+			}
+			catch (const std::exception& ex) {
+				logger::LogError("retired spool replay"sv, ex.what());
+			}
+
+			lock.lock();
+			if (corrupted) {
+				// повреждённую запись не перенести никогда, пропускаем остаток журнала
+				replayed_ = end;
+				continue;
+			}
+			if (!replayed) {
+				retry_delay = std::min(std::max(retry_delay * 2, std::chrono::milliseconds{ 100 }), MAX_RETRY_DELAY);
+				cond_var_.wait_for(lock, retry_delay, [this] { return stop_; });
+				continue;
+			}
+			retry_delay = std::chrono::milliseconds{ 0 };
+			replayed_ = next;
+
+			if (replayed_ == end_ && end_ >= COMPACT_THRESHOLD) {
+				// Всё перенесено: обрезаем журнал. Позиция сохраняется до обрезки - после падения
+				// между этими шагами записи перенесутся повторно, что безопасно
+				try {
+					StoreReplayedOffset(FILE_HEADER.size());
+					if (::ftruncate(fd_, static_cast<off_t>(FILE_HEADER.size())) != 0) {
+						ThrowSystemError("ftruncate"s);
+					}
+					::fdatasync(fd_);
+					end_ = replayed_ = FILE_HEADER.size();
+				}
+				catch (const std::exception& ex) {
+					logger::LogError("retired spool compaction"sv, ex.what());
+				}
+			}
+		}
+	}
+
+	uint64_t RetiredSpool::ReadBatch(uint64_t offset, uint64_t end, std::vector<retired_repository::RetiredPlayer>& batch) const {
+		while (offset < end && batch.size() < MAX_BATCH_RECORDS) {
+			const std::string chunk = ReadAt(fd_, offset, static_cast<size_t>(std::min<uint64_t>(end - offset, READ_CHUNK_SIZE)));
+			std::string_view rest{ chunk };
+			size_t parsed = 0;
+			retired_repository::RetiredPlayer player;
+			while (batch.size() < MAX_BATCH_RECORDS) {
+				const size_t record_size = DecodeRecord(rest.substr(parsed), player);
+				if (record_size == 0) {
+					break;
+				}
+				parsed += record_size;
+				batch.push_back(std::move(player));
+			}
+			if (parsed == 0) {
+				break;
+			}
+			offset += parsed;
+		}
+		return offset;
+	}
+
+	void RetiredSpool::StoreReplayedOffset(uint64_t offset) const {
+		const std::filesystem::path temp_path = offset_path_.string() + ".tmp"s;
+		const int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			ThrowSystemError("Failed to open "s + temp_path.string());
+		}
+		try {
+			WriteAll(fd, std::to_string(offset));
+			::fsync(fd);
+		}
+		catch (...) {
+			::close(fd);
+			throw;
+		}
+		::close(fd);
+		std::filesystem::rename(temp_path, offset_path_);
+	}
+
+	uint64_t RetiredSpool::LoadReplayedOffset() const {
+		const int fd = ::open(offset_path_.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			return 0;
+		}
+		const std::string data = ReadAt(fd, 0, 32);
+		::close(fd);
+		try {
+			return std::stoull(data);
+		}
+		catch (...) {
+			return 0;
+		}
+	}
+
+}  // namespace retired_spool
@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "retired_repository.h"
+
+namespace retired_spool {
+
+	struct Literals {
+		Literals() = delete;
+		// Суффикс файла с позицией первой не переданной в БД записи
+		constexpr static std::string_view OFFSET_SUFFIX = ".offset";
+	};
+
+	/// @brief кодирование записи журнала: [размер данных][crc32 данных][данные]
+	/// @param player выбывший игрок, record_id должен быть заполнен
+	/// @param out буфер, в конец которого дописывается запись
+	void EncodeRecord(const retired_repository::RetiredPlayer& player, std::string& out);
+
+	/// @brief разбор записи журнала
+	/// @param data данные, начинающиеся с записи
+	/// @param player разобранная запись
+	/// @return длина записи; 0 - запись неполная или повреждена
+	size_t DecodeRecord(std::string_view data, retired_repository::RetiredPlayer& player);
+
+	/// @brief Локальный журнал выбывших игроков.
+	/// Тик дописывает записи в конец файла без ожидания БД, fsync выполняется пачками
+	/// в отдельном потоке. Другой поток переносит записи в БД, когда она доступна, и
+	/// запоминает позицию последней перенесённой записи в файле <журнал>.offset.
+	/// Каждая запись получает идентификатор строки БД заранее, поэтому повторный перенос
+	/// после сбоя не создаёт дубликатов.
+	class RetiredSpool {
+	public:
+		// Запись пачки в БД, при ошибке бросает исключение
+		using Sink = std::function<void(const std::vector<retired_repository::RetiredPlayer>&)>;
+
+		/// @param path путь к файлу журнала, создаётся при отсутствии
+		/// @param sink запись пачки в БД
+		RetiredSpool(std::filesystem::path path, Sink sink);
+
+		RetiredSpool(const RetiredSpool&) = delete;
+		RetiredSpool& operator=(const RetiredSpool&) = delete;
+
+		~RetiredSpool();
+
+		/// @brief дописать выбывших игроков в журнал
+		/// @param players выбывшие игроки
+		/// @return false - запись в файл не удалась
+		bool Append(const std::vector<retired_repository::RetiredPlayer>& players);
+
+		/// @brief запустить перенос записей в БД; таблица в БД к этому моменту должна существовать
+		void Start();
+
+		/// @brief объём ещё не перенесённых в БД записей в байтах
+		uint64_t PendingBytes() const;
+
+	private:
+		void OpenFile();
+		void FlushLoop();
+		void ReplayLoop();
+
+		/// @brief прочитать пачку записей, начиная с позиции offset
+		/// @return позиция за последней прочитанной записью
+		uint64_t ReadBatch(uint64_t offset, uint64_t end, std::vector<retired_repository::RetiredPlayer>& batch) const;
+
+		void StoreReplayedOffset(uint64_t offset) const;
+		uint64_t LoadReplayedOffset() const;
+
+		// Как часто данные журнала сбрасываются на диск
+		constexpr static std::chrono::milliseconds SYNC_PERIOD{ 50 };
+		// Наибольшее число записей в одной транзакции БД
+		constexpr static size_t MAX_BATCH_RECORDS{ 512 };
+		// Пауза после неудачной записи в БД растёт вдвое до этого значения
+		constexpr static std::chrono::milliseconds MAX_RETRY_DELAY{ 5000 };
+		// Полностью перенесённый журнал больше этого размера обрезается
+		constexpr static uint64_t COMPACT_THRESHOLD{ 1 << 20 };
+
+		std::filesystem::path path_;
+		std::filesystem::path offset_path_;
+		Sink sink_;
+		int fd_{ -1 };
+
+		mutable std::mutex mtx_;
+		std::condition_variable cond_var_;
+		bool stop_{ false };
+		// есть записанные, но не сброшенные на диск данные
+		bool dirty_{ false };
+		// конец журнала
+		uint64_t end_{ 0 };
+		// позиция первой не перенесённой в БД записи
+		uint64_t replayed_{ 0 };
+
+		std::thread flush_thread_;
+		std::thread replay_thread_;
+	};
+
+}  // namespace retired_spool
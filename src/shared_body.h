@@ -0,0 +1,54 @@
+#pragma once
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+namespace http_server {
+
+	/// @brief Тело ответа Beast поверх неизменяемой разделяемой строки.
+	/// Один и тот же закэшированный ответ пишется в любое число сокетов без копирования
+	/// и выделения памяти на запрос: сокету передаётся буфер прямо поверх строки, а ответ
+	/// владеет только указателем на неё. Тело только отправляется, читать в него нельзя
+	struct SharedStringBody {
+		using value_type = std::shared_ptr<const std::string>;
+
+		static std::uint64_t size(const value_type& body) noexcept {
+			return body ? body->size() : 0;
+		}
+
+		class writer {
+		public:
+			using const_buffers_type = boost::asio::const_buffer;
+
+			template <bool isRequest, class Fields>
+			writer(const boost::beast::http::header<isRequest, Fields>&, const value_type& body)
+				: body_(body) {
+			}
+
+			void init(boost::beast::error_code& ec) {
+				ec = {};
+			}
+
+			boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code& ec) {
+				ec = {};
+				if (!body_) {
+					return boost::none;
+				}
+				// всё тело одним буфером, продолжения нет
+				return { { const_buffers_type{ body_->data(), body_->size() }, false } };
+			}
+
+		private:
+			const value_type& body_;
+		};
+	};
+
+}  // namespace http_server
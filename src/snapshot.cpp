@@ -0,0 +1,801 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "binary_io.h"
+#include "content_encoding.h"
+#include "file_io.h"
+#include "my_logger.h"
+
+namespace snapshot {
+
+	namespace {
+		using binary_io::BinaryReader;
+		using binary_io::BinaryWriter;
+		using file_io::Crc32;
+
+		void WriteSection(SectionTag tag, std::string_view payload, std::string& out) {
+			BinaryWriter writer{ out };
+			writer.WriteU32(static_cast<uint32_t>(tag));
+			writer.WriteU64(payload.size());
+			out.append(payload);
+		}
+
+		void WritePlayer(const model::Player& player, BinaryWriter& writer) {
+			writer.WriteCoord(player.pos_);
+			writer.WriteCoord(player.speed_);
+			writer.WriteU8(static_cast<uint8_t>(player.direction_));
+			writer.WriteVarint(player.id_);
+			writer.WriteString(player.name_);
+			writer.WriteString(player.hash_);
+			writer.WriteVarint(player.bag_.size());
+			for (const auto& item : player.bag_) {
+				writer.WriteVarint(item.id);
+				writer.WriteVarint(item.type);
+				writer.WriteCoord(item.coord);
+			}
+			writer.WriteCoord(player.base_pos_);
+			writer.WriteVarint(player.score_);
+			writer.WriteDouble(player.no_move_time_);
+			writer.WriteU8(player.is_left_game_ ? 1 : 0);
+			writer.WriteU8(player.join_time_.has_value() ? 1 : 0);
+			writer.WriteDouble(player.join_time_.value_or(0.0));
+		}
+
+		model::Player ReadPlayer(BinaryReader& reader, const std::string& map_name) {
+			model::Player player;
+			player.pos_ = reader.ReadCoord();
+			player.speed_ = reader.ReadCoord();
+			player.direction_ = static_cast<model::Direction>(reader.ReadU8());
+			player.id_ = reader.ReadVarint();
+			player.map_name_ = map_name;
+			player.name_ = reader.ReadString();
+			player.hash_ = reader.ReadString();
+			for (uint64_t i = 0, bag_size = reader.ReadVarint(); i < bag_size; ++i) {
+				model::LootWithId item;
+				item.id = reader.ReadVarint();
+				item.type = reader.ReadVarint();
+				item.coord = reader.ReadCoord();
+				player.bag_.push_back(item);
+			}
+			player.base_pos_ = reader.ReadCoord();
+			player.score_ = reader.ReadVarint();
+			player.no_move_time_ = reader.ReadDouble();
+			player.is_left_game_ = reader.ReadU8() != 0;
+			const bool has_join_time = reader.ReadU8() != 0;
+			const double join_time = reader.ReadDouble();
+			if (has_join_time) {
+				player.join_time_ = join_time;
+			}
+			return player;
+		}
+
+		std::string EncodeTokens(const model::GameRepr& game_repr) {
+			std::string payload;
+			BinaryWriter writer{ payload };
+			writer.WriteVarint(game_repr.hash_to_palyer_id.size());
+			for (const auto& [hash, id] : game_repr.hash_to_palyer_id) {
+				writer.WriteString(hash);
+				writer.WriteVarint(id);
+			}
+			writer.WriteVarint(game_repr.hash_to_map_name.size());
+			for (const auto& [hash, map_name] : game_repr.hash_to_map_name) {
+				writer.WriteString(hash);
+				writer.WriteString(map_name);
+			}
+			writer.WriteVarint(game_repr.palyer_id_to_player_name.size());
+			for (const auto& [id, name] : game_repr.palyer_id_to_player_name) {
+				writer.WriteVarint(id);
+				writer.WriteString(name);
+			}
+			return payload;
+		}
+
+		void DecodeTokens(std::string_view payload, model::GameRepr& game_repr) {
+			BinaryReader reader{ payload };
+			for (uint64_t i = 0, count = reader.ReadVarint(); i < count; ++i) {
+				auto hash = reader.ReadString();
+				game_repr.hash_to_palyer_id[std::move(hash)] = reader.ReadVarint();
+			}
+			for (uint64_t i = 0, count = reader.ReadVarint(); i < count; ++i) {
+				auto hash = reader.ReadString();
+				game_repr.hash_to_map_name[std::move(hash)] = reader.ReadString();
+			}
+			for (uint64_t i = 0, count = reader.ReadVarint(); i < count; ++i) {
+				const uint64_t id = reader.ReadVarint();
+				game_repr.palyer_id_to_player_name[id] = reader.ReadString();
+			}
+		}
+
+		std::string EncodeMap(const std::string& map_name, const std::deque<model::Player>* players,
+			const std::deque<model::Loot>* loot) {
+			std::string payload;
+			BinaryWriter writer{ payload };
+			writer.WriteString(map_name);
+			// игроки и лут лежат подряд, без разделителей между записями
+			writer.WriteVarint(players != nullptr ? players->size() : 0);
+			if (players != nullptr) {
+				for (const auto& player : *players) {
+					WritePlayer(player, writer);
+				}
+			}
+			writer.WriteVarint(loot != nullptr ? loot->size() : 0);
+			if (loot != nullptr) {
+				for (const auto& item : *loot) {
+					writer.WriteVarint(item.type);
+					writer.WriteCoord(item.coord);
+				}
+			}
+			return payload;
+		}
+
+		// Игроки и лут одной карты, прочитанные из раздела MAP
+		struct MapState {
+			std::string map_name;
+			std::deque<model::Player> players;
+			std::deque<model::Loot> loot;
+		};
+
+		MapState DecodeMap(std::string_view payload) {
+			BinaryReader reader{ payload };
+			MapState state;
+			state.map_name = reader.ReadString();
+
+			const uint64_t players_count = reader.ReadVarint();
+			for (uint64_t i = 0; i < players_count; ++i) {
+				state.players.push_back(ReadPlayer(reader, state.map_name));
+			}
+
+			const uint64_t loot_count = reader.ReadVarint();
+			for (uint64_t i = 0; i < loot_count; ++i) {
+				model::Loot item;
+				item.type = reader.ReadVarint();
+				item.coord = reader.ReadCoord();
+				state.loot.push_back(item);
+			}
+			return state;
+		}
+
+		/// @brief вызов fn(i) для всех i из [0, count), индексы распределяются по потокам
+		void ParallelFor(size_t count, const std::function<void(size_t)>& fn) {
+			const size_t workers = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+			if (workers <= 1) {
+				for (size_t i = 0; i < count; ++i) {
+					fn(i);
+				}
+				return;
+			}
+
+			std::vector<std::future<void>> results;
+			results.reserve(workers);
+			for (size_t worker = 0; worker < workers; ++worker) {
+				results.push_back(std::async(std::launch::async, [&fn, count, worker, workers] {
+					for (size_t i = worker; i < count; i += workers) {
+						fn(i);
+					}
+				}));
+			}
+			// ошибка в любом потоке прерывает всю операцию
+			for (auto& result : results) {
+				result.get();
+			}
+		}
+
+		/// @brief разбор разделов MAP; карты разбираются параллельно
+		std::vector<MapState> DecodeMaps(const std::vector<std::string_view>& payloads) {
+			std::vector<MapState> states(payloads.size());
+			ParallelFor(payloads.size(), [&payloads, &states](size_t i) {
+				states[i] = DecodeMap(payloads[i]);
+			});
+			return states;
+		}
+
+		/// @brief карты, на которых есть игроки или лут, в порядке имён
+		std::set<std::string> CollectMapNames(const model::GameRepr& game_repr) {
+			std::set<std::string> map_names;
+			for (const auto& [map_name, players] : game_repr.map_name_to_players) {
+				map_names.insert(map_name);
+			}
+			for (const auto& [map_name, loot] : game_repr.map_name_to_loot) {
+				map_names.insert(map_name);
+			}
+			return map_names;
+		}
+
+		std::string EncodeMapOf(const model::GameRepr& game_repr, const std::string& map_name) {
+			auto players = game_repr.map_name_to_players.find(map_name);
+			auto loot = game_repr.map_name_to_loot.find(map_name);
+			return EncodeMap(map_name,
+				players != game_repr.map_name_to_players.end() ? &players->second : nullptr,
+				loot != game_repr.map_name_to_loot.end() ? &loot->second : nullptr);
+		}
+
+		// Часть разбитого по картам снимка
+		struct ShardEntry {
+			// TOKENS или MAP
+			SectionTag tag{ SectionTag::MAP };
+			std::string map_name;
+			// имя файла в каталоге манифеста
+			std::string file_name;
+			uint64_t size{ 0 };
+			uint32_t crc{ 0 };
+		};
+
+		// Манифест: [сигнатура][версия u32][поколение][сегмент журнала][части][crc32 всего предыдущего]
+		struct Manifest {
+			// номер записи снимка, входит в имена файлов частей
+			uint64_t generation{ 0 };
+			uint64_t log_segment{ 0 };
+			std::vector<ShardEntry> shards;
+		};
+
+		bool IsManifest(std::string_view data) {
+			return data.substr(0, MANIFEST_MAGIC.size()) == MANIFEST_MAGIC;
+		}
+
+		std::string EncodeManifest(const Manifest& manifest) {
+			std::string out;
+			out.append(MANIFEST_MAGIC);
+			BinaryWriter writer{ out };
+			writer.WriteU32(MANIFEST_VERSION);
+			writer.WriteVarint(manifest.generation);
+			writer.WriteVarint(manifest.log_segment);
+			writer.WriteVarint(manifest.shards.size());
+			for (const auto& shard : manifest.shards) {
+				writer.WriteU32(static_cast<uint32_t>(shard.tag));
+				writer.WriteString(shard.map_name);
+				writer.WriteString(shard.file_name);
+				writer.WriteU64(shard.size);
+				writer.WriteU32(shard.crc);
+			}
+			writer.WriteU32(Crc32(out));
+			return out;
+		}
+
+		Manifest DecodeManifest(std::string_view data) {
+			if (!IsManifest(data) || data.size() < MANIFEST_MAGIC.size() + 4) {
+				throw std::runtime_error("Not a snapshot manifest");
+			}
+			const std::string_view body = data.substr(0, data.size() - 4);
+			if (BinaryReader{ data.substr(body.size()) }.ReadU32() != Crc32(body)) {
+				throw std::runtime_error("Corrupted snapshot manifest");
+			}
+			BinaryReader reader{ body.substr(MANIFEST_MAGIC.size()) };
+			const uint32_t version = reader.ReadU32();
+			if (version > MANIFEST_VERSION) {
+				throw std::runtime_error("Unsupported manifest version: "s + std::to_string(version));
+			}
+			Manifest manifest;
+			manifest.generation = reader.ReadVarint();
+			manifest.log_segment = reader.ReadVarint();
+			for (uint64_t i = 0, count = reader.ReadVarint(); i < count; ++i) {
+				ShardEntry shard;
+				shard.tag = static_cast<SectionTag>(reader.ReadU32());
+				shard.map_name = reader.ReadString();
+				shard.file_name = reader.ReadString();
+				shard.size = reader.ReadU64();
+				shard.crc = reader.ReadU32();
+				manifest.shards.push_back(std::move(shard));
+			}
+			return manifest;
+		}
+
+		/// @brief часть снимка - двоичный снимок из одного раздела
+		std::string EncodeShard(SectionTag tag, std::string_view payload) {
+			std::string out;
+			out.append(BINARY_MAGIC);
+			BinaryWriter{ out }.WriteU32(BINARY_VERSION);
+			WriteSection(tag, payload, out);
+			return out;
+		}
+
+		// Буфер потока поверх уже загруженных данных, без копирования
+		class ViewBuf : public std::streambuf {
+		public:
+			explicit ViewBuf(std::string_view data) {
+				char* begin = const_cast<char*>(data.data());
+				setg(begin, begin, begin + data.size());
+			}
+		};
+
+		/// @brief данные снимка без сжатия: сжатые распаковываются в buffer.
+		/// Разделы двоичного снимка разбираются как string_view поверх непрерывных данных,
+		/// поэтому сжатый снимок читается через одну копию, выделяемую сразу нужного размера
+		std::string_view Uncompressed(std::string_view data, std::string& buffer) {
+			if (!IsCompressed(data)) {
+				return data;
+			}
+			// последние 4 байта gzip - размер несжатых данных по модулю 2^32; это только подсказка,
+			// поэтому размер, невозможный при такой длине сжатых данных, не используется
+			constexpr size_t GZIP_SIZE_TRAILER = 4;
+			constexpr size_t MAX_DEFLATE_RATIO = 1032;
+			if (data.size() > GZIP_SIZE_TRAILER) {
+				const uint32_t size_hint = BinaryReader{ data.substr(data.size() - GZIP_SIZE_TRAILER) }.ReadU32();
+				if (size_hint / MAX_DEFLATE_RATIO <= data.size()) {
+					buffer.reserve(size_hint);
+				}
+			}
+			boost::iostreams::filtering_istream stream;
+			stream.push(boost::iostreams::gzip_decompressor());
+			stream.push(boost::iostreams::array_source(data.data(), data.size()));
+			boost::iostreams::copy(stream, boost::iostreams::back_inserter(buffer));
+			return buffer;
+		}
+
+		std::filesystem::path DirectoryOf(const std::filesystem::path& path) {
+			return path.has_parent_path() ? path.parent_path() : std::filesystem::path{ "."s };
+		}
+
+		/// @brief запись файла целиком с заменой содержимого
+		void WriteWholeFile(const std::filesystem::path& path, std::string_view data, bool sync) {
+			const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if (fd < 0) {
+				throw std::invalid_argument("Open to state file to save error");
+			}
+			try {
+				file_io::WriteAll(fd, data);
+			}
+			catch (const std::system_error&) {
+				::close(fd);
+				throw std::invalid_argument("Write to state file error");
+			}
+			if (sync && ::fsync(fd) != 0) {
+				::close(fd);
+				throw std::invalid_argument("Sync error: "s + path.string());
+			}
+			::close(fd);
+		}
+
+		void SyncFile(const std::filesystem::path& path) {
+			const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0) {
+				throw std::invalid_argument("Open to sync error: "s + path.string());
+			}
+			const int result = ::fsync(fd);
+			::close(fd);
+			if (result != 0) {
+				throw std::invalid_argument("Sync error: "s + path.string());
+			}
+		}
+
+		/// @brief путь к сохранённой копии снимка: 1 - предыдущий снимок, 2 - снимок до него и т.д.
+		std::filesystem::path RetainedPath(const std::filesystem::path& path, size_t index) {
+			return path.string() + "."s + std::to_string(index);
+		}
+
+		/// @brief манифест по пути path; пустой, если файла нет или это снимок в одном файле
+		Manifest ReadManifest(const std::filesystem::path& path) {
+			try {
+				const MappedFile file{ path };
+				if (file.Exists() && IsManifest(file.View())) {
+					return DecodeManifest(file.View());
+				}
+			}
+			catch (const std::exception& ex) {
+				logger::LogError("snapshot"sv, ex.what());
+			}
+			return {};
+		}
+
+		/// @brief снимок, вытесняемый новым: текущий без хранения копий, иначе самая старая копия
+		std::filesystem::path DroppedPath(const std::filesystem::path& path, size_t keep_previous) {
+			return keep_previous == 0 ? path : RetainedPath(path, keep_previous);
+		}
+
+		/// @brief сдвиг копий перед заменой снимка: path.(N-1) -> path.N, ..., path.1 -> path.2,
+		/// а текущий снимок становится path.1 через жёсткую ссылку, так что файл по пути path
+		/// не пропадает до rename нового снимка. Ошибки копий только логируются
+		void RotateRetained(const std::filesystem::path& path, size_t keep_previous) {
+			std::error_code ec;
+			if (keep_previous == 0 || !std::filesystem::exists(path, ec)) {
+				return;
+			}
+			for (size_t i = keep_previous - 1; i > 0; --i) {
+				if (std::filesystem::exists(RetainedPath(path, i), ec)) {
+					std::filesystem::rename(RetainedPath(path, i), RetainedPath(path, i + 1), ec);
+					if (ec) {
+						logger::LogError("snapshot"sv, "Rotate "s + RetainedPath(path, i).string() + ": "s + ec.message());
+					}
+				}
+			}
+			const auto previous = RetainedPath(path, 1);
+			std::filesystem::remove(previous, ec);
+			std::filesystem::create_hard_link(path, previous, ec);
+			if (ec) {
+				// файловая система без жёстких ссылок
+				std::filesystem::copy_file(path, previous, std::filesystem::copy_options::overwrite_existing, ec);
+			}
+			if (ec) {
+				logger::LogError("snapshot"sv, "Keep "s + previous.string() + ": "s + ec.message());
+			}
+		}
+
+		/// @brief удаление частей снимка, на который больше не ссылается ни один манифест
+		void RemoveShards(const std::filesystem::path& dir, const Manifest& manifest) {
+			for (const auto& shard : manifest.shards) {
+				std::error_code ec;
+				std::filesystem::remove(dir / shard.file_name, ec);
+			}
+		}
+	}  // namespace
+
+	model::SnapshotFormat ParseFormat(std::string_view format) {
+		if (format == Literals::FORMAT_TEXT) {
+			return model::SnapshotFormat::TEXT;
+		}
+		if (format == Literals::FORMAT_BINARY) {
+			return model::SnapshotFormat::BINARY;
+		}
+		if (format == Literals::FORMAT_SHARDED) {
+			return model::SnapshotFormat::SHARDED;
+		}
+		throw std::invalid_argument("Unknown state format: "s + std::string(format));
+	}
+
+	void Save(const model::GameRepr& game_repr, model::SnapshotFormat format, std::ostream& out,
+		int compression_level) {
+		if (format == model::SnapshotFormat::SHARDED) {
+			throw std::invalid_argument("Sharded snapshot is written by WriteFile");
+		}
+		if (compression_level != NO_COMPRESSION) {
+			// снимок сжимается по мере сериализации, без промежуточной несжатой копии
+			boost::iostreams::filtering_ostream stream;
+			stream.push(boost::iostreams::gzip_compressor(boost::iostreams::gzip_params(compression_level)));
+			stream.push(out);
+			Save(game_repr, format, stream);
+			return;
+		}
+		if (format == model::SnapshotFormat::BINARY) {
+			const std::string data = EncodeBinary(game_repr);
+			out.write(data.data(), static_cast<std::streamsize>(data.size()));
+			return;
+		}
+		boost::archive::text_oarchive oa{ out };
+		oa << game_repr;
+	}
+
+	void Load(std::string_view data, model::GameRepr& game_repr) {
+		std::string buffer;
+		data = Uncompressed(data, buffer);
+		if (IsBinary(data)) {
+			return DecodeBinary(data, game_repr);
+		}
+		// снимки в текстовом формате Boost.Serialization, сохранённые прежними версиями
+		ViewBuf buf{ data };
+		std::istream in{ &buf };
+		boost::archive::text_iarchive ia{ in };
+		ia >> game_repr;
+	}
+
+	bool IsBinary(std::string_view data) {
+		return data.substr(0, BINARY_MAGIC.size()) == BINARY_MAGIC;
+	}
+
+	bool IsCompressed(std::string_view data) {
+		return data.substr(0, GZIP_MAGIC.size()) == GZIP_MAGIC;
+	}
+
+	std::string EncodeBinary(const model::GameRepr& game_repr) {
+		std::string out;
+		out.append(BINARY_MAGIC);
+		BinaryWriter writer{ out };
+		writer.WriteU32(BINARY_VERSION);
+
+		WriteSection(SectionTag::TOKENS, EncodeTokens(game_repr), out);
+
+		for (const auto& map_name : CollectMapNames(game_repr)) {
+			WriteSection(SectionTag::MAP, EncodeMapOf(game_repr, map_name), out);
+		}
+
+		if (game_repr.log_segment != 0) {
+			std::string payload;
+			BinaryWriter{ payload }.WriteVarint(game_repr.log_segment);
+			WriteSection(SectionTag::ACTION_LOG, payload, out);
+		}
+		return out;
+	}
+
+	void DecodeBinary(std::string_view data, model::GameRepr& game_repr) {
+		if (!IsBinary(data)) {
+			throw std::runtime_error("Not a binary snapshot");
+		}
+		BinaryReader reader{ data.substr(BINARY_MAGIC.size()) };
+		const uint32_t version = reader.ReadU32();
+		if (version > BINARY_VERSION) {
+			throw std::runtime_error("Unsupported snapshot version: "s + std::to_string(version));
+		}
+
+		std::vector<std::string_view> map_payloads;
+		while (!reader.AtEnd()) {
+			const auto tag = static_cast<SectionTag>(reader.ReadU32());
+			const uint64_t size = reader.ReadU64();
+			const std::string_view payload = reader.Take(size);
+			switch (tag) {
+			case SectionTag::TOKENS:
+				DecodeTokens(payload, game_repr);
+				break;
+			case SectionTag::MAP:
+				// разделы карт независимы, разбираются после обхода всех разделов
+				map_payloads.push_back(payload);
+				break;
+			case SectionTag::ACTION_LOG:
+				game_repr.log_segment = BinaryReader{ payload }.ReadVarint();
+				break;
+			default:
+				// раздел из более новой версии формата
+				break;
+			}
+		}
+
+		for (auto& state : DecodeMaps(map_payloads)) {
+			if (!state.players.empty()) {
+				game_repr.map_name_to_players[state.map_name] = std::move(state.players);
+			}
+			game_repr.map_name_to_loot[std::move(state.map_name)] = std::move(state.loot);
+		}
+	}
+
+	MappedFile::MappedFile(const std::filesystem::path& path) {
+		fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd_ < 0) {
+			if (errno == ENOENT) {
+				return;
+			}
+			throw std::invalid_argument("Open to state file to load error");
+		}
+		struct stat st {};
+		if (::fstat(fd_, &st) != 0) {
+			::close(fd_);
+			throw std::invalid_argument("Stat state file error");
+		}
+		exists_ = true;
+		size_ = static_cast<size_t>(st.st_size);
+		if (size_ == 0) {
+			return;
+		}
+		void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+		if (data == MAP_FAILED) {
+			::close(fd_);
+			throw std::invalid_argument("Map state file error");
+		}
+		// файл читается один раз от начала до конца. Значения madvise не битовые флаги,
+		// каждое передаётся отдельным вызовом; отказ ядра не мешает чтению
+		for (const int advice : { MADV_SEQUENTIAL, MADV_WILLNEED }) {
+			if (::madvise(data, size_, advice) != 0) {
+				logger::LogError("snapshot"sv, "madvise error: "s + std::strerror(errno));
+			}
+		}
+		data_ = static_cast<const char*>(data);
+	}
+
+	MappedFile::~MappedFile() {
+		if (data_ != nullptr) {
+			::munmap(const_cast<char*>(data_), size_);
+		}
+		if (fd_ >= 0) {
+			::close(fd_);
+		}
+	}
+
+	bool LoadFile(const std::filesystem::path& path, model::GameRepr& game_repr) {
+		const MappedFile file{ path };
+		if (!file.Exists()) {
+			return false;
+		}
+		if (!IsManifest(file.View())) {
+			Load(file.View(), game_repr);
+			return true;
+		}
+
+		// части читаются параллельно, каждая проверяется по размеру и crc32 из манифеста
+		const Manifest manifest = DecodeManifest(file.View());
+		std::vector<model::GameRepr> parts(manifest.shards.size());
+		ParallelFor(parts.size(), [&manifest, &parts, dir = DirectoryOf(path)](size_t i) {
+			const auto& shard = manifest.shards[i];
+			const MappedFile shard_file{ dir / shard.file_name };
+			const auto data = shard_file.View();
+			if (!shard_file.Exists() || data.size() != shard.size || Crc32(data) != shard.crc) {
+				throw std::runtime_error("Corrupted snapshot shard: "s + shard.file_name);
+			}
+			std::string buffer;
+			DecodeBinary(Uncompressed(data, buffer), parts[i]);
+		});
+
+		for (auto& part : parts) {
+			game_repr.hash_to_palyer_id.merge(part.hash_to_palyer_id);
+			game_repr.hash_to_map_name.merge(part.hash_to_map_name);
+			game_repr.palyer_id_to_player_name.merge(part.palyer_id_to_player_name);
+			for (auto& [map_name, players] : part.map_name_to_players) {
+				game_repr.map_name_to_players[map_name] = std::move(players);
+			}
+			for (auto& [map_name, loot] : part.map_name_to_loot) {
+				game_repr.map_name_to_loot[map_name] = std::move(loot);
+			}
+		}
+		game_repr.log_segment = manifest.log_segment;
+		return true;
+	}
+
+	void WriteSharded(const model::GameRepr& game_repr, const WriteOptions& options, const std::filesystem::path& path) {
+		const size_t keep_previous = options.keep_previous;
+		const auto dir = DirectoryOf(path);
+		// после записи контрольной точки сегменты журнала действий удаляются,
+		// поэтому части и манифест должны быть на диске
+		const bool sync = game_repr.log_segment != 0;
+
+		// номер поколения больше, чем у текущего манифеста и сохранённых копий; части нового
+		// поколения не затирают файлы, на которые они ссылаются
+		uint64_t generation = 0;
+		for (size_t i = 0; i <= keep_previous; ++i) {
+			generation = std::max(generation, ReadManifest(i == 0 ? path : RetainedPath(path, i)).generation);
+		}
+		const Manifest dropped = ReadManifest(DroppedPath(path, keep_previous));
+
+		Manifest manifest;
+		manifest.generation = generation + 1;
+		manifest.log_segment = game_repr.log_segment;
+		const std::string prefix = path.filename().string() + "."s + std::to_string(manifest.generation) + "."s;
+		manifest.shards.push_back({ SectionTag::TOKENS, {}, prefix + "tokens"s });
+		for (const auto& map_name : CollectMapNames(game_repr)) {
+			manifest.shards.push_back({ SectionTag::MAP, map_name, prefix + std::to_string(manifest.shards.size()) });
+		}
+
+		ParallelFor(manifest.shards.size(), [&game_repr, &manifest, &dir, sync, &options](size_t i) {
+			auto& shard = manifest.shards[i];
+			std::string data = shard.tag == SectionTag::TOKENS
+				? EncodeShard(SectionTag::TOKENS, EncodeTokens(game_repr))
+				: EncodeShard(SectionTag::MAP, EncodeMapOf(game_repr, shard.map_name));
+			// части сжимаются по отдельности и параллельно; манифест не сжимается
+			if (options.compression_level != NO_COMPRESSION) {
+				data = content_encoding::Gzip(data, options.compression_level);
+			}
+			shard.size = data.size();
+			shard.crc = Crc32(data);
+			WriteWholeFile(dir / shard.file_name, data, sync);
+		});
+
+		// снимок фиксируется атомарной заменой манифеста
+		std::filesystem::path temp_path{ path };
+		temp_path += "_tmp"s;
+		WriteWholeFile(temp_path, EncodeManifest(manifest), sync);
+		RotateRetained(path, keep_previous);
+		try {
+			std::filesystem::rename(temp_path, path);
+		}
+		catch (...) {
+			throw std::invalid_argument("Rename error");
+		}
+		if (sync) {
+			SyncFile(dir);
+		}
+
+		RemoveShards(dir, dropped);
+	}
+
+	void WriteFile(const model::GameRepr& game_repr, const WriteOptions& options, const std::filesystem::path& path) {
+		if (options.format == model::SnapshotFormat::SHARDED) {
+			return WriteSharded(game_repr, options, path);
+		}
+		// вытесняемая копия могла быть записана в формате sharded
+		const Manifest dropped = ReadManifest(DroppedPath(path, options.keep_previous));
+
+		std::filesystem::path temp_path{ path };
+		temp_path += "_tmp"s;
+
+		std::ofstream state_file{ temp_path, std::ios::binary };
+		if (!state_file) {
+			throw std::invalid_argument("Open to state file to save error");
+		}
+		Save(game_repr, options.format, state_file, options.compression_level);
+		state_file.close();
+		if (!state_file) {
+			throw std::invalid_argument("Write to state file error");
+		}
+		// после записи контрольной точки сегменты журнала действий удаляются,
+		// поэтому снимок должен быть на диске до rename
+		if (game_repr.log_segment != 0) {
+			SyncFile(temp_path);
+		}
+		RotateRetained(path, options.keep_previous);
+		try {
+			std::filesystem::rename(temp_path, path);
+		}
+		catch (...) {
+			throw std::invalid_argument("Rename error");
+		}
+		if (game_repr.log_segment != 0) {
+			SyncFile(DirectoryOf(path));
+		}
+
+		RemoveShards(DirectoryOf(path), dropped);
+	}
+
+	BackgroundWriter::BackgroundWriter()
+		: thread_([this] { Run(); }) {
+	}
+
+	BackgroundWriter::~BackgroundWriter() {
+		{
+			std::lock_guard lock{ mtx_ };
+			stop_ = true;
+		}
+		cond_var_.notify_all();
+		thread_.join();
+	}
+
+	void BackgroundWriter::Submit(std::shared_ptr<const model::GameRepr> game_repr, const WriteOptions& options,
+		std::filesystem::path path, std::function<void()> on_written) {
+		std::optional<Job> replaced;
+		{
+			std::lock_guard lock{ mtx_ };
+			// вытесненная копия освобождается после снятия блокировки
+			replaced = std::exchange(pending_, Job{ std::move(game_repr), options, std::move(path), std::move(on_written) });
+		}
+		cond_var_.notify_all();
+	}
+
+	bool BackgroundWriter::Idle() {
+		std::lock_guard lock{ mtx_ };
+		return !pending_ && !busy_;
+	}
+
+	void BackgroundWriter::Flush() {
+		std::unique_lock lock{ mtx_ };
+		cond_var_.wait(lock, [this] { return !pending_ && !busy_; });
+	}
+
+	void BackgroundWriter::Run() {
+		std::unique_lock lock{ mtx_ };
+		while (true) {
+			cond_var_.wait(lock, [this] { return stop_ || pending_; });
+			if (!pending_) {
+				// остановка, всё переданное уже записано
+				return;
+			}
+			Job job = std::move(*pending_);
+			pending_.reset();
+			busy_ = true;
+			lock.unlock();
+
+			try {
+				WriteFile(*job.game_repr, job.options, job.path);
+				if (job.on_written) {
+					job.on_written();
+				}
+			}
+			catch (const std::exception& ex) {
+				logger::LogError("snapshot"sv, ex.what());
+			}
+			// копия состояния освобождается здесь, а не в потоке тика
+			job.game_repr.reset();
+
+			lock.lock();
+			busy_ = false;
+			cond_var_.notify_all();
+		}
+	}
+
+}  // namespace snapshot
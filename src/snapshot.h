@@ -0,0 +1,192 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "model.h"
+
+namespace snapshot {
+	using namespace std::literals;
+
+	struct Literals {
+		Literals() = delete;
+		// Значения опции --state-format
+		constexpr static std::string_view FORMAT_TEXT = "text"sv;
+		constexpr static std::string_view FORMAT_BINARY = "binary"sv;
+		constexpr static std::string_view FORMAT_SHARDED = "sharded"sv;
+	};
+
+	// Сигнатура двоичного снимка, с неё начинается файл
+	constexpr std::string_view BINARY_MAGIC = "GSNAPBIN"sv;
+	// Версия двоичного формата, увеличивается при несовместимых изменениях
+	constexpr uint32_t BINARY_VERSION = 1;
+
+	// Сжатые снимки и части снимков - потоки gzip, распознаются по его сигнатуре
+	constexpr std::string_view GZIP_MAGIC = "\x1f\x8b"sv;
+	// Уровень сжатия, при котором снимок пишется без сжатия
+	constexpr int NO_COMPRESSION = 0;
+
+	// Сигнатура манифеста разбитого по картам снимка. Манифест лежит по пути файла состояния
+	// и перечисляет файлы частей: токены и по файлу на каждую карту. Каждая часть - двоичный
+	// снимок, который читается и отдельно
+	constexpr std::string_view MANIFEST_MAGIC = "GSNAPMAN"sv;
+	constexpr uint32_t MANIFEST_VERSION = 1;
+
+	// Разделы двоичного снимка. Раздел: [тег u32][длина u64][данные], неизвестные разделы пропускаются
+	enum class SectionTag : uint32_t {
+		// токены игроков: hash_to_palyer_id, hash_to_map_name, palyer_id_to_player_name
+		TOKENS = 1,
+		// игроки и лут одной карты
+		MAP = 2,
+		// номер первого сегмента журнала действий, не вошедшего в снимок
+		ACTION_LOG = 3,
+	};
+
+	// Параметры записи снимка в файл
+	struct WriteOptions {
+		model::SnapshotFormat format{ model::SnapshotFormat::BINARY };
+		// сколько предыдущих снимков хранить рядом: <path>.1 (последний), <path>.2, ...
+		size_t keep_previous{ 0 };
+		// уровень сжатия zlib от 1 (быстрее) до 9 (меньше) или NO_COMPRESSION
+		int compression_level{ NO_COMPRESSION };
+	};
+
+	/// @brief разбор значения опции --state-format
+	/// @param format text, binary или sharded
+	/// @return формат снимка
+	model::SnapshotFormat ParseFormat(std::string_view format);
+
+	/// @brief запись снимка состояния игры в один поток
+	/// @param game_repr состояние игры
+	/// @param format формат снимка, кроме SHARDED
+	/// @param out поток для записи
+	/// @param compression_level уровень сжатия gzip или NO_COMPRESSION
+	void Save(const model::GameRepr& game_repr, model::SnapshotFormat format, std::ostream& out,
+		int compression_level = NO_COMPRESSION);
+
+	/// @brief чтение снимка состояния игры, формат и сжатие определяются по сигнатуре
+	/// @param data содержимое файла снимка
+	/// @param game_repr прочитанное состояние игры
+	void Load(std::string_view data, model::GameRepr& game_repr);
+
+	/// @brief данные начинаются с сигнатуры двоичного снимка?
+	bool IsBinary(std::string_view data);
+
+	/// @brief данные сжаты gzip?
+	bool IsCompressed(std::string_view data);
+
+	/// @brief двоичный снимок состояния игры
+	/// @param game_repr состояние игры
+	/// @return содержимое файла снимка
+	std::string EncodeBinary(const model::GameRepr& game_repr);
+
+	/// @brief разбор двоичного снимка
+	/// @param data содержимое файла снимка
+	/// @param game_repr прочитанное состояние игры
+	void DecodeBinary(std::string_view data, model::GameRepr& game_repr);
+
+	/// @brief Файл снимка, отображённый в память только для чтения
+	class MappedFile {
+	public:
+		/// @param path путь к файлу; отсутствие файла не ошибка
+		explicit MappedFile(const std::filesystem::path& path);
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile();
+
+		bool Exists() const noexcept {
+			return exists_;
+		}
+
+		std::string_view View() const noexcept {
+			return { data_ != nullptr ? data_ : "", size_ };
+		}
+
+	private:
+		int fd_{ -1 };
+		const char* data_{ nullptr };
+		size_t size_{ 0 };
+		bool exists_{ false };
+	};
+
+	/// @brief чтение снимка из файла через отображение в память; карты двоичного снимка
+	/// и части снимка, разбитого по картам, разбираются параллельно
+	/// @param path путь к файлу состояния
+	/// @param game_repr прочитанное состояние игры
+	/// @return false - файла нет
+	bool LoadFile(const std::filesystem::path& path, model::GameRepr& game_repr);
+
+	/// @brief запись снимка в файл: во временный файл рядом с path, затем rename на path.
+	/// Для SHARDED части пишутся параллельно, а снимок фиксируется rename манифеста.
+	/// Предыдущие снимки хранятся рядом как path.1 (последний), path.2, ..., path.keep_previous
+	/// @param game_repr состояние игры
+	/// @param options формат, сжатие и число хранимых снимков
+	/// @param path путь к файлу состояния
+	void WriteFile(const model::GameRepr& game_repr, const WriteOptions& options, const std::filesystem::path& path);
+
+	/// @brief запись снимка, разбитого по картам: части пишутся и сжимаются параллельно, затем
+	/// атомарно заменяется манифест по пути path, и удаляются части вытесненного снимка
+	/// @param game_repr состояние игры
+	/// @param options сжатие частей и число хранимых манифестов вместе с их частями
+	/// @param path путь к манифесту
+	void WriteSharded(const model::GameRepr& game_repr, const WriteOptions& options, const std::filesystem::path& path);
+
+	/// @brief Запись снимков в отдельном потоке.
+	/// Тик только снимает копию состояния и передаёт её сюда; сериализация, запись и rename
+	/// выполняются в фоне. Если предыдущий снимок ещё не начал записываться, он заменяется новым
+	class BackgroundWriter {
+	public:
+		BackgroundWriter();
+
+		BackgroundWriter(const BackgroundWriter&) = delete;
+		BackgroundWriter& operator=(const BackgroundWriter&) = delete;
+
+		/// @brief дописывает последний переданный снимок и останавливает поток
+		~BackgroundWriter();
+
+		/// @brief передать снимок на запись
+		/// @param game_repr копия состояния игры
+		/// @param options параметры записи
+		/// @param path путь к файлу состояния
+		/// @param on_written вызывается в потоке записи после успешной записи снимка
+		void Submit(std::shared_ptr<const model::GameRepr> game_repr, const WriteOptions& options,
+			std::filesystem::path path, std::function<void()> on_written = {});
+
+		/// @brief нет ни записываемого, ни ожидающего снимка
+		bool Idle();
+
+		/// @brief дождаться записи всех переданных снимков
+		void Flush();
+
+	private:
+		struct Job {
+			std::shared_ptr<const model::GameRepr> game_repr;
+			WriteOptions options;
+			std::filesystem::path path;
+			std::function<void()> on_written;
+		};
+
+		void Run();
+
+		std::mutex mtx_;
+		std::condition_variable cond_var_;
+		// снимок, ожидающий записи
+		std::optional<Job> pending_;
+		// снимок записывается прямо сейчас
+		bool busy_{ false };
+		bool stop_{ false };
+		std::thread thread_;
+	};
+
+}  // namespace snapshot
@@ -0,0 +1,94 @@
+#include "state_encoding.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "binary_io.h"
+
+namespace state_encoding {
+
+	namespace {
+		void WriteQuantized(binary_io::BinaryWriter& writer, double value) {
+			writer.WriteU32(static_cast<uint32_t>(static_cast<int32_t>(std::lround(value * COORD_SCALE))));
+		}
+
+		void WriteQuantized(binary_io::BinaryWriter& writer, const model::FloatCoord& coord) {
+			WriteQuantized(writer, coord.x);
+			WriteQuantized(writer, coord.y);
+		}
+
+		model::FloatCoord ReadQuantized(binary_io::BinaryReader& reader) {
+			model::FloatCoord coord;
+			coord.x = static_cast<int32_t>(reader.ReadU32()) / COORD_SCALE;
+			coord.y = static_cast<int32_t>(reader.ReadU32()) / COORD_SCALE;
+			return coord;
+		}
+	}  // namespace
+
+	std::string EncodeState(const std::deque<model::Player>& players, const std::deque<model::Loot>& loot) {
+		std::string out;
+		// id, две пары координат, направление и очки игрока с коротким рюкзаком
+		out.reserve(2 + players.size() * 24 + loot.size() * 10);
+		binary_io::BinaryWriter writer{ out };
+		writer.WriteU8(FORMAT_VERSION);
+
+		writer.WriteVarint(players.size());
+		for (const auto& player : players) {
+			writer.WriteVarint(player.id_);
+			WriteQuantized(writer, player.pos_);
+			WriteQuantized(writer, player.speed_);
+			writer.WriteU8(static_cast<uint8_t>(player.direction_));
+			writer.WriteVarint(player.score_);
+			writer.WriteVarint(player.bag_.size());
+			for (const auto& item : player.bag_) {
+				writer.WriteVarint(item.id);
+				writer.WriteVarint(item.type);
+			}
+		}
+
+		writer.WriteVarint(loot.size());
+		for (const auto& item : loot) {
+			writer.WriteVarint(item.type);
+			WriteQuantized(writer, item.coord);
+		}
+		return out;
+	}
+
+	void DecodeState(std::string_view data, std::deque<model::Player>& players, std::deque<model::Loot>& loot) {
+		binary_io::BinaryReader reader{ data };
+		if (reader.ReadU8() != FORMAT_VERSION) {
+			throw std::runtime_error("Unknown game state format");
+		}
+
+		for (uint64_t i = 0, count = reader.ReadVarint(); i < count; ++i) {
+			model::Player player;
+			player.id_ = reader.ReadVarint();
+			player.pos_ = ReadQuantized(reader);
+			player.speed_ = ReadQuantized(reader);
+			const uint8_t direction = reader.ReadU8();
+			if (direction != 'U' && direction != 'D' && direction != 'L' && direction != 'R') {
+				throw std::runtime_error("Unknown direction in game state");
+			}
+			player.direction_ = static_cast<model::Direction>(direction);
+			player.score_ = reader.ReadVarint();
+			for (uint64_t item = 0, bag_size = reader.ReadVarint(); item < bag_size; ++item) {
+				model::LootWithId loot_with_id;
+				loot_with_id.id = reader.ReadVarint();
+				loot_with_id.type = reader.ReadVarint();
+				player.bag_.push_back(loot_with_id);
+			}
+			players.push_back(std::move(player));
+		}
+
+		for (uint64_t i = 0, count = reader.ReadVarint(); i < count; ++i) {
+			model::Loot item;
+			item.type = reader.ReadVarint();
+			item.coord = ReadQuantized(reader);
+			loot.push_back(item);
+		}
+		if (!reader.AtEnd()) {
+			throw std::runtime_error("Trailing game state data");
+		}
+	}
+
+}  // namespace state_encoding
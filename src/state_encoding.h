@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include "model.h"
+
+namespace state_encoding {
+	using namespace std::literals;
+
+	struct Literals {
+		Literals() = delete;
+		// Тип содержимого двоичного состояния карты, выбирается заголовком Accept
+		constexpr static std::string_view CONTENT_TYPE = "application/x-game-state"sv;
+	};
+
+	// Версия двоичного формата, первый байт тела
+	constexpr uint8_t FORMAT_VERSION = 1;
+	// Координаты и скорости хранятся целыми числами в тысячных долях единицы карты
+	constexpr double COORD_SCALE = 1000.0;
+
+	/// @brief Двоичное состояние карты - замена ответа /api/v1/game/state в JSON.
+	/// [версия формата]
+	/// [число игроков] и для каждого: [id][x][y][скорость x][скорость y][направление][очки]
+	///     [число предметов в рюкзаке] и для каждого: [id][тип]
+	/// [число предметов лута] и для каждого: [тип][x][y]
+	/// id лута - его порядковый номер. Числа - varint (LEB128), кроме координат и скоростей:
+	/// они квантуются с шагом 1 / COORD_SCALE и пишутся как int32 little-endian.
+	/// Направление - байт 'U', 'D', 'L' или 'R', как в JSON
+	/// @param players игроки на карте
+	/// @param loot лут на карте
+	/// @return тело ответа
+	std::string EncodeState(const std::deque<model::Player>& players, const std::deque<model::Loot>& loot);
+
+	/// @brief разбор двоичного состояния карты; координаты восстанавливаются с точностью квантования
+	/// @param data тело ответа
+	/// @param players игроки на карте; заполняются только передаваемые поля
+	/// @param loot лут на карте
+	/// @throw std::runtime_error данные повреждены или другой версии формата
+	void DecodeState(std::string_view data, std::deque<model::Player>& players, std::deque<model::Loot>& loot);
+
+}  // namespace state_encoding
@@ -0,0 +1,164 @@
+#include "static_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+namespace static_cache {
+	using namespace std::literals;
+
+	namespace {
+		// Файл, найденный при обходе каталога
+		struct FoundFile {
+			std::string path;
+			fs::path file;
+			uintmax_t size{ 0 };
+			fs::file_time_type write_time;
+		};
+
+		/// @brief форматы, которые уже сжаты: gzip их не уменьшит, а время на сжатие уйдёт
+		bool IsCompressed(const fs::path& file) {
+			std::string extension = file.extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(),
+				[](unsigned char c) { return std::tolower(c); });
+			return extension == ".png"sv || extension == ".jpg"sv || extension == ".jpeg"sv
+				|| extension == ".gif"sv || extension == ".ico"sv || extension == ".svgz"sv
+				|| extension == ".gz"sv;
+		}
+
+		std::string MakeEtag(const FoundFile& found) {
+			std::ostringstream etag;
+			etag << '"' << std::hex << found.write_time.time_since_epoch().count()
+				<< '-' << found.size << '"';
+			return etag.str();
+		}
+
+		/// @brief содержимое файла
+		/// @return false - файл не удалось прочитать целиком
+		bool ReadFile(const fs::path& file, uintmax_t size, std::string& body) {
+			std::ifstream in{ file, std::ios::binary };
+			if (!in) {
+				return false;
+			}
+			body.resize(static_cast<size_t>(size));
+			in.read(body.data(), static_cast<std::streamsize>(body.size()));
+			// файл мог измениться между обходом и чтением
+			return in.gcount() == static_cast<std::streamsize>(body.size()) && in.peek() == std::ifstream::traits_type::eof();
+		}
+
+		/// @brief обычные файлы каталога; символические ссылки пропускаются,
+		/// чтобы кэш не отдавал файлы вне каталога
+		std::vector<FoundFile> ListFiles(const fs::path& root) {
+			std::vector<FoundFile> files;
+			std::error_code ec;
+			for (fs::recursive_directory_iterator it{ root, ec }, end; !ec && it != end; it.increment(ec)) {
+				const auto& entry = *it;
+				std::error_code entry_ec;
+				if (entry.is_symlink(entry_ec) || !entry.is_regular_file(entry_ec)) {
+					continue;
+				}
+				FoundFile found;
+				found.file = entry.path();
+				found.size = entry.file_size(entry_ec);
+				if (entry_ec) {
+					continue;
+				}
+				found.write_time = entry.last_write_time(entry_ec);
+				if (entry_ec) {
+					continue;
+				}
+				found.path = "/"s + found.file.lexically_relative(root).generic_string();
+				files.push_back(std::move(found));
+			}
+			return files;
+		}
+	}  // namespace
+
+	StaticCache::StaticCache(fs::path root, size_t max_size)
+		: root_(std::move(root))
+		, max_size_(max_size)
+		, compressor_(COMPRESSION_LEVEL, content_encoding::DEFAULT_THRESHOLD)
+		, assets_(std::make_shared<const Assets>()) {
+		Rescan();
+	}
+
+	std::shared_ptr<const Asset> StaticCache::Find(const std::string& path) const {
+		std::lock_guard<std::mutex> guard(mtx_);
+		if (auto it = assets_->find(path); it != assets_->end()) {
+			return it->second;
+		}
+		return nullptr;
+	}
+
+	void StaticCache::Rescan() {
+		if (max_size_ == 0) {
+			return;
+		}
+		std::shared_ptr<const Assets> previous;
+		{
+			std::lock_guard<std::mutex> guard(mtx_);
+			previous = assets_;
+		}
+
+		auto files = ListFiles(root_);
+		// меньшие файлы первыми: в кэш попадает больше страниц и скриптов
+		std::sort(files.begin(), files.end(), [](const FoundFile& lhs, const FoundFile& rhs) {
+			return lhs.size < rhs.size;
+		});
+
+		auto assets = std::make_shared<Assets>();
+		size_t size = 0;
+		for (const auto& found : files) {
+			if (found.size > max_size_ - size) {
+				break;
+			}
+			// неизменившийся файл не перечитывается
+			if (auto it = previous->find(found.path); it != previous->end()
+				&& it->second->write_time == found.write_time && it->second->body->size() == found.size) {
+				const size_t asset_size = it->second->body->size()
+					+ (it->second->gzip_body ? it->second->gzip_body->size() : 0);
+				if (asset_size <= max_size_ - size) {
+					size += asset_size;
+					assets->emplace(found.path, it->second);
+				}
+				continue;
+			}
+
+			std::string body;
+			if (!ReadFile(found.file, found.size, body)) {
+				continue;
+			}
+			auto asset = std::make_shared<Asset>();
+			if (!IsCompressed(found.file)) {
+				asset->gzip_body = compressor_.Compress(body);
+			}
+			asset->etag = MakeEtag(found);
+			asset->write_time = found.write_time;
+			asset->body = std::make_shared<const std::string>(std::move(body));
+			const size_t asset_size = asset->body->size() + (asset->gzip_body ? asset->gzip_body->size() : 0);
+			if (asset_size > max_size_ - size) {
+				// сжатая версия не поместилась, файл отдаётся без неё
+				asset->gzip_body = nullptr;
+				if (asset->body->size() > max_size_ - size) {
+					continue;
+				}
+			}
+			size += asset->body->size() + (asset->gzip_body ? asset->gzip_body->size() : 0);
+			assets->emplace(found.path, std::move(asset));
+		}
+
+		std::lock_guard<std::mutex> guard(mtx_);
+		assets_ = std::move(assets);
+		size_ = size;
+	}
+
+	size_t StaticCache::Size() const {
+		std::lock_guard<std::mutex> guard(mtx_);
+		return size_;
+	}
+
+}  // namespace static_cache
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "content_encoding.h"
+
+namespace static_cache {
+	namespace fs = std::filesystem;
+
+	// Файл каталога статических файлов, прочитанный в память
+	struct Asset {
+		// содержимое файла
+		std::shared_ptr<const std::string> body;
+		// сжатое gzip содержимое; nullptr - файл отдаётся без сжатия
+		std::shared_ptr<const std::string> gzip_body;
+		// значение заголовка ETag: время изменения и размер файла
+		std::string etag;
+		// время изменения файла при чтении, по нему повторный обход находит изменённые файлы
+		fs::file_time_type write_time;
+	};
+
+	/// @brief Кэш статических файлов в памяти. При старте каталог обходится один раз, файлы
+	/// читаются и сжимаются gzip, после чего запросы к ним обслуживаются без обращения к диску.
+	/// Суммарный размер исходных и сжатых тел ограничен: файлы добавляются от меньших к большим,
+	/// не поместившиеся отдаются с диска как раньше. Rescan повторяет обход и перечитывает
+	/// только файлы с изменившимися размером или временем изменения
+	class StaticCache {
+	public:
+		// Ограничение размера кэша по умолчанию, байт
+		constexpr static size_t DEFAULT_MAX_SIZE = 64 * 1024 * 1024;
+		// Файлы сжимаются один раз, поэтому используется наибольший уровень сжатия
+		constexpr static int COMPRESSION_LEVEL = 9;
+
+		/// @param root каталог статических файлов
+		/// @param max_size ограничение суммарного размера тел, 0 - кэш выключен
+		StaticCache(fs::path root, size_t max_size = DEFAULT_MAX_SIZE);
+
+		StaticCache(const StaticCache&) = delete;
+		StaticCache& operator=(const StaticCache&) = delete;
+
+		/// @brief файл из кэша
+		/// @param path путь к файлу от корня каталога, начинающийся с "/"
+		/// @return nullptr - файла нет в кэше
+		std::shared_ptr<const Asset> Find(const std::string& path) const;
+
+		/// @brief перечитать изменившиеся файлы, забыть удалённые и добавить новые.
+		/// Запросы во время обхода обслуживаются по прежнему содержимому кэша
+		void Rescan();
+
+		/// @brief суммарный размер тел в кэше, байт
+		size_t Size() const;
+
+	private:
+		using Assets = std::unordered_map<std::string, std::shared_ptr<const Asset>>;
+
+		fs::path root_;
+		size_t max_size_;
+		content_encoding::Compressor compressor_;
+
+		mutable std::mutex mtx_;
+		std::shared_ptr<const Assets> assets_;
+		size_t size_{ 0 };
+	};
+
+}  // namespace static_cache
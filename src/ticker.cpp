@@ -1,5 +1,7 @@
 #include "ticker.h"
 
+#include "random_functions.h"
+
 namespace ticker {
 	void Ticker::Start() {
 		net::dispatch(strand_, [self = shared_from_this()]{
@@ -14,7 +16,11 @@ namespace ticker {
 		}
 
 		// Таймер сработает спустя заданный интервал относительно текущего момента
-		timer_.expires_after(period_);
+		auto delay = period_;
+		if (jitter_.count() > 0) {
+			delay += std::chrono::milliseconds(random_functions::RandomIntNumber(0, static_cast<int>(jitter_.count())));
+		}
+		timer_.expires_after(delay);
 		// Таймер сработает, как только наступит заданный момент времени
 		// timer_.steady_timer::expires_at.
 
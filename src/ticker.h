@@ -21,15 +21,20 @@ namespace ticker {
 
 		Strand strand_;
 		std::chrono::milliseconds period_;
+		// к каждому периоду добавляется случайная задержка от 0 до jitter_
+		std::chrono::milliseconds jitter_;
 		net::steady_timer timer_{ strand_ };
 		Handler handler_;
 		std::chrono::steady_clock::time_point last_tick_;
 
 	public:
-		// Функция handler будет вызываться внутри strand с интервалом period
-		Ticker(Strand strand, std::chrono::milliseconds period, Handler handler)
+		// Функция handler будет вызываться внутри strand с интервалом period.
+		// Ненулевой jitter разносит во времени срабатывания таймеров с одинаковым периодом
+		Ticker(Strand strand, std::chrono::milliseconds period, Handler handler,
+			std::chrono::milliseconds jitter = std::chrono::milliseconds::zero())
 			: strand_{ strand }
 			, period_{ period }
+			, jitter_{ jitter }
 			, handler_{ std::move(handler) } {
 		}
 
@@ -0,0 +1,118 @@
+#include <filesystem>
+#include <string>
+#include <variant>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/action_log.h"
+#include "temp_dir.h"
+
+namespace {
+    using namespace std::literals;
+
+    std::vector<action_log::Record> ReplayAll(const action_log::ActionLog& log, uint64_t from_segment) {
+        std::vector<action_log::Record> records;
+        log.Replay(from_segment, [&records](const action_log::Record& record) {
+            records.push_back(record);
+        });
+        return records;
+    }
+}
+
+SCENARIO("Action log") {
+    GIVEN("encoded records") {
+        action_log::Tick tick{ 50, { { "map1"s, { 1, { 2.5, 3.0 } } } } };
+        action_log::Retire retire{ { { 7, "Rex"s, 42, 120, "0123456789abcdef0123456789abcdef"s } } };
+        std::string data;
+        action_log::EncodeRecord(tick, data);
+        action_log::EncodeRecord(retire, data);
+
+        THEN("they are decoded back") {
+            action_log::Record record;
+            const size_t tick_size = action_log::DecodeRecord(data, record);
+            REQUIRE(tick_size > 0);
+            const auto& decoded_tick = std::get<action_log::Tick>(record);
+            CHECK(decoded_tick.period_ms == 50);
+            REQUIRE(decoded_tick.loot.size() == 1);
+            CHECK(decoded_tick.loot[0].map_name == "map1"s);
+            CHECK(decoded_tick.loot[0].loot.type == 1);
+            CHECK(decoded_tick.loot[0].loot.coord.x == 2.5);
+
+            REQUIRE(action_log::DecodeRecord(std::string_view{ data }.substr(tick_size), record) > 0);
+            const auto& decoded_retire = std::get<action_log::Retire>(record);
+            REQUIRE(decoded_retire.players.size() == 1);
+            CHECK(decoded_retire.players[0].name == "Rex"s);
+            CHECK(decoded_retire.players[0].record_id == retire.players[0].record_id);
+        }
+
+        THEN("a damaged record is rejected") {
+            data[10] ^= 0x5A;
+            action_log::Record record;
+            CHECK(action_log::DecodeRecord(data, record) == 0);
+        }
+    }
+
+    GIVEN("a log written by a previous run") {
+        test_utils::TempDir dir{ "action_log_test_"sv };
+        const auto path = dir.path / "actions"s;
+        uint64_t checkpoint{ 0 };
+        {
+            action_log::ActionLog log{ path };
+            log.Append(action_log::Join{ "map1"s, "token"s, "Rex"s, 1, { 1.0, 2.0 } });
+            checkpoint = log.Rotate();
+            log.Append(action_log::Move{ "map1"s, "token"s, "L"s });
+            log.Append(action_log::Tick{ 100, {} });
+        }
+
+        WHEN("it is opened again") {
+            action_log::ActionLog log{ path };
+
+            THEN("records after the checkpoint are replayed in order") {
+                const auto records = ReplayAll(log, checkpoint);
+                REQUIRE(records.size() == 2);
+                CHECK(std::get<action_log::Move>(records[0]).direction == "L"s);
+                CHECK(std::get<action_log::Tick>(records[1]).period_ms == 100);
+            }
+
+            THEN("without a checkpoint all records are replayed") {
+                CHECK(ReplayAll(log, 0).size() == 3);
+            }
+
+            THEN("segments covered by a snapshot are removed") {
+                log.RemoveBefore(checkpoint);
+                CHECK(ReplayAll(log, 0).size() == 2);
+            }
+        }
+    }
+
+    GIVEN("a log rotated twice between flushes") {
+        test_utils::TempDir dir{ "action_log_test_"sv };
+        const auto path = dir.path / "actions"s;
+        uint64_t first{ 0 };
+        uint64_t second{ 0 };
+        {
+            action_log::ActionLog log{ path };
+            log.Append(action_log::Move{ "map1"s, "token"s, "L"s });
+            first = log.Rotate();
+            log.Append(action_log::Move{ "map1"s, "token"s, "R"s });
+            second = log.Rotate();
+            log.Append(action_log::Move{ "map1"s, "token"s, "U"s });
+        }
+
+        WHEN("it is opened again") {
+            action_log::ActionLog log{ path };
+
+            THEN("each record is in the segment it was appended to") {
+                CHECK(second == first + 1);
+                const auto after_second = ReplayAll(log, second);
+                REQUIRE(after_second.size() == 1);
+                CHECK(std::get<action_log::Move>(after_second[0]).direction == "U"s);
+
+                const auto after_first = ReplayAll(log, first);
+                REQUIRE(after_first.size() == 2);
+                CHECK(std::get<action_log::Move>(after_first[0]).direction == "R"s);
+                CHECK(ReplayAll(log, 0).size() == 3);
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#include <sstream>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "../src/content_encoding.h"
+
+namespace {
+    using namespace std::literals;
+
+    std::string Gunzip(const std::string& data) {
+        std::istringstream in{ data };
+        boost::iostreams::filtering_istream stream;
+        stream.push(boost::iostreams::gzip_decompressor());
+        stream.push(in);
+        std::ostringstream out;
+        boost::iostreams::copy(stream, out);
+        return out.str();
+    }
+}
+
+SCENARIO("Content encoding") {
+    GIVEN("Accept-Encoding values") {
+        THEN("gzip is accepted when listed without q=0") {
+            CHECK(content_encoding::AcceptsGzip("gzip"sv));
+            CHECK(content_encoding::AcceptsGzip("deflate, GZIP;q=0.5, br"sv));
+            CHECK(content_encoding::AcceptsGzip("br, *"sv));
+        }
+
+        THEN("gzip is refused when missing or with q=0") {
+            CHECK_FALSE(content_encoding::AcceptsGzip(""sv));
+            CHECK_FALSE(content_encoding::AcceptsGzip("br, deflate"sv));
+            CHECK_FALSE(content_encoding::AcceptsGzip("gzip;q=0"sv));
+            CHECK_FALSE(content_encoding::AcceptsGzip("*, gzip; q=0.0"sv));
+        }
+
+        THEN("spaces and tabs around values are trimmed") {
+            CHECK(content_encoding::Trim(" \t\"etag\" \t"sv) == "\"etag\""sv);
+            CHECK(content_encoding::Trim("  "sv).empty());
+        }
+    }
+
+    GIVEN("a compressor") {
+        const content_encoding::Compressor compressor{ 6, 64 };
+        const std::string body(4096, 'a');
+
+        THEN("a large body is compressed and decompressed back") {
+            const auto compressed = compressor.Compress(body);
+            REQUIRE(compressed != nullptr);
+            CHECK(compressed->size() < body.size());
+            CHECK(Gunzip(*compressed) == body);
+        }
+
+        THEN("a body below the threshold is left as is") {
+            CHECK(compressor.Compress("{}"sv) == nullptr);
+        }
+
+        THEN("a disabled compressor does nothing") {
+            CHECK(content_encoding::Compressor{}.Compress(body) == nullptr);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http_cache.h"
+
+namespace {
+    using namespace std::literals;
+
+    const std::string ETAG = "\"1a2b3c\""s;
+    const std::string GZIP_ETAG = "\"1a2b3c-gzip\""s;
+}
+
+SCENARIO("If-None-Match matching") {
+    GIVEN("a strong ETag of a response") {
+        THEN("the gzip variant differs only before the closing quote") {
+            CHECK(http_cache::GzipEtag(ETAG) == GZIP_ETAG);
+            CHECK(http_cache::GzipEtag("bad"sv) == "bad"s);
+        }
+
+        THEN("the same ETag matches with strong and weak comparison") {
+            CHECK(http_cache::IsEtagMatched(ETAG, ETAG));
+            CHECK(http_cache::IsEtagMatched("W/"s + ETAG, ETAG));
+        }
+
+        THEN("the ETag of the gzip body matches too") {
+            CHECK(http_cache::IsEtagMatched(GZIP_ETAG, ETAG));
+            CHECK(http_cache::IsEtagMatched("W/"s + GZIP_ETAG, ETAG));
+        }
+
+        THEN("any ETag matches the asterisk") {
+            CHECK(http_cache::IsEtagMatched("*"sv, ETAG));
+        }
+
+        THEN("the ETag is found in a list with spaces") {
+            CHECK(http_cache::IsEtagMatched("\"other\", W/\"1a2b3c\" ,\"more\""sv, ETAG));
+            CHECK(http_cache::IsEtagMatched(" \"other\",  "s + GZIP_ETAG, ETAG));
+        }
+
+        THEN("other ETags do not match") {
+            CHECK_FALSE(http_cache::IsEtagMatched(""sv, ETAG));
+            CHECK_FALSE(http_cache::IsEtagMatched("\"1a2b3\""sv, ETAG));
+            CHECK_FALSE(http_cache::IsEtagMatched("\"other\", W/\"other-gzip\""sv, ETAG));
+            CHECK_FALSE(http_cache::IsEtagMatched("1a2b3c"sv, ETAG));
+            CHECK_FALSE(http_cache::IsEtagMatched("w/"s + ETAG, ETAG));
+        }
+    }
+}
+
+SCENARIO("Representation of 200 and 304 responses") {
+    GIVEN("a response with a gzip body selected by Accept") {
+        WHEN("the client accepts gzip") {
+            const auto representation = http_cache::SelectRepresentation("deflate, gzip;q=0.5"sv, true, true, ETAG);
+
+            THEN("the gzip body is sent with its own ETag") {
+                CHECK(representation.gzip);
+                CHECK(representation.etag == GZIP_ETAG);
+                CHECK(representation.vary == "Accept, Accept-Encoding"sv);
+            }
+
+            THEN("the ETag sent with 304 is matched on the next request") {
+                CHECK(http_cache::IsEtagMatched(representation.etag, ETAG));
+            }
+        }
+
+        WHEN("the client does not accept gzip") {
+            const auto representation = http_cache::SelectRepresentation("gzip;q=0, identity"sv, true, true, ETAG);
+
+            THEN("the plain body is sent, caches still vary by Accept-Encoding") {
+                CHECK_FALSE(representation.gzip);
+                CHECK(representation.etag == ETAG);
+                CHECK(representation.vary == "Accept, Accept-Encoding"sv);
+            }
+        }
+    }
+
+    GIVEN("responses without a gzip body") {
+        THEN("gzip is never selected and Vary lists only Accept") {
+            const auto by_accept = http_cache::SelectRepresentation("gzip"sv, false, true, ETAG);
+            CHECK_FALSE(by_accept.gzip);
+            CHECK(by_accept.etag == ETAG);
+            CHECK(by_accept.vary == "Accept"sv);
+
+            const auto plain = http_cache::SelectRepresentation("gzip"sv, false, false, ""sv);
+            CHECK(plain.vary.empty());
+            CHECK(plain.etag.empty());
+        }
+    }
+
+    GIVEN("a file with a gzip body") {
+        THEN("Vary lists only Accept-Encoding") {
+            const auto representation = http_cache::SelectRepresentation("gzip"sv, true, false, ETAG);
+            CHECK(representation.gzip);
+            CHECK(representation.vary == "Accept-Encoding"sv);
+            CHECK(representation.etag == GZIP_ETAG);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/json_writer.h"
+
+namespace {
+    using namespace std::literals;
+}
+
+SCENARIO("Streaming JSON writer") {
+    GIVEN("a writer") {
+        std::string out;
+        json_writer::JsonWriter writer{ out };
+
+        WHEN("nested objects and arrays are written") {
+            constexpr json_writer::KeyFragment POS{ "pos" };
+            writer.StartObject();
+            writer.Key(POS);
+            writer.StartArray();
+            writer.Double(1.0);
+            writer.Double(-0.25);
+            writer.EndArray();
+            writer.Key("bag"sv);
+            writer.StartArray();
+            writer.EndArray();
+            writer.Key("id"sv);
+            writer.Uint(42);
+            writer.Key("next"sv);
+            writer.Null();
+            writer.EndObject();
+
+            THEN("commas are placed between elements only") {
+                CHECK(out == R"({"pos":[1.0,-0.25],"bag":[],"id":42,"next":null})"s);
+            }
+        }
+
+        WHEN("strings contain special characters") {
+            writer.String("a\"b\\c\nd\x01"sv);
+
+            THEN("they are escaped") {
+                CHECK(out == R"("a\"b\\c\nd\u0001")"s);
+            }
+        }
+
+        WHEN("a preformatted value is added") {
+            writer.StartObject();
+            writer.Key("1"sv);
+            writer.Raw(R"({"name":"A"})"sv);
+            writer.Key("2"sv);
+            writer.Raw(R"({"name":"B"})"sv);
+            writer.EndObject();
+
+            THEN("it is copied as is") {
+                CHECK(out == R"({"1":{"name":"A"},"2":{"name":"B"}})"s);
+            }
+        }
+    }
+}
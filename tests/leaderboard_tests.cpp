@@ -0,0 +1,270 @@
+#include <limits>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/leaderboard.h"
+#include "../src/query_params.h"
+#include "../src/retired_repository.h"
+
+namespace {
+    using namespace std::literals;
+    using retired_repository::RetiredPlayer;
+
+    std::vector<std::string> Names(const std::vector<RetiredPlayer>& records) {
+        std::vector<std::string> names;
+        for (const auto& record : records) {
+            names.push_back(record.name);
+        }
+        return names;
+    }
+
+    // курсор первой страницы: ключ выше любой записи в таблице
+    const retired_repository::RecordsCursor FIRST_CURSOR{ std::numeric_limits<int>::max(),
+        std::numeric_limits<int>::min(), ""s, 0 };
+
+    std::string Hex(std::string_view plain) {
+        constexpr std::string_view HEX_DIGITS = "0123456789abcdef"sv;
+        std::string hex;
+        for (unsigned char c : plain) {
+            hex.push_back(HEX_DIGITS[c >> 4]);
+            hex.push_back(HEX_DIGITS[c & 0x0f]);
+        }
+        return hex;
+    }
+}
+
+SCENARIO("Leaderboard in memory") {
+    GIVEN("a leaderboard loaded from a repository") {
+        retired_repository::InMemoryRetiredPlayersRepository repository;
+        repository.Init();
+        repository.Save({ { 1, "Bim"s, 10, 30 }, { 2, "Rex"s, 30, 50 }, { 3, "Ace"s, 10, 30 }, { 4, "Max"s, 10, 20 } });
+        leaderboard::Leaderboard leaderboard;
+        REQUIRE(leaderboard.Load(repository));
+
+        THEN("pages contain records in the rating order") {
+            auto page = leaderboard.GetPage(1, 2);
+            REQUIRE(page);
+            CHECK(page->body == R"([{"name":"Max","score":10,"playTime":20},{"name":"Ace","score":10,"playTime":30}])"s);
+            CHECK(page->gzip_body == nullptr);
+
+            auto tail = leaderboard.GetPage(3, 10);
+            REQUIRE(tail);
+            CHECK(tail->body == R"([{"name":"Bim","score":10,"playTime":30}])"s);
+            CHECK(leaderboard.GetPage(10, 10)->body == "[]"s);
+            CHECK(leaderboard.GetPage(-1, 10) == nullptr);
+        }
+
+        THEN("a page is serialized once") {
+            auto page = leaderboard.GetPage(0, 2);
+            CHECK(leaderboard.GetPage(0, 2) == page);
+            CHECK(leaderboard.GetPage(0, 3)->etag != page->etag);
+        }
+
+        WHEN("a retired player is added") {
+            auto page = leaderboard.GetPage(0, 2);
+            leaderboard.AddRetired({ { 5, "Top"s, 50, 10, "0123456789abcdef0123456789abcdef"s } });
+
+            THEN("the page and its ETag change") {
+                auto changed = leaderboard.GetPage(0, 2);
+                REQUIRE(changed);
+                CHECK(changed->etag != page->etag);
+                CHECK(changed->body == R"([{"name":"Top","score":50,"playTime":10},{"name":"Rex","score":30,"playTime":50}])"s);
+            }
+
+            AND_WHEN("the same record is added again") {
+                auto before = leaderboard.GetPage(0, 10);
+                leaderboard.AddRetired({ { 5, "Top"s, 50, 10, "0123456789abcdef0123456789abcdef"s } });
+
+                THEN("it is skipped by its record id") {
+                    auto after = leaderboard.GetPage(0, 10);
+                    CHECK(after == before);
+                    std::vector<RetiredPlayer> records;
+                    REQUIRE(leaderboard.GetPageAfter({ 100, 0, ""s, 0 }, 10, records));
+                    CHECK(Names(records) == std::vector{ "Top"s, "Rex"s, "Max"s, "Ace"s, "Bim"s });
+                }
+            }
+        }
+
+        WHEN("more pages are requested than the cache holds") {
+            auto first = leaderboard.GetPage(0, 1);
+            for (size_t i = 1; i < leaderboard::Leaderboard::MAX_CACHED_PAGES; ++i) {
+                leaderboard.GetPage(0, static_cast<int>(i) + 1);
+            }
+            REQUIRE(leaderboard.GetPage(0, 1) == first);
+            leaderboard.GetPage(1, 1);
+
+            THEN("the cache is cleared and pages are serialized again with the same ETag") {
+                auto again = leaderboard.GetPage(0, 1);
+                CHECK(again != first);
+                CHECK(again->etag == first->etag);
+                CHECK(again->body == first->body);
+            }
+        }
+    }
+
+    GIVEN("a leaderboard loaded with a record already moved from the spool") {
+        retired_repository::InMemoryRetiredPlayersRepository repository;
+        const RetiredPlayer moved{ 1, "Bim"s, 10, 30, "0123456789abcdef0123456789abcdef"s };
+        repository.Save({ moved });
+        leaderboard::Leaderboard leaderboard;
+        REQUIRE(leaderboard.Load(repository));
+
+        WHEN("the spool moves the same record again") {
+            leaderboard.AddRetired({ moved });
+
+            THEN("it is skipped by the record id read from the repository") {
+                CHECK(leaderboard.GetPage(0, 10)->body == R"([{"name":"Bim","score":10,"playTime":30}])"s);
+            }
+        }
+    }
+
+    GIVEN("a repository with more records than the leaderboard holds") {
+        retired_repository::InMemoryRetiredPlayersRepository repository;
+        repository.Init();
+        repository.Save({ { 1, "Bim"s, 10, 30 }, { 2, "Rex"s, 30, 50 }, { 3, "Ace"s, 10, 30 } });
+
+        THEN("the table is not loaded and requests go to the database") {
+            leaderboard::Leaderboard leaderboard{ 2 };
+            CHECK_FALSE(leaderboard.Load(repository));
+            CHECK(leaderboard.GetPage(0, 10) == nullptr);
+        }
+
+        WHEN("the loaded table outgrows the limit") {
+            leaderboard::Leaderboard leaderboard{ 3 };
+            REQUIRE(leaderboard.Load(repository));
+            leaderboard.AddRetired({ { 4, "Max"s, 10, 20 } });
+
+            THEN("it is unloaded") {
+                CHECK(leaderboard.GetPage(0, 10) == nullptr);
+                leaderboard::PlayerRank rank;
+                CHECK_FALSE(leaderboard.GetPlayerRank("Rex"s, 1, rank));
+            }
+        }
+    }
+}
+
+SCENARIO("Records pages by cursor") {
+    using retired_repository::RecordsCursor;
+
+    GIVEN("a cursor") {
+        const RecordsCursor cursor{ -5, 120, "Rex: the dog"s, 3 };
+
+        THEN("it survives the hex round trip") {
+            const std::string encoded = leaderboard::EncodeCursor(cursor);
+            CHECK(encoded.find_first_not_of("0123456789abcdef"sv) == std::string::npos);
+
+            RecordsCursor decoded;
+            REQUIRE(leaderboard::DecodeCursor(encoded, decoded));
+            CHECK(decoded.score == -5);
+            CHECK(decoded.play_time_s == 120);
+            CHECK(decoded.name == "Rex: the dog"s);
+            CHECK(decoded.skip == 3);
+        }
+
+        THEN("malformed cursors are rejected with 400 Bad Request") {
+            RecordsCursor decoded;
+            CHECK_FALSE(leaderboard::DecodeCursor("abc"sv, decoded));
+            CHECK_FALSE(leaderboard::DecodeCursor("zz"sv, decoded));
+            CHECK_FALSE(leaderboard::DecodeCursor(Hex("10:20"sv), decoded));
+            CHECK_FALSE(leaderboard::DecodeCursor(Hex("10:20:-1:Rex"sv), decoded));
+            CHECK_FALSE(leaderboard::DecodeCursor(Hex("ten:20:0:Rex"sv), decoded));
+            CHECK(leaderboard::DecodeCursor(Hex("10:20:0:"sv), decoded));
+        }
+    }
+
+    GIVEN("a table with records sharing the same key") {
+        retired_repository::InMemoryRetiredPlayersRepository repository;
+        repository.Save({ { 1, "Rex"s, 30, 50 }, { 2, "Ace"s, 10, 30 }, { 3, "Rex"s, 30, 50 },
+            { 4, "Max"s, 10, 20 }, { 5, "Rex"s, 30, 50 } });
+        leaderboard::Leaderboard leaderboard;
+        REQUIRE(leaderboard.Load(repository));
+        const std::vector<std::string> all_names{ "Rex"s, "Rex"s, "Rex"s, "Max"s, "Ace"s };
+
+        THEN("pages of any size list every record once, in memory and in the repository") {
+            for (int max_items = 1; max_items <= 6; ++max_items) {
+                INFO("maxItems: " << max_items);
+                std::vector<RetiredPlayer> memory_records;
+                std::vector<RetiredPlayer> repository_records;
+                RecordsCursor cursor = FIRST_CURSOR;
+                while (true) {
+                    std::vector<RetiredPlayer> page;
+                    REQUIRE(leaderboard.GetPageAfter(cursor, max_items, page));
+                    repository.ReadAfter(cursor, max_items, repository_records);
+                    memory_records.insert(memory_records.end(), page.begin(), page.end());
+                    if (page.size() < static_cast<size_t>(max_items)) {
+                        break;
+                    }
+                    REQUIRE(leaderboard::DecodeCursor(leaderboard::EncodeCursor(leaderboard::NextCursor(cursor, page)), cursor));
+                }
+                CHECK(Names(memory_records) == all_names);
+                CHECK(Names(repository_records) == all_names);
+            }
+        }
+
+        THEN("the skip count accumulates while a page holds only tied records") {
+            std::vector<RetiredPlayer> page;
+            REQUIRE(leaderboard.GetPageAfter(FIRST_CURSOR, 1, page));
+            RecordsCursor cursor = leaderboard::NextCursor(FIRST_CURSOR, page);
+            CHECK(cursor.name == "Rex"s);
+            CHECK(cursor.skip == 1);
+
+            page.clear();
+            REQUIRE(leaderboard.GetPageAfter(cursor, 1, page));
+            cursor = leaderboard::NextCursor(cursor, page);
+            CHECK(cursor.skip == 2);
+
+            page.clear();
+            REQUIRE(leaderboard.GetPageAfter(cursor, 2, page));
+            CHECK(Names(page) == std::vector{ "Rex"s, "Max"s });
+            cursor = leaderboard::NextCursor(cursor, page);
+            CHECK(cursor.name == "Max"s);
+            CHECK(cursor.skip == 1);
+        }
+
+        THEN("the last page has no next cursor") {
+            std::vector<RetiredPlayer> page;
+            REQUIRE(leaderboard.GetPageAfter(FIRST_CURSOR, 10, page));
+            CHECK(leaderboard::SerializeCursorPage(FIRST_CURSOR, 10, page).ends_with(R"(,"next":null})"sv));
+            page.resize(2);
+            CHECK(leaderboard::SerializeCursorPage(FIRST_CURSOR, 2, page).ends_with(
+                ",\"next\":\""s + leaderboard::EncodeCursor({ 30, 50, "Rex"s, 2 }) + "\"}"s));
+        }
+    }
+}
+
+SCENARIO("Records query parameters") {
+    using query_params::ParseQueryParams;
+
+    GIVEN("start and maxItems in any order") {
+        const auto direct = ParseQueryParams("/api/v1/game/records?start=10&maxItems=5"sv);
+        const auto reversed = ParseQueryParams("/api/v1/game/records?maxItems=5&start=10"sv);
+
+        THEN("they are parsed the same way") {
+            REQUIRE(direct);
+            REQUIRE(reversed);
+            CHECK(*direct == *reversed);
+            CHECK(direct->at("start"s) == "10"s);
+            CHECK(direct->at("maxItems"s) == "5"s);
+        }
+    }
+
+    GIVEN("other query strings") {
+        THEN("they are decoded or rejected") {
+            CHECK(ParseQueryParams("/api/v1/game/records"sv)->empty());
+            CHECK(ParseQueryParams("/api/v1/game/records?cursor=&&maxItems=1"sv)->at("cursor"s).empty());
+            CHECK(ParseQueryParams("/api/v1/game/records?name=Rex%20Dog"sv)->at("name"s) == "Rex Dog"s);
+            CHECK_FALSE(ParseQueryParams("/api/v1/game/records?start=%zz"sv));
+        }
+
+        THEN("only non-negative numbers are accepted") {
+            int value{ 0 };
+            CHECK(query_params::ParseNonNegativeInt("42"sv, value));
+            CHECK(value == 42);
+            CHECK_FALSE(query_params::ParseNonNegativeInt("-1"sv, value));
+            CHECK_FALSE(query_params::ParseNonNegativeInt("1x"sv, value));
+            CHECK_FALSE(query_params::ParseNonNegativeInt(""sv, value));
+            CHECK(value == 42);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/rank_tree.h"
+
+SCENARIO("Order statistic tree") {
+    using rank_tree::OrderStatisticTree;
+
+    GIVEN("an empty tree") {
+        OrderStatisticTree<int> tree;
+
+        THEN("it has no elements") {
+            CHECK(tree.Empty());
+            CHECK(tree.Size() == 0);
+            CHECK(tree.Rank(42) == 0);
+            CHECK_THROWS_AS(tree.At(0), std::out_of_range);
+        }
+    }
+
+    GIVEN("a tree filled in random order") {
+        std::vector<int> values;
+        for (int i = 0; i < 1000; ++i) {
+            values.push_back(i % 300);
+        }
+        std::mt19937 gen{ 42 };
+        std::shuffle(values.begin(), values.end(), gen);
+
+        OrderStatisticTree<int> tree;
+        for (int value : values) {
+            tree.Insert(value);
+        }
+        std::sort(values.begin(), values.end());
+
+        THEN("elements are ordered by position") {
+            REQUIRE(tree.Size() == values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                INFO("index: " << i);
+                REQUIRE(tree.At(i) == values[i]);
+            }
+        }
+
+        THEN("rank counts strictly smaller elements") {
+            for (int value = -1; value <= 301; ++value) {
+                INFO("value: " << value);
+                auto expected = std::lower_bound(values.begin(), values.end(), value) - values.begin();
+                REQUIRE(tree.Rank(value) == static_cast<size_t>(expected));
+            }
+        }
+    }
+
+    GIVEN("a tree with custom order") {
+        OrderStatisticTree<int, std::greater<int>> tree;
+        for (int value : { 5, 1, 9, 3 }) {
+            tree.Insert(value);
+        }
+
+        THEN("the order is respected") {
+            CHECK(tree.At(0) == 9);
+            CHECK(tree.At(3) == 1);
+            CHECK(tree.Rank(5) == 1);
+        }
+
+        WHEN("the tree is cleared") {
+            tree.Clear();
+            THEN("it becomes empty") {
+                CHECK(tree.Empty());
+            }
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/model.h"
+#include "../src/response_cache.h"
+#include "../src/retired_repository.h"
+
+namespace {
+    using namespace std::literals;
+
+    const std::string MAP_NAME = "map1"s;
+
+    // Карта с одной горизонтальной дорогой от (0, 0) до (10, 0)
+    model::Map MakeMap() {
+        model::Map map{ model::Map::Id{ MAP_NAME }, "Map 1"s };
+        map.AddRoad(model::Road{ model::Road::HORIZONTAL, { 0, 0 }, 10 });
+        map.SetDogSpeed(1.0);
+        map.SetBagCapacity(3);
+        return map;
+    }
+
+    bool Contains(const std::string& body, std::string_view part) {
+        return body.find(part) != std::string::npos;
+    }
+}
+
+SCENARIO("Game state responses with changes since a version") {
+    GIVEN("a map with a player and an item of loot on the road ahead") {
+        retired_repository::InMemoryRetiredPlayersRepository repository;
+        model::Game game{ repository };
+        game.AddMap(MakeMap());
+        const model::Map* map = game.FindMap(model::Map::Id{ MAP_NAME });
+
+        model::GameRepr loot;
+        loot.map_name_to_loot[MAP_NAME].push_back({ 0, { 0.5, 0.0 } });
+        game.LoadGame(std::move(loot));
+        std::string token = "0123456789abcdef0123456789abcdef"s;
+        std::string map_name = MAP_NAME;
+        const std::string player_id = std::to_string(game.AddPlayerOnMap(map, MAP_NAME, token, "dog"s));
+
+        response_cache::ResponseCache cache{ game, 2 };
+        const uint64_t first_version = cache.Get(MAP_NAME).version;
+
+        WHEN("changes are requested since version 0") {
+            const std::string delta = cache.GetDelta(MAP_NAME, 0);
+
+            THEN("the full state is returned") {
+                CHECK(Contains(delta, "\"full\":true"sv));
+                CHECK(Contains(delta, "\""s + player_id + "\":{"s));
+                CHECK(Contains(delta, "\"lostObjects\":{\"0\":"sv));
+            }
+        }
+
+        WHEN("the player turns before the next tick") {
+            game.MovePlayer("R"s, token, map_name);
+
+            THEN("requests get the responses published by the last build") {
+                CHECK(cache.Get(MAP_NAME).version == first_version);
+                CHECK(Contains(cache.GetDelta(MAP_NAME, first_version), "\"players\":{}"sv));
+            }
+        }
+
+        WHEN("the player turns") {
+            game.MovePlayer("R"s, token, map_name);
+            cache.Refresh();
+            const std::string delta = cache.GetDelta(MAP_NAME, first_version);
+
+            THEN("only the player is in the changes") {
+                CHECK_FALSE(Contains(delta, "\"full\""sv));
+                CHECK(Contains(delta, "\"players\":{\""s + player_id + "\":"s));
+                CHECK(Contains(delta, "\"lostObjects\":{}"sv));
+                CHECK(Contains(delta, "\"removedPlayers\":[]"sv));
+                CHECK(Contains(delta, "\"removedObjects\":[]"sv));
+            }
+
+            THEN("nothing changed since the current version") {
+                const std::string current = cache.GetDelta(MAP_NAME, cache.Get(MAP_NAME).version);
+                CHECK(Contains(current, "\"players\":{}"sv));
+                CHECK(Contains(current, "\"lostObjects\":{}"sv));
+            }
+
+            AND_WHEN("the player picks the loot up") {
+                game.SpendTime(std::chrono::milliseconds{ 1000 });
+                cache.Refresh();
+                const std::string delta_after_tick = cache.GetDelta(MAP_NAME, first_version);
+
+                THEN("the loot is listed as removed") {
+                    CHECK_FALSE(Contains(delta_after_tick, "\"full\""sv));
+                    CHECK(Contains(delta_after_tick, "\"lostObjects\":{}"sv));
+                    CHECK(Contains(delta_after_tick, "\"removedObjects\":[\"0\"]"sv));
+                    CHECK(Contains(delta_after_tick, "\"removedPlayers\":[]"sv));
+                }
+            }
+
+            AND_WHEN("the journal forgets the first version") {
+                game.MovePlayer("L"s, token, map_name);
+                cache.Refresh();
+                game.MovePlayer(""s, token, map_name);
+                cache.Refresh();
+                const std::string resync = cache.GetDelta(MAP_NAME, first_version);
+
+                THEN("the full state is returned") {
+                    CHECK(Contains(resync, "\"full\":true"sv));
+                    CHECK(Contains(resync, "\"lostObjects\":{\"0\":"sv));
+                }
+            }
+        }
+
+        WHEN("another player joins the map") {
+            std::string second_token = "fedcba9876543210fedcba9876543210"s;
+            const std::string second_id = std::to_string(game.AddPlayerOnMap(map, MAP_NAME, second_token, "cat"s));
+            cache.Refresh(MAP_NAME);
+
+            THEN("the player is in the state without waiting for a tick") {
+                CHECK(cache.Get(MAP_NAME).version > first_version);
+                CHECK(Contains(*cache.Get(MAP_NAME).state, "\""s + second_id + "\":{"s));
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/retired_repository.h"
+
+SCENARIO("In-memory retired players repository") {
+    using namespace std::literals;
+    using retired_repository::RetiredPlayer;
+
+    GIVEN("a repository with records") {
+        retired_repository::InMemoryRetiredPlayersRepository repository;
+        repository.Init();
+        repository.Save({ { 1, "Bim"s, 10, 30 }, { 2, "Rex"s, 30, 50 }, { 3, "Ace"s, 10, 30 },
+            { 4, "Max"s, 10, 20 }, { 5, "Rex"s, 30, 50 } });
+
+        THEN("records are ordered by score, play time and name") {
+            std::vector<RetiredPlayer> records;
+            repository.ReadAll(10, records);
+            std::vector<std::string> names;
+            for (const auto& record : records) {
+                names.push_back(record.name);
+                CHECK(record.id == 0);
+            }
+            CHECK(names == std::vector{ "Rex"s, "Rex"s, "Max"s, "Ace"s, "Bim"s });
+        }
+
+        THEN("pages are read by offset") {
+            std::vector<RetiredPlayer> records;
+            repository.ReadPage(2, 2, records);
+            REQUIRE(records.size() == 2);
+            CHECK(records[0].name == "Max"s);
+            CHECK(records[1].name == "Ace"s);
+
+            records.clear();
+            repository.ReadPage(10, 2, records);
+            CHECK(records.empty());
+        }
+
+        THEN("pages are read after a cursor, skipping records with the same key") {
+            std::vector<RetiredPlayer> records;
+            repository.ReadAfter({ 30, 50, "Rex"s, 1 }, 2, records);
+            REQUIRE(records.size() == 2);
+            CHECK(records[0].name == "Rex"s);
+            CHECK(records[1].name == "Max"s);
+        }
+
+        WHEN("a record with a known id is saved twice") {
+            const RetiredPlayer player{ 6, "Dup"s, 5, 5, "0123456789abcdef0123456789abcdef"s };
+            repository.Save({ player });
+            repository.Save({ player });
+
+            THEN("it is stored once") {
+                std::vector<RetiredPlayer> records;
+                repository.ReadAll(10, records);
+                CHECK(records.size() == 6);
+            }
+        }
+
+        THEN("reading all records is limited") {
+            std::vector<RetiredPlayer> records;
+            repository.ReadAll(2, records);
+            REQUIRE(records.size() == 2);
+            CHECK(records[1].name == "Rex"s);
+        }
+    }
+}
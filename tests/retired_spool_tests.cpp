@@ -0,0 +1,111 @@
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/retired_spool.h"
+#include "temp_dir.h"
+
+namespace {
+    using namespace std::literals;
+
+    // Приёмник записей вместо БД
+    struct Collector {
+        void operator()(const std::vector<retired_repository::RetiredPlayer>& batch) {
+            std::lock_guard lock{ mtx };
+            if (fail) {
+                throw std::runtime_error("database is down");
+            }
+            received.insert(received.end(), batch.begin(), batch.end());
+        }
+
+        size_t Size() {
+            std::lock_guard lock{ mtx };
+            return received.size();
+        }
+
+        std::mutex mtx;
+        bool fail{ false };
+        std::vector<retired_repository::RetiredPlayer> received;
+    };
+
+    bool WaitFor(Collector& collector, size_t count) {
+        for (int i = 0; i < 500 && collector.Size() < count; ++i) {
+            std::this_thread::sleep_for(10ms);
+        }
+        return collector.Size() == count;
+    }
+}
+
+SCENARIO("Retired players spool") {
+    GIVEN("an encoded record") {
+        retired_repository::RetiredPlayer player{ 7, "Rex"s, 42, 120, "0123456789abcdef0123456789abcdef"s };
+        std::string data;
+        retired_spool::EncodeRecord(player, data);
+
+        THEN("it decodes back") {
+            retired_repository::RetiredPlayer decoded;
+            REQUIRE(retired_spool::DecodeRecord(data, decoded) == data.size());
+            CHECK(decoded.name == player.name);
+            CHECK(decoded.score == player.score);
+            CHECK(decoded.play_time_s == player.play_time_s);
+            CHECK(decoded.record_id == player.record_id);
+        }
+
+        THEN("truncated or damaged data is rejected") {
+            retired_repository::RetiredPlayer decoded;
+            CHECK(retired_spool::DecodeRecord(std::string_view{ data }.substr(0, data.size() - 1), decoded) == 0);
+            data.back() ^= 1;
+            CHECK(retired_spool::DecodeRecord(data, decoded) == 0);
+        }
+    }
+
+    GIVEN("a spool file") {
+        test_utils::TempDir dir{ "retired_spool_test_"sv };
+        const auto path = dir.path / "retired.spool";
+        Collector collector;
+
+        WHEN("the database is available") {
+            retired_spool::RetiredSpool spool{ path, std::ref(collector) };
+            spool.Start();
+            REQUIRE(spool.Append({ { 1, "Rex"s, 10, 5 }, { 2, "Bim"s, 20, 6 } }));
+
+            THEN("records are replayed with generated ids") {
+                REQUIRE(WaitFor(collector, 2));
+                CHECK(collector.received[0].name == "Rex"s);
+                CHECK(collector.received[1].score == 20);
+                CHECK(collector.received[0].record_id.size() == 32);
+                CHECK(collector.received[0].record_id != collector.received[1].record_id);
+            }
+        }
+
+        WHEN("the database is down until restart") {
+            collector.fail = true;
+            {
+                retired_spool::RetiredSpool spool{ path, std::ref(collector) };
+                spool.Start();
+                REQUIRE(spool.Append({ { 1, "Rex"s, 10, 5 } }));
+                CHECK(spool.PendingBytes() > 0);
+            }
+            // недописанный хвост от аварийного завершения
+            {
+                std::ofstream out{ path, std::ios::binary | std::ios::app };
+                out << "\x30\x00"s;
+            }
+            collector.fail = false;
+
+            THEN("records survive and are replayed after restart") {
+                retired_spool::RetiredSpool spool{ path, std::ref(collector) };
+                spool.Start();
+                REQUIRE(WaitFor(collector, 1));
+                CHECK(collector.received[0].name == "Rex"s);
+                REQUIRE(spool.Append({ { 2, "Bim"s, 20, 6 } }));
+                REQUIRE(WaitFor(collector, 2));
+                CHECK(collector.received[1].name == "Bim"s);
+            }
+        }
+    }
+}
@@ -0,0 +1,205 @@
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/snapshot.h"
+#include "temp_dir.h"
+
+namespace {
+    using namespace std::literals;
+
+    model::GameRepr MakeGameRepr() {
+        model::GameRepr game_repr;
+        model::Player player;
+        player.pos_ = { 1.5, 2.5 };
+        player.speed_ = { 0.0, -1.0 };
+        player.direction_ = model::Direction::NORTH;
+        player.id_ = 7;
+        player.map_name_ = "map1"s;
+        player.name_ = "Rex"s;
+        player.hash_ = "0123456789abcdef0123456789abcdef"s;
+        model::LootWithId item;
+        item.id = 3;
+        item.type = 1;
+        item.coord = { 4.0, 5.0 };
+        player.bag_.push_back(item);
+        player.base_pos_ = { 1.0, 1.0 };
+        player.score_ = 42;
+        player.no_move_time_ = 0.5;
+        player.join_time_ = 10.0;
+
+        game_repr.hash_to_palyer_id[player.hash_] = player.id_;
+        game_repr.hash_to_map_name[player.hash_] = player.map_name_;
+        game_repr.palyer_id_to_player_name[player.id_] = player.name_;
+        game_repr.map_name_to_players[player.map_name_].push_back(player);
+        game_repr.map_name_to_loot["map1"s].push_back({ 2, { 3.0, 0.0 } });
+        game_repr.map_name_to_loot["map2"s].push_back({ 0, { 0.0, 6.0 } });
+        game_repr.log_segment = 5;
+        return game_repr;
+    }
+}
+
+SCENARIO("Game state snapshots") {
+    GIVEN("a game state") {
+        const auto game_repr = MakeGameRepr();
+
+        WHEN("it is saved in the binary format") {
+            std::ostringstream out;
+            snapshot::Save(game_repr, model::SnapshotFormat::BINARY, out);
+            const std::string data = out.str();
+
+            THEN("it is loaded back") {
+                REQUIRE(snapshot::IsBinary(data));
+                model::GameRepr loaded;
+                snapshot::Load(data, loaded);
+
+                CHECK(loaded.hash_to_palyer_id == game_repr.hash_to_palyer_id);
+                CHECK(loaded.hash_to_map_name == game_repr.hash_to_map_name);
+                CHECK(loaded.palyer_id_to_player_name == game_repr.palyer_id_to_player_name);
+                REQUIRE(loaded.map_name_to_players.at("map1"s).size() == 1);
+                const auto& player = loaded.map_name_to_players.at("map1"s).front();
+                CHECK(player.map_name_ == "map1"s);
+                CHECK(player.name_ == "Rex"s);
+                CHECK(player.pos_.y == 2.5);
+                CHECK(player.bag_.front().coord.x == 4.0);
+                CHECK(player.score_ == 42);
+                REQUIRE(player.join_time_.has_value());
+                CHECK(*player.join_time_ == 10.0);
+                CHECK(loaded.map_name_to_loot.at("map2"s).front().coord.y == 6.0);
+                CHECK(loaded.map_name_to_players.count("map2"s) == 0);
+                CHECK(loaded.log_segment == 5);
+            }
+
+            THEN("a truncated snapshot is rejected") {
+                model::GameRepr loaded;
+                CHECK_THROWS(snapshot::Load(std::string_view{ data }.substr(0, data.size() - 3), loaded));
+            }
+        }
+
+        WHEN("it is saved in the text format") {
+            std::ostringstream out;
+            snapshot::Save(game_repr, model::SnapshotFormat::TEXT, out);
+
+            THEN("the format is detected on load") {
+                CHECK_FALSE(snapshot::IsBinary(out.str()));
+                model::GameRepr loaded;
+                snapshot::Load(out.str(), loaded);
+                CHECK(loaded.hash_to_palyer_id == game_repr.hash_to_palyer_id);
+                CHECK(loaded.map_name_to_players.at("map1"s).front().name_ == "Rex"s);
+                CHECK(loaded.log_segment == 5);
+            }
+        }
+
+        WHEN("it is saved compressed") {
+            std::ostringstream binary;
+            snapshot::Save(game_repr, model::SnapshotFormat::BINARY, binary, 6);
+            std::ostringstream text;
+            snapshot::Save(game_repr, model::SnapshotFormat::TEXT, text, 1);
+
+            THEN("both formats are decompressed on load") {
+                CHECK(snapshot::IsCompressed(binary.str()));
+                CHECK(snapshot::IsCompressed(text.str()));
+                model::GameRepr from_binary;
+                snapshot::Load(binary.str(), from_binary);
+                CHECK(from_binary.map_name_to_players.at("map1"s).front().name_ == "Rex"s);
+                model::GameRepr from_text;
+                snapshot::Load(text.str(), from_text);
+                CHECK(from_text.hash_to_palyer_id == game_repr.hash_to_palyer_id);
+                CHECK(from_text.log_segment == 5);
+            }
+
+            THEN("compressed shards are read back") {
+                test_utils::TempDir dir{ "snapshot_test_"sv };
+                const auto path = dir.path / "state"s;
+                snapshot::WriteFile(game_repr, { .format = model::SnapshotFormat::SHARDED, .compression_level = 9 }, path);
+                model::GameRepr loaded;
+                REQUIRE(snapshot::LoadFile(path, loaded));
+                CHECK(loaded.map_name_to_loot.at("map2"s).front().coord.y == 6.0);
+            }
+        }
+
+        WHEN("it is written by the background writer") {
+            const auto path = std::filesystem::temp_directory_path() / "snapshot_tests_state"s;
+            {
+                snapshot::BackgroundWriter writer;
+                writer.Submit(std::make_shared<const model::GameRepr>(game_repr), { .format = model::SnapshotFormat::BINARY }, path);
+                writer.Flush();
+            }
+
+            THEN("the file holds the submitted state") {
+                std::ifstream in{ path, std::ios::binary };
+                std::stringstream ss;
+                ss << in.rdbuf();
+                model::GameRepr loaded;
+                snapshot::Load(ss.view(), loaded);
+                CHECK(loaded.hash_to_palyer_id == game_repr.hash_to_palyer_id);
+                CHECK_FALSE(std::filesystem::exists(path.string() + "_tmp"s));
+            }
+            std::filesystem::remove(path);
+        }
+
+        WHEN("it is written as per-map shards") {
+            test_utils::TempDir dir{ "snapshot_test_"sv };
+            const auto path = dir.path / "state"s;
+            snapshot::WriteFile(game_repr, { .format = model::SnapshotFormat::SHARDED }, path);
+            snapshot::WriteFile(game_repr, { .format = model::SnapshotFormat::SHARDED }, path);
+
+            THEN("the manifest restores every map") {
+                model::GameRepr loaded;
+                REQUIRE(snapshot::LoadFile(path, loaded));
+                CHECK(loaded.hash_to_palyer_id == game_repr.hash_to_palyer_id);
+                CHECK(loaded.palyer_id_to_player_name == game_repr.palyer_id_to_player_name);
+                CHECK(loaded.map_name_to_players.at("map1"s).front().name_ == "Rex"s);
+                CHECK(loaded.map_name_to_loot.at("map2"s).front().coord.y == 6.0);
+                CHECK(loaded.log_segment == 5);
+            }
+
+            THEN("only the shards of the last snapshot are kept") {
+                // манифест, токены и две карты
+                const auto files = std::distance(std::filesystem::directory_iterator{ dir.path },
+                    std::filesystem::directory_iterator{});
+                CHECK(files == 4);
+            }
+
+            THEN("a damaged shard is detected") {
+                for (const auto& entry : std::filesystem::directory_iterator{ dir.path }) {
+                    if (entry.path().filename().string().ends_with(".tokens"s)) {
+                        std::ofstream{ entry.path(), std::ios::binary | std::ios::app } << 'x';
+                    }
+                }
+                model::GameRepr loaded;
+                CHECK_THROWS(snapshot::LoadFile(path, loaded));
+            }
+        }
+
+        WHEN("previous snapshots are kept") {
+            test_utils::TempDir dir{ "snapshot_test_"sv };
+            const auto path = dir.path / "state"s;
+            auto older = game_repr;
+            older.log_segment = 1;
+            snapshot::WriteFile(older, { .format = model::SnapshotFormat::SHARDED, .keep_previous = 2 }, path);
+            for (int i = 0; i < 3; ++i) {
+                snapshot::WriteFile(game_repr, { .format = model::SnapshotFormat::BINARY, .keep_previous = 2 }, path);
+            }
+
+            THEN("only the requested number of copies is left") {
+                CHECK(std::filesystem::exists(path.string() + ".1"s));
+                CHECK(std::filesystem::exists(path.string() + ".2"s));
+                CHECK_FALSE(std::filesystem::exists(path.string() + ".3"s));
+                // шардированный снимок вытеснен вместе со своими частями
+                const auto files = std::distance(std::filesystem::directory_iterator{ dir.path },
+                    std::filesystem::directory_iterator{});
+                CHECK(files == 3);
+            }
+
+            THEN("a kept copy can be loaded") {
+                model::GameRepr loaded;
+                REQUIRE(snapshot::LoadFile(path.string() + ".2"s, loaded));
+                CHECK(loaded.hash_to_palyer_id == game_repr.hash_to_palyer_id);
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#include <cmath>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/state_encoding.h"
+
+namespace {
+    using namespace std::literals;
+
+    // Координаты передаются с шагом квантования 0.001
+    bool IsNear(double value, double expected) {
+        return std::abs(value - expected) <= 0.5 / state_encoding::COORD_SCALE;
+    }
+
+    model::Player MakePlayer(uint64_t id, model::FloatCoord pos) {
+        model::Player player;
+        player.id_ = id;
+        player.pos_ = pos;
+        player.speed_ = { -1.5, 0.0 };
+        player.direction_ = model::Direction::WEST;
+        player.score_ = 300;
+        model::LootWithId item;
+        item.id = 12;
+        item.type = 2;
+        player.bag_.push_back(item);
+        return player;
+    }
+}
+
+SCENARIO("Binary game state encoding") {
+    GIVEN("players and loot on a map") {
+        std::deque<model::Player> players{ MakePlayer(0, { 10.2, 3.1234 }), MakePlayer(100000, { -0.4, 40.0 }) };
+        std::deque<model::Loot> loot{ { 1, { 5.5, 7.0 } } };
+        const std::string data = state_encoding::EncodeState(players, loot);
+
+        THEN("they are decoded with quantized coordinates") {
+            std::deque<model::Player> decoded_players;
+            std::deque<model::Loot> decoded_loot;
+            state_encoding::DecodeState(data, decoded_players, decoded_loot);
+
+            REQUIRE(decoded_players.size() == 2);
+            CHECK(decoded_players[1].id_ == 100000);
+            CHECK(IsNear(decoded_players[0].pos_.x, 10.2));
+            CHECK(IsNear(decoded_players[0].pos_.y, 3.123));
+            CHECK(IsNear(decoded_players[1].pos_.x, -0.4));
+            CHECK(IsNear(decoded_players[0].speed_.x, -1.5));
+            CHECK(decoded_players[0].direction_ == model::Direction::WEST);
+            CHECK(decoded_players[0].score_ == 300);
+            REQUIRE(decoded_players[0].bag_.size() == 1);
+            CHECK(decoded_players[0].bag_.front().id == 12);
+            CHECK(decoded_players[0].bag_.front().type == 2);
+
+            REQUIRE(decoded_loot.size() == 1);
+            CHECK(decoded_loot[0].type == 1);
+            CHECK(IsNear(decoded_loot[0].coord.x, 5.5));
+        }
+
+        THEN("truncated data is rejected") {
+            std::deque<model::Player> decoded_players;
+            std::deque<model::Loot> decoded_loot;
+            CHECK_THROWS_AS(state_encoding::DecodeState(std::string_view{ data }.substr(0, data.size() - 1),
+                decoded_players, decoded_loot), std::runtime_error);
+        }
+    }
+}
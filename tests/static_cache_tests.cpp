@@ -0,0 +1,80 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/static_cache.h"
+#include "temp_dir.h"
+
+namespace {
+    using namespace std::literals;
+
+    void WriteFile(const std::filesystem::path& path, const std::string& content) {
+        std::ofstream out{ path, std::ios::binary };
+        out << content;
+    }
+}
+
+SCENARIO("Static files cache") {
+    GIVEN("a static files directory") {
+        test_utils::TempDir dir{ "static_cache_test_"sv };
+        std::filesystem::create_directories(dir.path / "js"s);
+        const std::string script(8192, 'x');
+        WriteFile(dir.path / "index.html"s, "<html></html>"s);
+        WriteFile(dir.path / "js"s / "app.js"s, script);
+
+        WHEN("the cache is built") {
+            static_cache::StaticCache cache{ dir.path };
+
+            THEN("files are served from memory") {
+                const auto index = cache.Find("/index.html"s);
+                REQUIRE(index != nullptr);
+                CHECK(*index->body == "<html></html>"s);
+                CHECK(index->gzip_body == nullptr);
+                CHECK_FALSE(index->etag.empty());
+
+                const auto app = cache.Find("/js/app.js"s);
+                REQUIRE(app != nullptr);
+                CHECK(*app->body == script);
+                REQUIRE(app->gzip_body != nullptr);
+                CHECK(app->gzip_body->size() < script.size());
+            }
+
+            THEN("unknown files are not found") {
+                CHECK(cache.Find("/missing.html"s) == nullptr);
+                CHECK(cache.Find("/js/../index.html"s) == nullptr);
+            }
+
+            AND_WHEN("files change and the directory is rescanned") {
+                WriteFile(dir.path / "index.html"s, "<html>new</html>"s);
+                std::filesystem::remove(dir.path / "js"s / "app.js"s);
+                cache.Rescan();
+
+                THEN("the cache follows the directory") {
+                    const auto index = cache.Find("/index.html"s);
+                    REQUIRE(index != nullptr);
+                    CHECK(*index->body == "<html>new</html>"s);
+                    CHECK(cache.Find("/js/app.js"s) == nullptr);
+                }
+            }
+        }
+
+        WHEN("the cache is smaller than the directory") {
+            static_cache::StaticCache cache{ dir.path, 1024 };
+
+            THEN("only files that fit are cached") {
+                CHECK(cache.Find("/index.html"s) != nullptr);
+                CHECK(cache.Find("/js/app.js"s) == nullptr);
+                CHECK(cache.Size() <= 1024);
+            }
+        }
+
+        WHEN("the cache is disabled") {
+            static_cache::StaticCache cache{ dir.path, 0 };
+
+            THEN("nothing is cached") {
+                CHECK(cache.Find("/index.html"s) == nullptr);
+            }
+        }
+    }
+}
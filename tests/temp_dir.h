@@ -0,0 +1,26 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+namespace test_utils {
+
+    // Временный каталог, удаляемый после теста
+    struct TempDir {
+        /// @param prefix начало имени каталога; к нему добавляется pid, чтобы параллельные прогоны не мешали друг другу
+        explicit TempDir(std::string_view prefix)
+            : path(std::filesystem::temp_directory_path() / (std::string(prefix) + std::to_string(::getpid()))) {
+            std::filesystem::remove_all(path);
+            std::filesystem::create_directories(path);
+        }
+        ~TempDir() {
+            std::filesystem::remove_all(path);
+        }
+        TempDir(const TempDir&) = delete;
+        TempDir& operator=(const TempDir&) = delete;
+
+        std::filesystem::path path;
+    };
+
+}  // namespace test_utils